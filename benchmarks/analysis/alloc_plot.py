@@ -1,44 +1,48 @@
 import numpy as np
 import matplotlib.pyplot as plt
 
+import sys
+
+from results import check_comparable, read_results
+
+# Results files of bench_single_alloc -o, or the older runs without metadata
 # files = ["binary.txt", "bt.txt", "ibuddy.txt", "lazy.txt"]
 # files = ["binary_free.txt", "bt_free.txt", "ibuddy_free.txt", "lazy_free.txt"]
 # files = ["binary_server.txt", "bt_server.txt", "ibuddy_server.txt", "lazy_server.txt"]
-files = ["binary_free_server.txt", "bt_free_server.txt", "ibuddy_free_server.txt", "lazy_free_server.txt"]
+files = sys.argv[1:] or ["../runs/" + f for f in ["binary_free_server.txt", "bt_free_server.txt", "ibuddy_free_server.txt", "lazy_free_server.txt"]]
 
-binary_buddy = {2**x: [] for x in range(4,19)}
-bt_buddy = {2**x: [] for x in range(4,19)}
-ibuddy_buddy = {2**x: [] for x in range(4,19)}
-lazy_buddy = {2**x: [] for x in range(4,19)}
+labels = {"binary": "Binary Buddy", "bt": "Binary Tree", "ibuddy": "iBuddy", "lazy": "Lazy Layer"}
+series = {}
+metadatas = []
+op = "free" if "free" in files[0] else "alloc"
 
 for file in files:
-    with open("../runs/" + file) as f:
-        for line in f:
-            time, size = line.split(" ")
-            if "e" in time:
-                continue
-            size = int(size)
-            time = int(time)
-            if "binary" in file:
-                binary_buddy[size].append(time)
-            elif "bt" in file:
-                bt_buddy[size].append(time)
-            elif "ibuddy" in file:
-                ibuddy_buddy[size].append(time)
-            elif "lazy" in file:
-                lazy_buddy[size].append(time)
+    metadata, rows = read_results(file, legacy_columns=["time_ns", "size"])
+    metadatas.append(metadata)
+    for row in rows:
+        if metadata:
+            name = row["allocator"]
+            if metadata.get("lazy", 0) > 0:
+                name = "lazy" if name == "bt" else f"{name} lazy"
+            op = row["op"]
+        else:
+            name = next(n for n in ["binary", "bt", "ibuddy", "lazy"] if n in file.split("/")[-1])
+        sizes = series.setdefault(name, {2**x: [] for x in range(4,19)})
+        sizes[row["size"]].append(row["time_ns"])
+
+check_comparable(metadatas)
+for metadata in metadatas:
+    if metadata:
+        print(f"{metadata['benchmark']}: {metadata['cpu']}, {metadata['compiler']} {metadata['flags']}, lazy {metadata.get('lazy')}")
 
 cm = 1/2.54
 plt.figure(figsize=(20*cm,8*cm))
 plt.margins(x=0.016)
 
-# print(binary_buddy)
-binary_buddy = {str(k): np.mean(v) for k,v in binary_buddy.items()}
-bt_buddy = {str(k): np.mean(v) for k,v in bt_buddy.items()}
-ibuddy_buddy = {str(k): np.mean(v) for k,v in ibuddy_buddy.items()}
-lazy_buddy = {str(k): np.mean(v) for k,v in lazy_buddy.items()}
+means = {name: {str(k): np.mean(v) for k,v in sizes.items()} for name, sizes in series.items()}
+repetitions = max(len(v) for sizes in series.values() for v in sizes.values())
 
-X_axis = np.arange(len(binary_buddy.keys()))
+X_axis = np.arange(15)
 plt.grid(True, which='both', axis='y', linestyle='--', linewidth=0.5, zorder=0)
 
 # colors = ["#648fff", "#dc267f", "#785ef0", "#fe6100", "#ffb000", "#000000", "#ffffff"]
@@ -46,10 +50,10 @@ plt.grid(True, which='both', axis='y', linestyle='--', linewidth=0.5, zorder=0)
 # colors = ["#0F2080", "#85C0F9", "#A95AA1", "#F5793A"]
 colors = ["#85C0F9", "#0F2080","#A95AA1", "#F5793A"]
 
-plt.bar(X_axis - 0.3, binary_buddy.values(), 0.2, color=colors[0], label='Binary Buddy', zorder=3)
-plt.bar(X_axis - 0.1, bt_buddy.values(), 0.2, color=colors[1], label='Binary Tree', zorder=3)
-plt.bar(X_axis + 0.1, ibuddy_buddy.values(), 0.2, color=colors[2], label='iBuddy', zorder=3)
-plt.bar(X_axis + 0.3, lazy_buddy.values(), 0.2, color=colors[3], label='Lazy Layer', zorder=3)
+width = 0.8 / len(means)
+for i, (name, values) in enumerate(means.items()):
+    offset = (i - (len(means) - 1) / 2) * width
+    plt.bar(X_axis + offset, values.values(), width, color=colors[i % len(colors)], label=labels.get(name, name), zorder=3)
 
 # plt.ylim(0, 600)
 plt.yscale('log')
@@ -78,8 +82,8 @@ x_ticks = [str(i) for i in range(4, 19)]
 plt.xticks(X_axis, x_ticks)
 plt.xlabel("Block Size (log$_2$(B))")
 plt.ylabel("Time (ns)")
-# plt.title("Average Allocation Time for Different Buddy Allocators and Block Sizes (100000 iterations)", pad=10)
-plt.title("Average Deallocation Time for Different Buddy Allocators and Block Sizes (100000 iterations)", pad=10)
+operation = "Deallocation" if op == "free" else "Allocation"
+plt.title(f"Average {operation} Time for Different Buddy Allocators and Block Sizes ({repetitions} iterations)", pad=10)
 plt.legend()
 plt.savefig("test.svg",bbox_inches='tight')
 plt.show()
\ No newline at end of file
@@ -0,0 +1,344 @@
+#!/usr/bin/python3
+
+# Compares two sets of benchmark results, a stored baseline and a candidate,
+# each a results file written with -o or a directory of the files of several
+# runs, whose rows are pooled. The rows are grouped by allocator, config,
+# lazy threshold, size and the other parameters of the benchmark, and every
+# metric of a group is compared with a Mann-Whitney U test, Cliff's delta as
+# the effect size and a bootstrap confidence interval of the change in the
+# median. The p-values are adjusted for the number of comparisons with the
+# Benjamini-Hochberg procedure. Only the standard library is needed, so stored
+# baselines can be checked anywhere. Exits with 1 if a metric regressed.
+#
+#   python3 compare.py baseline.csv candidate.csv
+#   python3 compare.py -a 0.01 -t 5 ../baselines/bt ../results/bt
+
+import argparse
+import math
+import os
+import random
+import sys
+
+from results import check_comparable, read_results
+
+# Columns that tell the measured cases apart
+KEYS = ["allocator", "config", "lazy", "workload", "threads", "regions",
+        "producers", "consumers", "mix", "dist", "survival", "cycle", "op",
+        "level", "size"]
+
+# Metadata that tells the cases apart when it is not a column
+METADATA_KEYS = ["config", "lazy"]
+
+# Measured columns besides the ones named by their unit
+METRICS = ["seconds", "failed", "fragmentation", "relocated_bytes",
+           "scan_retries", "region_waits", "lazy_waits"]
+METRIC_SUFFIXES = ("_ns", "_us", "_per_op", "_per_s", "_frag")
+
+
+def is_metric(column):
+    return column in METRICS or column.endswith(METRIC_SUFFIXES)
+
+
+def higher_is_better(metric):
+    return metric.endswith("_per_s")
+
+
+def load(path, legacy_columns):
+    """Returns the metadata of every file and the rows of all of them."""
+    files = [path]
+    if os.path.isdir(path):
+        files = sorted(os.path.join(path, f) for f in os.listdir(path)
+                       if f.endswith((".csv", ".json", ".txt")))
+    if not files:
+        sys.exit(f"No results files in {path}")
+
+    metadatas = []
+    rows = []
+    for run, file in enumerate(files):
+        metadata, file_rows = read_results(file, legacy_columns)
+        metadatas.append(metadata)
+        for row in file_rows:
+            for key in METADATA_KEYS:
+                if key not in row and key in metadata:
+                    row[key] = metadata[key]
+            if "allocator" not in row and "allocator" in metadata:
+                row["allocator"] = metadata["allocator"]
+            row["run"] = run
+            rows.append(row)
+    return metadatas, rows
+
+
+def group(rows, metrics):
+    """Returns the samples of each metric by case and run."""
+    samples = {}
+    for row in rows:
+        case = tuple((key, row[key]) for key in KEYS
+                     if row.get(key) is not None)
+        for metric in metrics:
+            value = row.get(metric)
+            if isinstance(value, (int, float)):
+                runs = samples.setdefault((case, metric), {})
+                runs.setdefault(row["run"], []).append(value)
+    return samples
+
+
+def units(a_runs, b_runs):
+    """Returns the samples to compare and whether they are runs. Repetitions
+    in one process are not independent, as the heap layout, the caches and
+    the frequency of the CPU stay the same, so with several runs on both sides
+    the median of each run is a sample, and otherwise every repetition."""
+    if len(a_runs) >= 2 and len(b_runs) >= 2:
+        return ([median(v) for v in a_runs.values()],
+                [median(v) for v in b_runs.values()], True)
+    return ([x for v in a_runs.values() for x in v],
+            [x for v in b_runs.values() for x in v], False)
+
+
+def ranks(values):
+    """Returns the ranks of the values, the mean rank for ties, and the
+    tie correction term of the U test variance."""
+    order = sorted(range(len(values)), key=values.__getitem__)
+    result = [0.0] * len(values)
+    ties = 0
+    i = 0
+    while i < len(order):
+        j = i
+        while j + 1 < len(order) and values[order[j + 1]] == values[order[i]]:
+            j += 1
+        for k in range(i, j + 1):
+            result[order[k]] = (i + j) / 2 + 1
+        count = j - i + 1
+        ties += count ** 3 - count
+        i = j + 1
+    return result, ties
+
+
+def exact_p(u, m, n):
+    """Two-sided p-value of U from its exact distribution without ties."""
+    # f[i][j][v] is the number of orderings of i values of the first sample
+    # and j of the second with v pairs where the first is larger, which has
+    # the distribution of U. The largest value adds j pairs if it is of the
+    # first sample.
+    f = [[[0] * (m * n + 1) for _ in range(n + 1)] for _ in range(m + 1)]
+    for i in range(m + 1):
+        for j in range(n + 1):
+            if i == 0 or j == 0:
+                f[i][j][0] = 1
+                continue
+            for v in range(i * j + 1):
+                f[i][j][v] = ((f[i - 1][j][v - j] if v >= j else 0) +
+                              f[i][j - 1][v])
+    low = int(min(u, m * n - u))
+    tail = sum(f[m][n][:low + 1]) / math.comb(m + n, m)
+    return min(1.0, 2 * tail)
+
+
+def mann_whitney(a, b):
+    """Returns U of b against a, counting the pairs where b is larger, and the
+    two-sided p-value, exact for small samples without ties."""
+    m, n = len(a), len(b)
+    combined_ranks, ties = ranks(a + b)
+    u = sum(combined_ranks[m:]) - n * (n + 1) / 2
+    if ties == 0 and m <= 20 and n <= 20:
+        return u, exact_p(u, m, n)
+
+    mean = m * n / 2
+    variance = m * n / 12 * ((m + n + 1) - ties / ((m + n) * (m + n - 1)))
+    if variance <= 0:
+        return u, 1.0
+    z = (abs(u - mean) - 0.5) / math.sqrt(variance)
+    return u, min(1.0, math.erfc(max(z, 0.0) / math.sqrt(2)))
+
+
+def median(values):
+    ordered = sorted(values)
+    middle = len(ordered) // 2
+    if len(ordered) % 2:
+        return ordered[middle]
+    return (ordered[middle - 1] + ordered[middle]) / 2
+
+
+def bootstrap_medians(ordered, resamples, rng):
+    """Draws the median of resamples of the sorted values. The median of a
+    resample of n values is the value at the index of the median of n uniform
+    draws, whose distribution is Beta(h, n + 1 - h) with h = (n + 1) // 2, so
+    each one costs a single draw instead of a resample and a sort."""
+    n = len(ordered)
+    h = (n + 1) // 2
+    medians = []
+    for _ in range(resamples):
+        draw = rng.betavariate(h, n + 1 - h)
+        index = min(n - 1, int(math.ceil(n * draw)) - 1)
+        medians.append(ordered[max(index, 0)])
+    return medians
+
+
+def relative_change(before, after):
+    if before == 0:
+        return 0.0 if after == 0 else math.inf
+    return after / before - 1
+
+
+def change_interval(a, b, confidence, resamples, rng):
+    """Bootstrap confidence interval of the relative change in the median."""
+    a_medians = bootstrap_medians(sorted(a), resamples, rng)
+    b_medians = bootstrap_medians(sorted(b), resamples, rng)
+    changes = sorted(map(relative_change, a_medians, b_medians))
+    tail = (1 - confidence) / 2
+    low = changes[int(tail * (resamples - 1))]
+    high = changes[int(math.ceil((1 - tail) * (resamples - 1)))]
+    return low, high
+
+
+def magnitude(delta):
+    """Describes Cliff's delta with the thresholds of Romano et al."""
+    delta = abs(delta)
+    if delta < 0.147:
+        return "negligible"
+    if delta < 0.33:
+        return "small"
+    if delta < 0.474:
+        return "medium"
+    return "large"
+
+
+def adjust(p_values):
+    """Benjamini-Hochberg adjusted p-values, in the same order."""
+    order = sorted(range(len(p_values)), key=p_values.__getitem__)
+    adjusted = [1.0] * len(p_values)
+    smallest = 1.0
+    for rank in range(len(order), 0, -1):
+        i = order[rank - 1]
+        smallest = min(smallest, p_values[i] * len(p_values) / rank)
+        adjusted[i] = smallest
+    return adjusted
+
+
+def sort_key(key):
+    case, metric = key
+    return [(name, (0, value) if isinstance(value, (int, float))
+             else (1, str(value))) for name, value in case], metric
+
+
+def compare(baseline, candidate, args):
+    """Returns the comparison of each metric of the cases in both runs."""
+    rng = random.Random(args.seed)
+    comparisons = []
+    for key in sorted(baseline.keys() & candidate.keys(), key=sort_key):
+        a, b, runs = units(baseline[key], candidate[key])
+        if len(a) < 2 or len(b) < 2:
+            continue
+        u, p = mann_whitney(a, b)
+        comparisons.append({
+            "case": key[0], "metric": key[1], "n": (len(a), len(b)),
+            "runs": runs, "medians": (median(a), median(b)),
+            "change": relative_change(median(a), median(b)),
+            "interval": change_interval(a, b, 1 - args.alpha, args.resamples,
+                                        rng),
+            "delta": 2 * u / (len(a) * len(b)) - 1, "p": p})
+
+    # A change is flagged if the adjusted p-value is below alpha, the
+    # interval leaves out no change and it is at least the threshold
+    for comparison, q in zip(comparisons,
+                             adjust([c["p"] for c in comparisons])):
+        comparison["q"] = q
+        change = comparison["change"]
+        low, high = comparison["interval"]
+        if q >= args.alpha or low <= 0 <= high or \
+                abs(change) * 100 < args.threshold:
+            comparison["verdict"] = ""
+        elif (change > 0) == higher_is_better(comparison["metric"]):
+            comparison["verdict"] = "improved"
+        else:
+            comparison["verdict"] = "REGRESSED"
+    return comparisons
+
+
+def describe(case):
+    return " ".join(f"{key}={value}" for key, value in case)
+
+
+def print_comparisons(comparisons, verbose):
+    shown = [c for c in comparisons if verbose or c["verdict"]]
+    if not shown:
+        return
+    width = max(len(describe(c["case"])) for c in shown)
+    print(f"{'case':<{width}} {'metric':<14} {'samples':>13} "
+          f"{'baseline':>10} {'candidate':>10} {'change':>8} "
+          f"{'interval':>17} {'delta':>6} {'effect':<10} {'q':>8}  verdict")
+    for c in shown:
+        low, high = c["interval"]
+        samples = f"{c['n'][0]}/{c['n'][1]} {'runs' if c['runs'] else 'reps'}"
+        print(f"{describe(c['case']):<{width}} {c['metric']:<14} "
+              f"{samples:>13} {c['medians'][0]:>10.4g} "
+              f"{c['medians'][1]:>10.4g} {c['change']:>+8.2%} "
+              f"[{low:>+7.2%},{high:>+7.2%}] {c['delta']:>+6.2f} "
+              f"{magnitude(c['delta']):<10} {c['q']:>8.2g}  {c['verdict']}")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Flags significant differences between benchmark runs")
+    parser.add_argument("baseline",
+                        help="baseline results file, or a directory of "
+                             "the results of several runs")
+    parser.add_argument("candidate",
+                        help="candidate results file or directory")
+    parser.add_argument("-m", "--metrics", default=None,
+                        help="comma separated metrics to compare "
+                             "(every measured column)")
+    parser.add_argument("-a", "--alpha", type=float, default=0.05,
+                        help="significance level of the adjusted p-values "
+                             "and the intervals (0.05)")
+    parser.add_argument("-t", "--threshold", type=float, default=1.0,
+                        help="smallest change in percent worth flagging (1)")
+    parser.add_argument("-b", "--resamples", type=int, default=10000,
+                        help="bootstrap resamples (10000)")
+    parser.add_argument("-s", "--seed", type=int, default=1,
+                        help="bootstrap random seed (1)")
+    parser.add_argument("-c", "--columns", default=None,
+                        help="comma separated columns of files without "
+                             "metadata, such as time_ns,size for ../runs")
+    parser.add_argument("-v", "--verbose", action="store_true",
+                        help="print every comparison, not only the "
+                             "flagged ones")
+    args = parser.parse_args()
+
+    legacy_columns = args.columns.split(",") if args.columns else None
+
+    base_metadatas, base_rows = load(args.baseline, legacy_columns)
+    cand_metadatas, cand_rows = load(args.candidate, legacy_columns)
+    check_comparable(base_metadatas + cand_metadatas)
+
+    columns = {column for row in base_rows + cand_rows for column in row}
+    if args.metrics:
+        metrics = args.metrics.split(",")
+    else:
+        metrics = sorted(column for column in columns if is_metric(column))
+    baseline = group(base_rows, metrics)
+    candidate = group(cand_rows, metrics)
+
+    comparisons = compare(baseline, candidate, args)
+    print_comparisons(comparisons, args.verbose)
+
+    unmatched = len(baseline.keys() ^ candidate.keys())
+    skipped = len(baseline.keys() & candidate.keys()) - len(comparisons)
+    regressed = sum(c["verdict"] == "REGRESSED" for c in comparisons)
+    improved = sum(c["verdict"] == "improved" for c in comparisons)
+    print(f"{len(comparisons)} comparisons: {regressed} regressed, "
+          f"{improved} improved, {len(comparisons) - regressed - improved} "
+          f"unchanged")
+    if any(not c["runs"] for c in comparisons):
+        print("Cases with a single run on a side were compared by their "
+              "repetitions,\nwhich leaves out the variation between runs: "
+              "give directories of several runs")
+    if skipped:
+        print(f"{skipped} cases with fewer than 2 samples on a side were "
+              f"skipped")
+    if unmatched:
+        print(f"{unmatched} cases are in only one of the runs")
+    sys.exit(1 if regressed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,13 +6,33 @@ import numpy as np
 
 import sys
 
+from results import read_results
+
 HEAP_SIZE = 2097152
 
 def parse_input_file(file_path):
     with open(file_path, 'r') as file:
         input_text = file.read()
+    if input_text.startswith("#") or input_text.lstrip().startswith("{"):
+        return parse_results(file_path)
     return parse_input(input_text)
 
+# Reads a results file of add_frees -o, with a row per free hole size at each
+# failed allocation
+def parse_results(file_path):
+    metadata, rows = read_results(file_path)
+    collections = {}
+    for row in rows:
+        fail_size, frag_size = collections.get(row["collection"], (row["failed_size"], 0))
+        collections[row["collection"]] = (fail_size, frag_size + row["hole_size"] * row["count"])
+    ratios = []
+    fails = []
+    for collection in sorted(collections):
+        fail_size, frag_size = collections[collection]
+        fails.append(fail_size)
+        ratios.append(frag_size / fail_size if frag_size != 0 else 0)
+    return ratios, fails
+
 def parse_input(input_text):
     fail_size = 0
     frag_size = 0
@@ -22,6 +42,8 @@ def parse_input(input_text):
         if "FAILED" in line.strip():
             fail_size = int(line.strip().split(" ")[1])
             fails.append(fail_size)
+        elif "FRAGMENTATION" in line.strip():
+            continue
         elif "END" in line.strip():
             free_hole = int(line.strip().split(" ")[1])
             frag_size += free_hole
@@ -101,10 +123,14 @@ def split_powers(x):
     return powers
 
 def main():
+    # The add_frees output of the binary, bt and ibuddy allocators, either
+    # results files written with -o or the printed text
     PROGRAM = "heap"
-    binary_ratios, binary_fails  = parse_input_file(f"./collections/{PROGRAM}_binary.txt")
-    bt_ratios, bt_fails = parse_input_file(f"./collections/{PROGRAM}_bt.txt")
-    ibuddy_ratios, ibuddy_fails = parse_input_file(f"./collections/{PROGRAM}_ibuddy.txt")
+    files = sys.argv[1:4] if len(sys.argv) == 4 else [
+        f"./collections/{PROGRAM}_{name}.txt" for name in ("binary", "bt", "ibuddy")]
+    binary_ratios, binary_fails  = parse_input_file(files[0])
+    bt_ratios, bt_fails = parse_input_file(files[1])
+    ibuddy_ratios, ibuddy_fails = parse_input_file(files[2])
 
     print(binary_ratios)
 
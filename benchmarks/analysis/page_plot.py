@@ -3,28 +3,36 @@ import matplotlib.ticker as ticker
 from matplotlib.ticker import ScalarFormatter
 import numpy as np
 
+import sys
+
+from results import check_comparable, read_results
+
 x = [16,32,64,128,256,512,1024,2048,4096,8192,16384,32768,65536,131072,262144]
 
 # files = ["page_binary.txt", "page_bt.txt", "page_ibuddy.txt"]
-files = ["page_binary_server.txt", "page_bt_server.txt", "page_ibuddy_server.txt"]
+# Results files of bench_page -o, or the older runs without metadata
+files = sys.argv[1:] or ["../runs/" + f for f in ["page_binary_server.txt", "page_bt_server.txt", "page_ibuddy_server.txt"]]
 
 binary_buddy = {2**x: [] for x in range(4,19)}
 bt_buddy = {2**x: [] for x in range(4,19)}
 ibuddy_buddy = {2**x: [] for x in range(4,19)}
 
+metadatas = []
 for file in files:
-    with open("../runs/" + file) as f:
-        for line in f:
-            time, size = line.split(" ")
-            # print(time, size)
-            size = int(size)
-            time = float(time)
-            if "binary" in file:
-                binary_buddy[size].append(time)
-            elif "bt" in file:
-                bt_buddy[size].append(time)
-            elif "ibuddy" in file:
-                ibuddy_buddy[size].append(time)
+    metadata, rows = read_results(file, legacy_columns=["time_us", "size"])
+    metadatas.append(metadata)
+    allocator = metadata.get("allocator", file.split("/")[-1])
+    for row in rows:
+        size = row["size"]
+        time = row["time_us"]
+        if "binary" in allocator:
+            binary_buddy[size].append(time)
+        elif "bt" in allocator:
+            bt_buddy[size].append(time)
+        elif "ibuddy" in allocator:
+            ibuddy_buddy[size].append(time)
+
+check_comparable(metadatas)
 
 binary_buddy = {str(k): round(np.mean(v), 3) for k,v in binary_buddy.items()}
 bt_buddy = {str(k): round(np.mean(v), 3) for k,v in bt_buddy.items()}
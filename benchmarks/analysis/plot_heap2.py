@@ -6,26 +6,20 @@ import numpy as np
 
 import sys
 
-HEAP_SIZE = 2097152
+from results import read_results
 
+# Reads the heap states heap.out -s writes, returning for each allocator a
+# list of (used bytes, heap bytes, {free block size: count})
 def parse_input_file(file_path):
-    with open(file_path, 'r') as file:
-        input_text = file.read()
-    return parse_input(input_text)
-
-def parse_input(input_text):
-    result = []
-    current_group = {}
-    for line in input_text.split('\n')[:-1]:
-        if "END" in line.strip():
-            last_free = int(line.strip().split(" ")[1])
-            result.append((last_free, current_group))
-            current_group = {}
-        else:
-            values = line.strip().split()
-            current_group[int(values[1])] = int(values[0])
-    if current_group:
-        result.append(current_group)
+    metadata, rows = read_results(file_path)
+    result = {}
+    for row in rows:
+        holes = {}
+        for hole in str(row["holes"] or "").split():
+            count, _, size = hole.partition("x")
+            holes[int(size)] = int(count)
+        result.setdefault(row["allocator"], []).append(
+            (row["used_bytes"], row["heap_bytes"], holes))
     return result
 
 def total_hole_free(data):
@@ -33,18 +27,17 @@ def total_hole_free(data):
 
 def transform_data(data):
     transformed_data = []
-    for (used, holes) in data:
-        used_bytes = HEAP_SIZE - used
+    for (used_bytes, heap_size, holes) in data:
         hole_total = total_hole_free(holes)
 
         # How much of the heap is "used"
-        used_ratio = used_bytes / HEAP_SIZE
+        used_ratio = used_bytes / heap_size
 
         # Size of all holes in relation to the total heap size
-        heap_ratio = hole_total / HEAP_SIZE
+        heap_ratio = hole_total / heap_size
 
         # Size of all holes in relation to used memory
-        hole_ratio = hole_total / used_bytes
+        hole_ratio = hole_total / used_bytes if used_bytes else 0
 
         # 16
         # 32
@@ -78,9 +71,11 @@ def transform_data(data):
 
 def main():
     PROGRAM = "nano"
-    binary_buddy = transform_data(parse_input_file(f"./collections/binary_{PROGRAM}.txt"))
-    bt_buddy = transform_data(parse_input_file(f"./collections/bt_{PROGRAM}.txt"))
-    ibuddy = transform_data(parse_input_file(f"./collections/ibuddy_{PROGRAM}.txt"))
+    # heap.out -a binary,bt,ibuddy -s <file> <trace>
+    data = parse_input_file(sys.argv[1] if len(sys.argv) > 1 else f"./collections/heap_{PROGRAM}.csv")
+    binary_buddy = transform_data(data["binary"])
+    bt_buddy = transform_data(data["bt"])
+    ibuddy = transform_data(data["ibuddy"])
 
     print(*binary_buddy, sep='\n')
     print()
@@ -0,0 +1,58 @@
+#!/usr/bin/python3
+
+# Reads the results files the benchmarks write with -o: CSV with the run
+# metadata in leading "# key: value" lines, or JSON with "metadata" and
+# "results". Older runs without metadata, such as ../runs/*.txt, are read as
+# whitespace separated columns.
+
+import csv
+import json
+import sys
+
+
+def convert(value):
+    if value is None or value == "":
+        return None
+    for kind in (int, float):
+        try:
+            return kind(value)
+        except ValueError:
+            pass
+    return value
+
+
+def read_results(path, legacy_columns=None):
+    """Returns the metadata and a list of rows, each a dict by column."""
+    with open(path) as file:
+        text = file.read()
+
+    if text.lstrip().startswith("{"):
+        data = json.loads(text)
+        return data["metadata"], data["results"]
+
+    metadata = {}
+    lines = []
+    for line in text.splitlines():
+        if line.startswith("# "):
+            key, _, value = line[2:].partition(": ")
+            metadata[key] = convert(value)
+        elif line.strip():
+            lines.append(line)
+
+    if not metadata and legacy_columns is not None:
+        rows = [dict(zip(legacy_columns, map(convert, line.split())))
+                for line in lines]
+        return metadata, rows
+
+    rows = [{key: convert(value) for key, value in row.items()}
+            for row in csv.DictReader(lines)]
+    return metadata, rows
+
+
+def check_comparable(metadatas):
+    """Warns about runs that differ in machine or build."""
+    for key in ("cpu", "cpus", "compiler", "flags"):
+        values = {str(m.get(key)) for m in metadatas if key in m}
+        if len(values) > 1:
+            print(f"Warning: the runs differ in {key}: {', '.join(sorted(values))}",
+                  file=sys.stderr)
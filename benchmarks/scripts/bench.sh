@@ -1,24 +1,7 @@
 #!/bin/bash
 
-total_time=0
-ignored=0
-
-# Run the program 12 times
-for ((i=1; i<=12; i++))
-do
-    echo "Running iteration $i"
-    # Run the program and extract the time from the output
-    result=$(./benchmark_threads.out | grep "Concurrent took:" | awk '{print $3}')
-    
-    if [ $i -gt 2 ]; then
-        # Add the time to the total
-        total_time=$(echo "$total_time + $result" | bc)
-    else
-        ((ignored++))
-    fi
-done
-
-# Calculate the average of the last 10 runs
-average=$(echo "scale=4; $total_time / (12 - $ignored)" | bc)
-
-echo "Average time of the last 10 runs: $average seconds"
\ No newline at end of file
+# Runs the benchmark 12 times in one process and averages the last 10 runs,
+# the same workload as benchmark_threads: 2 MiB of 16 byte allocations on a
+# binary tree allocator on one thread
+./bench.out -a bt -c malloc -s 16 -n 131072 -W 2 -r 10 |
+    awk 'NR == 2 {print "Average time of the last 10 runs: " $7 " seconds"}'
@@ -1,29 +1,19 @@
 #!/bin/bash
 
+# Times single allocations and frees of every block size, 10000 times each
+# after a warmup, all within one process per allocator. Writes "time size"
+# records to <version>.txt and <version>_free.txt, the format of benchmarks/runs.
+
+bench=./bench_single_alloc.out
+
 run_version() {
     version="$1"
-    for ((i = 4; i <= 18; i++)); do
-        alloc=$((2 ** i))
-        echo "" > "$version"_"$alloc".txt
-    done
-    echo "" > "$version"_32.txt
-    echo "" > "$version"_64.txt
-
-    for ((i = 4; i <= 18; i++)); do
-        alloc=$((2 ** i))
-        echo $alloc
-        for ((j = 1; j <= 10000; j++)); do
-            # Run the program and append the result to a temporary file
-            result=$(./"bench_$version.out" "$alloc")
-            #echo "$result" >> "$version"_
-            #sum=$(awk "BEGIN {print $sum + $result; exit}")
-            echo $result >> "$version"_"$alloc".txt
-        done
-    done
+    shift
+    "$bench" "$@" -n 10000 -w 100 > "$version".txt
+    "$bench" "$@" -n 10000 -w 100 -f > "$version"_free.txt
 }
 
-# Run each program with different allocators and save output to respective files
-run_version "bt"
-run_version "binary" 
-run_version "ibuddy"
-run_version "lazy"
\ No newline at end of file
+run_version "bt" -a bt
+run_version "binary" -a binary
+run_version "ibuddy" -a ibuddy
+run_version "lazy" -a bt -l 10
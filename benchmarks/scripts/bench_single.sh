@@ -10,21 +10,5 @@ fi
 N=$1    # Number of iterations
 size=$2 # Size sent to the program
 
-# Initialize sum of outputs
-total_output=0
-
-# Loop N times to run the program and accumulate outputs
-for (( i=1; i<=$N; i++ ))
-do
-    # Run the program and capture the output
-    output=$(./bench_single_alloc.out "$size")
-    
-    # Add the output to the total
-    total_output=$((total_output + output))
-done
-
-# Calculate average output
-average_output=$((total_output / N))
-
-# Print the average output
-echo "$average_output"
\ No newline at end of file
+# Print the average time of N allocations, measured in one process
+./bench_single_alloc.out -s "$size" -n "$N" -m | awk '{print $3}'
@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# Records the malloc calls of a program with src/tracelib.so, converts the
+# capture of its process into <program>.bin and replays that on every
+# allocator. Processes the program starts write captures of their own, which
+# are left in the capture directory. Run from benchmarks/src, for example
+#   ../scripts/capture.sh sort -o /dev/null words.txt
+
+if [ $# -eq 0 ]; then
+    echo "Usage: $0 <program> [arguments]"
+    exit 1
+fi
+
+library=$(realpath ../../src/tracelib.so) || exit 1
+captures=$(mktemp -d)
+trace=$(basename "$1").bin
+
+env LD_PRELOAD="$library" BUDDY_TRACE="$captures/capture" "$@" &
+pid=$!
+wait $pid
+
+./trace_convert.out "$captures/capture.$pid.raw" "$trace" || exit 1
+echo "Captures in $captures, trace in $trace"
+./trace_replay.out "$trace" all
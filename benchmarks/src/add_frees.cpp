@@ -23,6 +23,10 @@
 #include "../../include/ibuddy.hpp"
 #include "../../include/ibuddy_instantiations.hpp"
 
+#include "results.hpp"
+
+#include <unistd.h>
+
 struct Operation {
   char type;
   std::string id;
@@ -83,7 +87,10 @@ std::vector<size_t> collect_heap_holes(void *heap_start) {
   return holes;
 }
 
-void dump_heap_state(void *heap_start) {
+// Prints the free holes by size, and writes them to the results as one row
+// per hole size, the last free hole, which ends the heap, in a row of its own
+void dump_heap_state(void *heap_start, ResultsFile &results, size_t collection,
+                     size_t failed_size, float fragmentation) {
   std::map<size_t, size_t> counts;
   std::vector<size_t> holes = collect_heap_holes(heap_start);
   size_t last_free = 0;
@@ -98,9 +105,12 @@ void dump_heap_state(void *heap_start) {
 
   for (const auto &pair : counts) {
     std::cout << std::setw(7) << pair.second << " " << pair.first << std::endl;
+    results.row(collection, failed_size, fragmentation, pair.first,
+                pair.second, 0);
   }
 
   std::cout << "END " << last_free << std::endl;
+  results.row(collection, failed_size, fragmentation, last_free, 1, 1);
 }
 
 void print_free_blocks(void *heap_start) {
@@ -153,8 +163,9 @@ void process_file(const std::string &filename) {
 }
 
 void apply_distribution(BuddyAllocator<ZConfig> *allocator, void *heap_start,
-                        size_t step) {
+                        size_t step, ResultsFile &results) {
   size_t counter = 0;
+  size_t collections = 0;
   size_t heap_usage = 0;
   size_t requested_size = 0;
 
@@ -162,6 +173,11 @@ void apply_distribution(BuddyAllocator<ZConfig> *allocator, void *heap_start,
   for (const Operation &op : operations) {
     counter++;
 
+    // Frees are generated below when an allocation fails
+    if (op.type != 'a') {
+      continue;
+    }
+
   retry:
     if (counter % step == 0) {
       // allocator.aggregate();
@@ -188,11 +204,12 @@ void apply_distribution(BuddyAllocator<ZConfig> *allocator, void *heap_start,
     } else {
       // Failed to allocate, start freeing objects.
       if (prev_alloc) {
+        const float fragmentation =
+            (float)(heap_usage - requested_size) / (float)heap_usage;
         std::cout << "FAILED " << op.size << std::endl;
-        std::cout << "FRAGMENTATION "
-                  << (float)(heap_usage - requested_size) / (float)heap_usage
-                  << std::endl;
-        dump_heap_state(heap_start);
+        std::cout << "FRAGMENTATION " << fragmentation << std::endl;
+        dump_heap_state(heap_start, results, collections++, op.size,
+                        fragmentation);
       }
       size_t cutoff = heap_usage / 2;
       // std::cout << "cutoff: " << cutoff << std::endl;
@@ -230,22 +247,46 @@ void apply_distribution(BuddyAllocator<ZConfig> *allocator, void *heap_start,
 }
 
 int main(int argc, char **argv) {
+  std::string output;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:")) != -1) {
+    if (opt == 'o') {
+      output = optarg;
+    } else {
+      return 1;
+    }
+  }
 
-  if (argc < 2) {
-    std::cout << "Usage: ./" << argv[0] << " <filename>" << std::endl;
+  if (argc - optind < 1) {
+    std::cout << "Usage: ./" << argv[0]
+              << " [-o results file] <filename> [step]" << std::endl;
     std::cout << "The provided file should describe an allocation/free pattern "
                  "on the following form:"
               << std::endl;
     std::cout << "Allocation:\t 'a <id> <size>'" << std::endl;
     std::cout << "Free:\t\t 'f <id> <size>'" << std::endl;
+    std::cout << "The results file is CSV, or JSON for .json, with a row per "
+                 "free hole size at each failed allocation"
+              << std::endl;
     exit(1);
   }
 
-  std::string filename = argv[1];
+  std::string filename = argv[optind];
   size_t step = 1000;
 
-  if (argc == 3) {
-    step = std::stoi(argv[2]);
+  if (argc - optind == 2) {
+    step = std::stoi(argv[optind + 1]);
+  }
+
+  ResultsFile results(argc, argv);
+  results.set("allocator", "bt");
+  results.set("config", "z");
+  results.set("lazy", 0);
+  results.set("input", filename);
+  if (!output.empty() &&
+      !results.open(output, {"collection", "failed_size", "fragmentation",
+                             "hole_size", "count", "trailing"})) {
+    return 1;
   }
 
   void *pool = mmap_allocate(PAGE_SIZE);
@@ -253,11 +294,12 @@ int main(int argc, char **argv) {
       // BinaryBuddyAllocator<ZConfig>::create(nullptr, pool, 0, false);
       BTBuddyAllocator<ZConfig>::create(nullptr, pool, 0, false);
   // IBuddyAllocator<ZConfig>::create(nullptr, pool, 0, false);
+  // allocator->set_placement(Placement::BestFit);
 
   process_file(filename);
 
   // auto start_time = std::chrono::high_resolution_clock::now();
-  apply_distribution(allocator, pool, step);
+  apply_distribution(allocator, pool, step, results);
   // print_heap(pool);
   // print_free_blocks(pool);
 
@@ -266,5 +308,5 @@ int main(int argc, char **argv) {
   // const double seconds = std::chrono::duration<double>(duration).count();
   // std::cout << seconds << std::endl;
 
-  return 0;
+  return results.close() ? 0 : 1;
 }
@@ -0,0 +1,167 @@
+#ifndef ALLOCATORS_HPP_
+#define ALLOCATORS_HPP_
+
+#include "../../include/buddy_allocator.hpp"
+#include "../../include/buddy_config.hpp"
+#include "../../include/buddy_instantiations.hpp"
+
+#include "../../include/bbuddy.hpp"
+#include "../../include/bbuddy_instantiations.hpp"
+
+#include "../../include/btbuddy.hpp"
+#include "../../include/btbuddy_instantiations.hpp"
+
+#include "../../include/ibuddy.hpp"
+#include "../../include/ibuddy_instantiations.hpp"
+
+#include "../../include/wbtbuddy.hpp"
+#include "../../include/wbtbuddy_instantiations.hpp"
+
+#include "baselines.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+#include <sys/mman.h>
+
+// Allocators the benchmarks can create by name, the buddy allocators followed
+// by the baselines
+static const char *const allocatorNames[] = {
+    "binary", "bt", "bt-blocked", "wbt", "wbt8", "ibuddy", "malloc", "tlsf"};
+static const size_t numAllocatorNames =
+    sizeof(allocatorNames) / sizeof(allocatorNames[0]);
+static const size_t numBuddyAllocatorNames = 6;
+
+// Configs the benchmarks can use by name, see buddy_config.hpp. The
+// TuneConfig variants are left to autotune.out, which names them by region
+// count and size map.
+static const char *const configNames[] = {
+    "z",      "small-single", "small-double", "large-quad",
+    "malloc", "stats",        "z-stats"};
+static const size_t numConfigNames =
+    sizeof(configNames) / sizeof(configNames[0]);
+
+// Calls the function with a null pointer of the named config. Returns false
+// for an unknown name.
+template <typename Function>
+bool with_config(const std::string &name, Function function) {
+  if (name == "z") {
+    function(static_cast<ZConfig *>(nullptr));
+  } else if (name == "small-single") {
+    function(static_cast<SmallSingleConfig *>(nullptr));
+  } else if (name == "small-double") {
+    function(static_cast<SmallDoubleConfig *>(nullptr));
+  } else if (name == "large-quad") {
+    function(static_cast<LargeQuadConfig *>(nullptr));
+  } else if (name == "malloc") {
+    function(static_cast<MallocConfig *>(nullptr));
+  } else if (name == "stats") {
+    function(static_cast<StatsConfig *>(nullptr));
+  } else if (name == "z-stats") {
+    function(static_cast<ZStatsConfig *>(nullptr));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <typename Config> size_t heap_size() {
+  return Config::numRegions * Config::maxBlockSize;
+}
+
+// Maps an allocator object and its heap, and unmaps them once the function
+// has run on the allocator
+template <typename Allocator, typename Config, typename Function>
+bool with_buddy(int lazyThreshold, Function function) {
+  void *addr = mmap(nullptr, sizeof(Allocator), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void *start = mmap(nullptr, heap_size<Config>(), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED || start == MAP_FAILED) {
+    std::cerr << "Failed to mmap memory" << std::endl;
+    return false;
+  }
+
+  function(Allocator::create(addr, start, lazyThreshold, false));
+
+  munmap(addr, sizeof(Allocator));
+  munmap(start, heap_size<Config>());
+  return true;
+}
+
+// TLSF gets the buddy heap plus room for a header per smallest block, so it
+// can hold every allocation the buddy allocators can
+template <typename Config> size_t tlsf_pool_size() {
+  return heap_size<Config>() +
+         (heap_size<Config>() / Config::minBlockSize + 2) * TLSFBaseline::overhead;
+}
+
+template <typename Config, typename Function>
+bool with_tlsf(Function function) {
+  void *pool = mmap(nullptr, tlsf_pool_size<Config>(), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pool == MAP_FAILED) {
+    std::cerr << "Failed to mmap memory" << std::endl;
+    return false;
+  }
+
+  TLSFBaseline *allocator = new TLSFBaseline(pool, tlsf_pool_size<Config>());
+  function(allocator);
+  delete allocator;
+
+  munmap(pool, tlsf_pool_size<Config>());
+  return true;
+}
+
+// Calls the function with a null pointer of the named buddy allocator class,
+// for benchmarks that create the allocators themselves. Returns false for any
+// other name.
+template <typename Config, typename Function>
+bool with_buddy_type(const std::string &name, Function function) {
+  if (name == "binary") {
+    function(static_cast<BinaryBuddyAllocator<Config> *>(nullptr));
+  } else if (name == "bt") {
+    function(static_cast<BTBuddyAllocator<Config> *>(nullptr));
+  } else if (name == "bt-blocked") {
+    function(static_cast<BTBuddyAllocator<Config, true> *>(nullptr));
+  } else if (name == "wbt") {
+    function(static_cast<WBTBuddyAllocator<Config, 4> *>(nullptr));
+  } else if (name == "wbt8") {
+    function(static_cast<WBTBuddyAllocator<Config, 8> *>(nullptr));
+  } else if (name == "ibuddy") {
+    function(static_cast<IBuddyAllocator<Config> *>(nullptr));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Creates the named allocator with the heap of Config and calls the function
+// with a pointer to it, which must accept every allocator type. The allocator
+// is destroyed afterwards. Returns false for an unknown name or if the memory
+// could not be mapped.
+template <typename Config, typename Function>
+bool with_allocator(const std::string &name, int lazyThreshold,
+                    Function function) {
+  bool created = false;
+  const auto create = [&](auto *type) {
+    using Allocator = typename std::remove_pointer<decltype(type)>::type;
+    created = with_buddy<Allocator, Config>(lazyThreshold, function);
+  };
+  if (with_buddy_type<Config>(name, create)) {
+    return created;
+  } else if (name == "malloc") {
+    MallocBaseline allocator;
+    function(&allocator);
+    return true;
+  } else if (name == "tlsf") {
+    return with_tlsf<Config>(function);
+  }
+
+  std::cerr << "Unknown allocator: " << name << std::endl;
+  return false;
+}
+
+#endif // ALLOCATORS_HPP_
@@ -0,0 +1,483 @@
+#include "allocators.hpp"
+#include "replay_threads.hpp"
+#include "results.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+// Size maps the autotuner can search, "none" or the bits per smallest block
+static const char *const sizeMapNames[] = {"none", "0", "4", "8"};
+static const size_t numSizeMapNames =
+    sizeof(sizeMapNames) / sizeof(sizeMapNames[0]);
+
+static const char *const regionNames[] = {"1", "2", "4", "8", "16"};
+static const size_t numRegionNames =
+    sizeof(regionNames) / sizeof(regionNames[0]);
+
+struct Options {
+  std::vector<std::string> allocators = {
+      allocatorNames, allocatorNames + numBuddyAllocatorNames};
+  std::vector<std::string> regions = {regionNames,
+                                      regionNames + numRegionNames};
+  std::vector<std::string> sizeMaps = {sizeMapNames,
+                                       sizeMapNames + numSizeMapNames};
+  std::vector<int> lazyThresholds = {0, 8, 32, 128};
+  unsigned int threads = 1;
+  unsigned int repetitions = 3;
+  // Free the blocks without their size, as free() does
+  bool sizelessFrees = false;
+  // Weights of the throughput, the p99 latency and the footprint
+  double weights[3] = {1.0, 1.0, 1.0};
+  size_t top = 10;
+  std::string output;
+};
+
+struct Candidate {
+  std::string allocator;
+  int regions = 0;
+  size_t maxBlockSizeLog2 = 0;
+  bool useSizeMap = false;
+  size_t sizeBits = 0;
+  int lazyThreshold = 0;
+  uint64_t failed = 0;
+  double opsPerSecond = 0.0;
+  double p99 = 0.0;
+  size_t peakUsedBytes = 0;
+  size_t peakLiveBytes = 0;
+  double meanExternalFragmentation = 0.0;
+  // Weighted cost against the best candidate, 1 if best at everything
+  double cost = 0.0;
+
+  std::string size_map() const {
+    return useSizeMap ? std::to_string(sizeBits) : "none";
+  }
+
+  // Peak heap use per peak live byte
+  double overhead() const {
+    return peakLiveBytes == 0 ? 1.0
+                              : static_cast<double>(peakUsedBytes) /
+                                    static_cast<double>(peakLiveBytes);
+  }
+};
+
+// Calls the function with a null pointer of the config if its size map holds
+// every level, otherwise does nothing
+template <typename Config, typename Function>
+static void with_fitting_config(Function function, std::true_type) {
+  function(static_cast<Config *>(nullptr));
+}
+
+template <typename Config, typename Function>
+static void with_fitting_config(Function, std::false_type) {}
+
+// Calls the function with a null pointer of the config with the given
+// regions and size map, see TuneConfig, unless 4 size bits can not hold its
+// levels. Returns false for an unknown size map.
+template <int Regions, typename Function>
+static bool with_size_map(const std::string &sizeMap, Function function) {
+  if (sizeMap == "none") {
+    function(static_cast<TuneConfig<Regions, false, 0> *>(nullptr));
+  } else if (sizeMap == "0") {
+    function(static_cast<TuneConfig<Regions, true, 0> *>(nullptr));
+  } else if (sizeMap == "4") {
+    using Config = TuneConfig<Regions, true, 4>;
+    with_fitting_config<Config>(
+        function, std::integral_constant<bool, (Config::numLevels <= 16)>());
+  } else if (sizeMap == "8") {
+    function(static_cast<TuneConfig<Regions, true, 8> *>(nullptr));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <typename Function>
+static bool with_tune_config(const std::string &regions,
+                             const std::string &sizeMap, Function function) {
+  if (regions == "1") {
+    return with_size_map<1>(sizeMap, function);
+  } else if (regions == "2") {
+    return with_size_map<2>(sizeMap, function);
+  } else if (regions == "4") {
+    return with_size_map<4>(sizeMap, function);
+  } else if (regions == "8") {
+    return with_size_map<8>(sizeMap, function);
+  } else if (regions == "16") {
+    return with_size_map<16>(sizeMap, function);
+  }
+  return false;
+}
+
+// Replays the trace on a fresh allocator for every repetition, taking the
+// median throughput and p99 latency, and once more single threaded to track
+// the peak footprint and the fragmentation
+template <typename Config, typename Allocator>
+static bool evaluate(const Options &options, const std::vector<TraceOp> &ops,
+                     uint64_t numIds, Candidate &candidate) {
+  candidate.regions = Config::numRegions;
+  candidate.maxBlockSizeLog2 = Config::maxBlockSizeLog2;
+  candidate.useSizeMap = Config::useSizeMap;
+  candidate.sizeBits = Config::sizeBits;
+
+  std::vector<double> seconds;
+  std::vector<double> p99s;
+  const auto timed = [&](Allocator *allocator) {
+    const ThreadedReplayResult result = replay_trace_threads(
+        allocator, ops.data(), ops.size(), numIds, options.threads, 0, 0,
+        nullptr, !options.sizelessFrees);
+    seconds.push_back(result.seconds / std::max<uint64_t>(1, result.ops));
+    p99s.push_back(result.percentile(99));
+    candidate.failed = result.failed;
+  };
+  for (unsigned int r = 0; r < options.repetitions; r++) {
+    if (!with_buddy<Allocator, Config>(candidate.lazyThreshold, timed)) {
+      return false;
+    }
+  }
+  std::sort(seconds.begin(), seconds.end());
+  std::sort(p99s.begin(), p99s.end());
+  candidate.opsPerSecond = 1.0 / std::max(1e-12, seconds[seconds.size() / 2]);
+  candidate.p99 = p99s[p99s.size() / 2];
+
+  const auto measured = [&](Allocator *allocator) {
+    std::vector<TraceLive> live(numIds, TraceLive{nullptr, 0});
+    const uint64_t interval = std::max<uint64_t>(1, ops.size() / 100);
+    size_t liveBytes = 0;
+    size_t samples = 0;
+    for (uint64_t i = 0; i < ops.size(); i++) {
+      const TraceOp &op = ops[i];
+      if (op.type == 'a') {
+        void *addr = allocator->allocate(op.size);
+        live[op.id] = {addr, op.size};
+        liveBytes += addr == nullptr ? 0 : op.size;
+      } else if (op.id != TRACE_NULL_ID && live[op.id].addr != nullptr) {
+        if (options.sizelessFrees) {
+          allocator->deallocate(live[op.id].addr);
+        } else {
+          allocator->deallocate(live[op.id].addr, live[op.id].size);
+        }
+        live[op.id].addr = nullptr;
+        liveBytes -= live[op.id].size;
+      }
+
+      candidate.peakUsedBytes =
+          std::max(candidate.peakUsedBytes,
+                   heap_size<Config>() - allocator->free_size());
+      candidate.peakLiveBytes = std::max(candidate.peakLiveBytes, liveBytes);
+      if ((i + 1) % interval == 0) {
+        candidate.meanExternalFragmentation += allocator->fragmentation();
+        samples++;
+      }
+    }
+    if (samples > 0) {
+      candidate.meanExternalFragmentation /= samples;
+    }
+  };
+  return with_buddy<Allocator, Config>(candidate.lazyThreshold, measured);
+}
+
+// Scores every candidate against the best value of each metric among the
+// candidates with the fewest failed allocations. The others are ranked last.
+static void score(const Options &options, std::vector<Candidate> &candidates) {
+  uint64_t fewest_failed = UINT64_MAX;
+  for (const Candidate &c : candidates) {
+    fewest_failed = std::min(fewest_failed, c.failed);
+  }
+
+  double best_throughput = 0.0;
+  double best_p99 = DBL_MAX;
+  double best_overhead = DBL_MAX;
+  for (const Candidate &c : candidates) {
+    if (c.failed != fewest_failed) {
+      continue;
+    }
+    best_throughput = std::max(best_throughput, c.opsPerSecond);
+    best_p99 = std::min(best_p99, c.p99);
+    best_overhead = std::min(best_overhead, c.overhead());
+  }
+
+  const double total = options.weights[0] + options.weights[1] +
+                       options.weights[2];
+  for (Candidate &c : candidates) {
+    // Latencies are whole nanoseconds, so a p99 of 0 counts as 1
+    c.cost = (options.weights[0] * best_throughput /
+                  std::max(1e-9, c.opsPerSecond) +
+              options.weights[1] * std::max(1.0, c.p99) /
+                  std::max(1.0, best_p99) +
+              options.weights[2] * c.overhead() / best_overhead) /
+             total;
+  }
+
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate &a, const Candidate &b) {
+                     return a.failed != b.failed ? a.failed < b.failed
+                                                 : a.cost < b.cost;
+                   });
+}
+
+// Declaration of the allocator class of a name with the given config
+static std::string class_name(const std::string &name,
+                              const std::string &config) {
+  if (name == "binary") {
+    return "BinaryBuddyAllocator<" + config + ">";
+  } else if (name == "bt") {
+    return "BTBuddyAllocator<" + config + ">";
+  } else if (name == "bt-blocked") {
+    return "BTBuddyAllocator<" + config + ", true>";
+  } else if (name == "wbt") {
+    return "WBTBuddyAllocator<" + config + ", 4>";
+  } else if (name == "wbt8") {
+    return "WBTBuddyAllocator<" + config + ", 8>";
+  }
+  return "IBuddyAllocator<" + config + ">";
+}
+
+static void print_candidates(const std::vector<Candidate> &candidates,
+                             size_t top) {
+  std::cout << std::left << std::setw(12) << "allocator" << std::right
+            << std::setw(8) << "regions" << std::setw(9) << "sizemap"
+            << std::setw(6) << "lazy" << std::setw(8) << "failed"
+            << std::setw(12) << "Mops/s" << std::setw(9) << "p99 ns"
+            << std::setw(10) << "overhead" << std::setw(10) << "ext-frag"
+            << std::setw(8) << "cost" << std::endl;
+  std::cout << std::fixed;
+  for (size_t i = 0; i < candidates.size() && i < top; i++) {
+    const Candidate &c = candidates[i];
+    std::cout << std::left << std::setw(12) << c.allocator << std::right
+              << std::setw(8) << c.regions << std::setw(9) << c.size_map()
+              << std::setw(6) << c.lazyThreshold << std::setw(8) << c.failed
+              << std::setprecision(2) << std::setw(12)
+              << c.opsPerSecond / 1e6 << std::setprecision(0) << std::setw(9)
+              << c.p99 << std::setprecision(3) << std::setw(10)
+              << c.overhead() << std::setw(10)
+              << c.meanExternalFragmentation << std::setw(8) << c.cost
+              << std::endl;
+  }
+  std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+static void print_recommendation(const Candidate &best) {
+  std::ostringstream config;
+  config << "BuddyConfig<4, " << best.maxBlockSizeLog2 << ", "
+         << best.regions << ", "
+         << (best.useSizeMap ? "true" : "false") << ", " << best.sizeBits
+         << ">";
+  std::cout << "\nRecommended:\n"
+            << "  using TunedConfig = " << config.str() << ";\n"
+            << "  auto *allocator = "
+            << class_name(best.allocator, "TunedConfig")
+            << "::create(addr, start, " << best.lazyThreshold << ", false);"
+            << std::endl;
+}
+
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options] <trace>\n"
+      << "Searches the allocators, region counts, size maps and lazy "
+         "thresholds of a\n2 MiB heap for the binary or text trace and "
+         "prints the best.\n"
+      << "  -a allocators   comma separated buddy allocators, or all (all)\n"
+      << "  -r regions      region counts out of 1,2,4,8,16 (all)\n"
+      << "  -b size maps    none, or the size bits 0, 4 and 8 (all), 4 needs "
+         "4 regions\n"
+      << "  -l thresholds   lazy thresholds (0,8,32,128)\n"
+      << "  -t threads      replay threads (1)\n"
+      << "  -n count        timed replays per candidate, the median counts "
+         "(3)\n"
+      << "  -w t:l:f        weights of the throughput, p99 latency and "
+         "footprint (1:1:1)\n"
+      << "  -S              free without the size, which needs a size map\n"
+      << "  -k count        candidates to print (10)\n"
+      << "  -o file         write every candidate as CSV, or JSON for .json"
+      << std::endl;
+}
+
+static std::vector<std::string> split_list(const char *arg,
+                                           const char *const *all,
+                                           size_t numAll) {
+  std::vector<std::string> items;
+  std::istringstream iss(arg);
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (item == "all") {
+      items.insert(items.end(), all, all + numAll);
+    } else if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+static bool parse_weights(const char *arg, double *weights) {
+  std::istringstream iss(arg);
+  char colon1 = 0;
+  char colon2 = 0;
+  return (iss >> weights[0] >> colon1 >> weights[1] >> colon2 >>
+          weights[2]) &&
+         colon1 == ':' && colon2 == ':' && weights[0] >= 0 &&
+         weights[1] >= 0 && weights[2] >= 0 &&
+         weights[0] + weights[1] + weights[2] > 0;
+}
+
+// Replays a trace through every combination of the given allocators, region
+// counts, size maps and lazy thresholds, scores them on a weighted mix of the
+// throughput, the p99 latency and the peak footprint relative to the best
+// candidate, and prints the config and create() call of the best one
+int main(int argc, char **argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:r:b:l:t:n:w:Sk:o:h")) != -1) {
+    switch (opt) {
+    case 'a':
+      options.allocators =
+          split_list(optarg, allocatorNames, numBuddyAllocatorNames);
+      break;
+    case 'r':
+      options.regions = split_list(optarg, regionNames, numRegionNames);
+      break;
+    case 'b':
+      options.sizeMaps = split_list(optarg, sizeMapNames, numSizeMapNames);
+      break;
+    case 'l':
+      options.lazyThresholds.clear();
+      for (const auto &item : split_list(optarg, nullptr, 0)) {
+        options.lazyThresholds.push_back(std::atoi(item.c_str()));
+      }
+      break;
+    case 't':
+      options.threads = std::atoi(optarg);
+      break;
+    case 'n':
+      options.repetitions = std::atoi(optarg);
+      break;
+    case 'w':
+      if (!parse_weights(optarg, options.weights)) {
+        std::cerr << "Invalid weights: " << optarg << std::endl;
+        return 1;
+      }
+      break;
+    case 'S':
+      options.sizelessFrees = true;
+      break;
+    case 'k':
+      options.top = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (options.sizelessFrees) {
+    options.sizeMaps.erase(std::remove(options.sizeMaps.begin(),
+                                       options.sizeMaps.end(), "none"),
+                           options.sizeMaps.end());
+  }
+  if (argc - optind != 1 || options.allocators.empty() ||
+      options.regions.empty() || options.sizeMaps.empty() ||
+      options.lazyThresholds.empty() || options.threads == 0 ||
+      options.repetitions == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<TraceOp> ops;
+  uint64_t numIds = 0;
+  if (!load_trace(argv[optind], ops, numIds)) {
+    return 1;
+  }
+
+  const size_t heapSize = heap_size<TuneConfig<1, false, 0>>();
+  ResultsFile results(argc, argv);
+  results.set("trace", argv[optind]);
+  results.set("heap_size", heapSize);
+  results.set("threads", options.threads);
+  results.set("sizeless_frees", options.sizelessFrees ? "yes" : "no");
+  if (!options.output.empty() &&
+      !results.open(options.output,
+                    {"allocator", "regions", "size_map", "lazy", "failed",
+                     "ops_per_s", "p99_ns", "peak_used_bytes",
+                     "peak_live_bytes", "mean_external_frag", "cost"})) {
+    return 1;
+  }
+
+  std::vector<Candidate> candidates;
+  for (const auto &regions : options.regions) {
+    for (const auto &sizeMap : options.sizeMaps) {
+      for (const auto &name : options.allocators) {
+        for (int lazy : options.lazyThresholds) {
+          Candidate candidate;
+          candidate.allocator = name;
+          candidate.lazyThreshold = lazy;
+          bool fits = false;
+          bool known = false;
+          bool ok = false;
+          const auto run = [&](auto *config) {
+            using Config = typename std::remove_pointer<decltype(config)>::type;
+            fits = true;
+            known = with_buddy_type<Config>(name, [&](auto *type) {
+              using Allocator =
+                  typename std::remove_pointer<decltype(type)>::type;
+              ok = evaluate<Config, Allocator>(options, ops, numIds,
+                                               candidate);
+            });
+          };
+          if (!with_tune_config(regions, sizeMap, run)) {
+            std::cerr << "Unknown regions or size map: " << regions << ", "
+                      << sizeMap << std::endl;
+            return 1;
+          }
+          if (!fits) {
+            continue;
+          }
+          if (!known) {
+            std::cerr << "Unknown allocator: " << name << std::endl;
+            return 1;
+          }
+          if (!ok) {
+            return 1;
+          }
+          candidates.push_back(candidate);
+        }
+      }
+    }
+  }
+
+  if (candidates.empty()) {
+    std::cerr << "No candidates, 4 size bits need 4 or more regions"
+              << std::endl;
+    return 1;
+  }
+
+  score(options, candidates);
+  for (const Candidate &c : candidates) {
+    results.row(c.allocator, c.regions, c.size_map(), c.lazyThreshold,
+                c.failed, c.opsPerSecond, c.p99, c.peakUsedBytes,
+                c.peakLiveBytes, c.meanExternalFragmentation, c.cost);
+  }
+
+  std::cout << candidates.size() << " candidates with a " << heapSize
+            << " byte heap, " << ops.size() << " operations, "
+            << options.threads << " thread(s)\n"
+            << std::endl;
+  print_candidates(candidates, options.top);
+  if (candidates.front().failed > 0) {
+    std::cout << "\nEvery candidate failed allocations, the heap is too "
+                 "small for the trace"
+              << std::endl;
+  }
+  print_recommendation(candidates.front());
+  return results.close() ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+#ifndef BASELINES_HPP_
+#define BASELINES_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+// Non-buddy allocators with the same allocate and deallocate calls as the
+// buddy allocators, to report their results next to a reference
+
+// The C library allocator
+class MallocBaseline {
+public:
+  void *allocate(size_t size) { return std::malloc(size); }
+  void deallocate(void *ptr, size_t /*size*/) { std::free(ptr); }
+  void deallocate(void *ptr) { std::free(ptr); }
+};
+
+// Two-level segregated fit allocator over a fixed pool, the kind of
+// allocator ZGC pages have been managed with. The first level splits sizes
+// by power of two and the second level splits each power of two into
+// slCount ranges, both with a bitmap of the non-empty lists, so allocations
+// and frees take constant time. Blocks carry a 16 byte header and are merged
+// with their free neighbours when freed. One lock covers the whole pool.
+class TLSFBaseline {
+public:
+  TLSFBaseline(void *pool, size_t size) {
+    const auto start = reinterpret_cast<uintptr_t>(pool);
+    const uintptr_t aligned = (start + alignment - 1) & ~(alignment - 1);
+    const size_t pool_size = (size - (aligned - start)) & ~(alignment - 1);
+
+    // One free block followed by an empty used block that ends the pool
+    Block *block = reinterpret_cast<Block *>(aligned);
+    block->prevPhys = nullptr;
+    block->header = pool_size - 2 * headerSize;
+    set_free(block, true);
+    insert_block(block);
+
+    Block *sentinel = next_phys(block);
+    sentinel->prevPhys = block;
+    sentinel->header = 0;
+    set_prev_free(sentinel, true);
+  }
+
+  // Bytes each block takes besides its payload
+  static const size_t overhead = 2 * sizeof(void *);
+
+  void *allocate(size_t size) {
+    if (size == 0 || size > maxSize) {
+      return nullptr;
+    }
+    size = size < minSize ? minSize : (size + alignment - 1) & ~(alignment - 1);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    unsigned int fl, sl;
+    mapping_search(size, fl, sl);
+    Block *block = find_suitable(fl, sl);
+    if (block == nullptr) {
+      return nullptr;
+    }
+    remove_block(block, fl, sl);
+
+    // Return the rest of the block to the free lists if it can hold a block
+    if (block_size(block) >= size + headerSize + minSize) {
+      Block *rest = reinterpret_cast<Block *>(payload(block) + size);
+      rest->prevPhys = block;
+      rest->header = block_size(block) - size - headerSize;
+      set_free(rest, true);
+      next_phys(rest)->prevPhys = rest;
+      set_prev_free(next_phys(rest), true);
+      insert_block(rest);
+      block->header = size | (block->header & prevFreeBit);
+    }
+
+    set_free(block, false);
+    set_prev_free(next_phys(block), false);
+    return reinterpret_cast<void *>(payload(block));
+  }
+
+  // The size is read from the block header
+  void deallocate(void *ptr) { deallocate(ptr, 0); }
+
+  void deallocate(void *ptr, size_t /*size*/) {
+    if (ptr == nullptr) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Block *block =
+        reinterpret_cast<Block *>(reinterpret_cast<uintptr_t>(ptr) - headerSize);
+
+    // Merge with the free neighbours
+    if (is_prev_free(block)) {
+      Block *prev = block->prevPhys;
+      remove_block(prev);
+      prev->header += block_size(block) + headerSize;
+      block = prev;
+      next_phys(block)->prevPhys = block;
+    }
+    Block *next = next_phys(block);
+    if (is_free(next)) {
+      remove_block(next);
+      block->header += block_size(next) + headerSize;
+      next_phys(block)->prevPhys = block;
+    }
+
+    set_free(block, true);
+    set_prev_free(next_phys(block), true);
+    insert_block(block);
+  }
+
+private:
+  struct Block {
+    // Physically previous block, only valid while that block is free
+    Block *prevPhys;
+    // Size of the payload with the free bits in the low bits
+    size_t header;
+    // Free list links, only present in free blocks
+    Block *nextFree;
+    Block *prevFree;
+  };
+
+  static const size_t alignment = 16;
+  static const size_t headerSize = overhead;
+  static const size_t minSize = 2 * sizeof(void *);
+  static const unsigned int slLog2 = 4;
+  static const unsigned int slCount = 1U << slLog2;
+  // Sizes below smallSize all use the first level
+  static const unsigned int flShift = slLog2 + 4;
+  static const size_t smallSize = size_t(1) << flShift;
+  static const unsigned int flCount = 40;
+  static const size_t maxSize = size_t(1) << (flCount + flShift - 2);
+
+  static const size_t freeBit = 1;
+  static const size_t prevFreeBit = 2;
+
+  static size_t block_size(const Block *block) {
+    return block->header & ~(freeBit | prevFreeBit);
+  }
+  static bool is_free(const Block *block) { return block->header & freeBit; }
+  static bool is_prev_free(const Block *block) {
+    return block->header & prevFreeBit;
+  }
+  static void set_free(Block *block, bool free) {
+    block->header = free ? block->header | freeBit : block->header & ~freeBit;
+  }
+  static void set_prev_free(Block *block, bool free) {
+    block->header =
+        free ? block->header | prevFreeBit : block->header & ~prevFreeBit;
+  }
+  static uintptr_t payload(Block *block) {
+    return reinterpret_cast<uintptr_t>(block) + headerSize;
+  }
+  static Block *next_phys(Block *block) {
+    return reinterpret_cast<Block *>(payload(block) + block_size(block));
+  }
+
+  // Lists holding blocks of the given size
+  static void mapping(size_t size, unsigned int &fl, unsigned int &sl) {
+    if (size < smallSize) {
+      fl = 0;
+      sl = static_cast<unsigned int>(size / (smallSize / slCount));
+    } else {
+      const unsigned int log2 = 63 - __builtin_clzll(size);
+      sl = static_cast<unsigned int>((size >> (log2 - slLog2)) ^ slCount);
+      fl = log2 - flShift + 1;
+    }
+  }
+
+  // First list whose blocks all fit the given size
+  static void mapping_search(size_t size, unsigned int &fl, unsigned int &sl) {
+    if (size >= smallSize) {
+      size += (size_t(1) << (63 - __builtin_clzll(size) - slLog2)) - 1;
+    }
+    mapping(size, fl, sl);
+  }
+
+  Block *find_suitable(unsigned int &fl, unsigned int &sl) {
+    uint32_t sl_map = _slBitmaps[fl] & (~0U << sl);
+    if (sl_map == 0) {
+      const uint64_t fl_map =
+          fl + 1 >= 64 ? 0 : _flBitmap & (~uint64_t(0) << (fl + 1));
+      if (fl_map == 0) {
+        return nullptr;
+      }
+      fl = __builtin_ctzll(fl_map);
+      sl_map = _slBitmaps[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return _lists[fl][sl];
+  }
+
+  void insert_block(Block *block) {
+    unsigned int fl, sl;
+    mapping(block_size(block), fl, sl);
+    block->prevFree = nullptr;
+    block->nextFree = _lists[fl][sl];
+    if (block->nextFree != nullptr) {
+      block->nextFree->prevFree = block;
+    }
+    _lists[fl][sl] = block;
+    _flBitmap |= uint64_t(1) << fl;
+    _slBitmaps[fl] |= 1U << sl;
+  }
+
+  void remove_block(Block *block) {
+    unsigned int fl, sl;
+    mapping(block_size(block), fl, sl);
+    remove_block(block, fl, sl);
+  }
+
+  void remove_block(Block *block, unsigned int fl, unsigned int sl) {
+    if (block->prevFree != nullptr) {
+      block->prevFree->nextFree = block->nextFree;
+    } else {
+      _lists[fl][sl] = block->nextFree;
+    }
+    if (block->nextFree != nullptr) {
+      block->nextFree->prevFree = block->prevFree;
+    }
+
+    if (_lists[fl][sl] == nullptr) {
+      _slBitmaps[fl] &= ~(1U << sl);
+      if (_slBitmaps[fl] == 0) {
+        _flBitmap &= ~(uint64_t(1) << fl);
+      }
+    }
+  }
+
+  std::mutex _mutex;
+  uint64_t _flBitmap = 0;
+  uint32_t _slBitmaps[flCount] = {0};
+  Block *_lists[flCount][slCount] = {{nullptr}};
+};
+
+#endif // BASELINES_HPP_
@@ -0,0 +1,394 @@
+#include "../../include/buddy_helper.hpp"
+
+#include "allocators.hpp"
+#include "replay_threads.hpp"
+#include "results.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+struct Options {
+  std::vector<std::string> allocators = {"bt"};
+  std::vector<std::string> configs = {"z"};
+  std::vector<int> lazyThresholds = {0};
+  std::vector<unsigned int> threads = {1};
+  // const, sizes or trace
+  std::string workload = "const";
+  // Size file of the sizes workload or binary trace of the trace workload
+  std::string input;
+  size_t size = 16;
+  // Allocations per thread, 0 fills the allocator
+  size_t count = 0;
+  bool free = false;
+  uint64_t syncInterval = 0;
+  unsigned int crossPercent = 0;
+  // Runs of every combination, averaged, after unmeasured warmup runs
+  unsigned int runs = 1;
+  unsigned int warmupRuns = 0;
+  // Results file, CSV or JSON
+  std::string output;
+};
+
+struct RunResult {
+  uint64_t ops = 0;
+  uint64_t failed = 0;
+  double seconds = 0.0;
+};
+
+// Splits a comma separated list, where "all" stands for every name given
+static std::vector<std::string> split_list(const char *arg,
+                                           const char *const *all,
+                                           size_t numAll) {
+  std::vector<std::string> items;
+  std::istringstream iss(arg);
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (item == "all" && all != nullptr) {
+      items.insert(items.end(), all, all + numAll);
+    } else if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+// Each thread allocates a fixed list of sizes, and frees them afterwards if
+// asked to. The threads start together and the run is timed from the first
+// start until the last one is done.
+template <typename Allocator>
+static RunResult run_sizes(Allocator *allocator,
+                           const std::vector<size_t> &sizes,
+                           unsigned int threads, bool free) {
+  std::vector<std::vector<void *>> allocations(threads);
+  std::vector<uint64_t> failed(threads, 0);
+  std::vector<std::chrono::steady_clock::time_point> start_times(threads);
+  std::vector<std::chrono::steady_clock::time_point> end_times(threads);
+  SpinBarrier barrier(threads);
+
+  auto run = [&](unsigned int t) {
+    std::vector<void *> &allocated = allocations[t];
+    allocated.reserve(sizes.size());
+    barrier.wait();
+    start_times[t] = std::chrono::steady_clock::now();
+    for (const size_t size : sizes) {
+      void *p = allocator->allocate(size);
+      if (p == nullptr) {
+        failed[t]++;
+      }
+      allocated.push_back(p);
+    }
+    if (free) {
+      for (size_t i = 0; i < allocated.size(); i++) {
+        if (allocated[i] != nullptr) {
+          allocator->deallocate(allocated[i], sizes[i]);
+        }
+      }
+    }
+    end_times[t] = std::chrono::steady_clock::now();
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < threads; t++) {
+    workers.emplace_back(run, t);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  RunResult result;
+  result.seconds =
+      std::chrono::duration<double>(
+          *std::max_element(end_times.begin(), end_times.end()) -
+          *std::min_element(start_times.begin(), start_times.end()))
+          .count();
+  for (unsigned int t = 0; t < threads; t++) {
+    result.ops += allocations[t].size();
+    result.failed += failed[t];
+  }
+  if (free) {
+    result.ops += result.ops - result.failed;
+  }
+  return result;
+}
+
+template <typename Config, typename Allocator>
+static RunResult run_workload(Allocator *allocator,
+                              const Options &options,
+                              const std::vector<size_t> &sizes,
+                              const TraceFile &trace, unsigned int threads) {
+  if (options.workload == "trace") {
+    RunResult result;
+    if (threads == 1 && options.syncInterval == 0 &&
+        options.crossPercent == 0) {
+      const ReplayResult replay = replay_trace(allocator, trace);
+      result.ops = replay.ops;
+      result.failed = replay.failed;
+      result.seconds = replay.seconds;
+    } else {
+      const ThreadedReplayResult replay =
+          replay_trace_threads(allocator, trace, threads, options.syncInterval,
+                               options.crossPercent);
+      result.ops = replay.ops;
+      result.failed = replay.failed;
+      result.seconds = replay.seconds;
+    }
+    return result;
+  }
+
+  if (options.workload == "sizes") {
+    std::vector<size_t> thread_sizes = sizes;
+    if (options.count != 0 && options.count < thread_sizes.size()) {
+      thread_sizes.resize(options.count);
+    }
+    return run_sizes(allocator, thread_sizes, threads, options.free);
+  }
+
+  // Without a count the threads share the whole allocator between them
+  size_t count = options.count;
+  if (count == 0) {
+    const size_t min_size = Config::minBlockSize;
+    const size_t block_size =
+        std::max(BuddyHelper::round_up_pow2(options.size), min_size);
+    count = heap_size<Config>() / block_size / threads;
+  }
+  return run_sizes(allocator, std::vector<size_t>(count, options.size),
+                   threads, options.free);
+}
+
+// Runs the workload on a fresh allocator of the named class, whose memory is
+// unmapped afterwards so that a sweep does not keep every heap around
+template <typename Config>
+static bool run_config(const Options &options, const std::string &name,
+                       const std::vector<size_t> &sizes,
+                       const TraceFile &trace, int lazyThreshold,
+                       unsigned int threads, RunResult &result) {
+  return with_allocator<Config>(name, lazyThreshold, [&](auto *allocator) {
+    result = run_workload<Config>(allocator, options, sizes, trace, threads);
+  });
+}
+
+static bool run(const Options &options, const std::string &allocator,
+                const std::string &config, const std::vector<size_t> &sizes,
+                const TraceFile &trace, int lazyThreshold,
+                unsigned int threads, RunResult &result) {
+  bool ok = false;
+  const auto run_named = [&](auto *type) {
+    using Config = typename std::remove_pointer<decltype(type)>::type;
+    ok = run_config<Config>(options, allocator, sizes, trace, lazyThreshold,
+                            threads, result);
+  };
+  if (!with_config(config, run_named)) {
+    std::cerr << "Unknown config: " << config << std::endl;
+    return false;
+  }
+  return ok;
+}
+
+// Repeats a run on fresh allocators, discarding the warmup runs, and returns
+// the mean time and failures of the measured ones
+static bool run_repeated(const Options &options, const std::string &allocator,
+                         const std::string &config,
+                         const std::vector<size_t> &sizes,
+                         const TraceFile &trace, int lazyThreshold,
+                         unsigned int threads, RunResult &result) {
+  result = RunResult();
+  for (unsigned int i = 0; i < options.warmupRuns + options.runs; i++) {
+    RunResult single;
+    if (!run(options, allocator, config, sizes, trace, lazyThreshold, threads,
+             single)) {
+      return false;
+    }
+    if (i < options.warmupRuns) {
+      continue;
+    }
+    result.ops = single.ops;
+    result.failed += single.failed;
+    result.seconds += single.seconds;
+  }
+  result.failed /= options.runs;
+  result.seconds /= options.runs;
+  return true;
+}
+
+// Reads one allocation size per line
+static bool read_sizes(const std::string &filename,
+                       std::vector<size_t> &sizes) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open the file: " << filename << std::endl;
+    return false;
+  }
+
+  size_t size;
+  while (file >> size) {
+    sizes.push_back(size);
+  }
+  return true;
+}
+
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options]\n"
+      << "Lists are comma separated, and every combination of them is run.\n"
+      << "  -a allocators   binary,bt,bt-blocked,wbt,wbt8,ibuddy, the "
+         "baselines\n"
+      << "                  malloc,tlsf, or all (bt)\n"
+      << "  -c configs      z,small-single,small-double,large-quad,malloc,"
+         "stats,z-stats\n"
+      << "                  or all (z). The 2 MiB configs of autotune.out are "
+         "not listed.\n"
+      << "  -l thresholds   lazy thresholds (0)\n"
+      << "  -t threads      thread counts (1)\n"
+      << "  -w workload     const, sizes or trace (const)\n"
+      << "  -i file         size file of sizes, binary trace of trace\n"
+      << "  -s size         allocation size of const (16)\n"
+      << "  -n count        allocations per thread, 0 fills the allocator "
+         "(0)\n"
+      << "  -f              free the allocations of const and sizes\n"
+      << "  -y interval     sync interval of a threaded trace replay (0)\n"
+      << "  -x percent      cross-thread frees of a threaded trace replay (0)\n"
+      << "  -r runs         measured runs of each combination, averaged (1)\n"
+      << "  -W runs         unmeasured runs of each combination first (0)\n"
+      << "  -o file         also write the results as CSV, or JSON for .json"
+      << std::endl;
+}
+
+// Runs every combination of the given allocators, configs, lazy thresholds
+// and thread counts on one workload, printing a line per combination
+int main(int argc, char **argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:c:l:t:w:i:s:n:fy:x:r:W:o:h")) != -1) {
+    switch (opt) {
+    case 'a':
+      options.allocators =
+          split_list(optarg, allocatorNames, numAllocatorNames);
+      break;
+    case 'c':
+      options.configs = split_list(optarg, configNames, numConfigNames);
+      break;
+    case 'l':
+      options.lazyThresholds.clear();
+      for (const auto &item : split_list(optarg, nullptr, 0)) {
+        options.lazyThresholds.push_back(std::atoi(item.c_str()));
+      }
+      break;
+    case 't':
+      options.threads.clear();
+      for (const auto &item : split_list(optarg, nullptr, 0)) {
+        const int threads = std::atoi(item.c_str());
+        if (threads <= 0) {
+          std::cerr << "Invalid thread count: " << item << std::endl;
+          return 1;
+        }
+        options.threads.push_back(threads);
+      }
+      break;
+    case 'w':
+      options.workload = optarg;
+      break;
+    case 'i':
+      options.input = optarg;
+      break;
+    case 's':
+      options.size = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'n':
+      options.count = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'f':
+      options.free = true;
+      break;
+    case 'y':
+      options.syncInterval = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'x':
+      options.crossPercent = std::atoi(optarg);
+      break;
+    case 'r':
+      options.runs = std::atoi(optarg);
+      break;
+    case 'W':
+      options.warmupRuns = std::atoi(optarg);
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || options.runs == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<size_t> sizes;
+  TraceFile trace;
+  if (options.workload == "sizes") {
+    if (!read_sizes(options.input, sizes)) {
+      return 1;
+    }
+  } else if (options.workload == "trace") {
+    if (!trace.open(options.input.c_str())) {
+      return 1;
+    }
+  } else if (options.workload != "const") {
+    std::cerr << "Unknown workload: " << options.workload << std::endl;
+    return 1;
+  }
+
+  ResultsFile results(argc, argv);
+  results.set("workload", options.workload);
+  results.set("input", options.input);
+  results.set("size", options.size);
+  results.set("count", options.count);
+  results.set("free", options.free);
+  results.set("runs", options.runs);
+  results.set("warmup_runs", options.warmupRuns);
+  if (!options.output.empty() &&
+      !results.open(options.output,
+                    {"allocator", "config", "lazy", "threads", "workload",
+                     "ops", "seconds", "ns_per_op", "failed"})) {
+    return 1;
+  }
+
+  std::cout << "allocator config lazy threads workload ops seconds ns/op "
+               "failed"
+            << std::endl;
+  for (const auto &allocator : options.allocators) {
+    for (const auto &config : options.configs) {
+      for (const int lazy_threshold : options.lazyThresholds) {
+        for (const unsigned int threads : options.threads) {
+          RunResult result;
+          if (!run_repeated(options, allocator, config, sizes, trace,
+                            lazy_threshold, threads, result)) {
+            return 1;
+          }
+          std::cout << allocator << " " << config << " " << lazy_threshold
+                    << " " << threads << " " << options.workload << " "
+                    << result.ops << " " << result.seconds << " "
+                    << result.seconds * 1e9 / static_cast<double>(result.ops)
+                    << " " << result.failed << std::endl;
+          results.row(allocator, config, lazy_threshold, threads,
+                      options.workload, result.ops, result.seconds,
+                      result.seconds * 1e9 / static_cast<double>(result.ops),
+                      result.failed);
+        }
+      }
+    }
+  }
+  return results.close() ? 0 : 1;
+}
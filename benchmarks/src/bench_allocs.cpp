@@ -70,7 +70,8 @@ int main(int argc, char *argv[]) {
       clock_gettime(CLOCK_MONOTONIC_RAW, &end);
 
       // Calculate the elapsed time in nanoseconds
-      const double elapsedTime = end.tv_nsec - start.tv_nsec;
+      const double elapsedTime = (end.tv_sec - start.tv_sec) * 1000000000.0 +
+                                 (end.tv_nsec - start.tv_nsec);
 
       std::cout << elapsedTime << " " << size << std::endl;
     }
@@ -0,0 +1,380 @@
+#include "allocators.hpp"
+#include "replay_threads.hpp"
+#include "results.hpp"
+#include "size_dist.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+struct Options {
+  std::vector<std::string> allocators = {"bt"};
+  // Pairs of producer and consumer thread counts
+  std::vector<std::pair<unsigned int, unsigned int>> ratios = {{1, 1}};
+  std::vector<std::string> mixes = {"small"};
+  std::vector<int> lazyThresholds = {0};
+  size_t blocks = 100000;
+  size_t queueSize = 64;
+  bool counters = true;
+  // Results file, CSV or JSON
+  std::string output;
+};
+
+struct HandoffResult {
+  uint64_t blocks = 0;
+  uint64_t failed = 0;
+  double seconds = 0.0;
+  bool counted = false;
+  BuddyStats stats;
+};
+
+struct Block {
+  void *ptr;
+  size_t size;
+};
+
+// Ring of blocks from one producer to one consumer
+class HandoffQueue {
+public:
+  explicit HandoffQueue(size_t capacity) : _slots(capacity) {}
+
+  bool push(const Block &block) {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == _slots.size()) {
+      return false;
+    }
+    _slots[tail % _slots.size()] = block;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(Block &block) {
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    block = _slots[head % _slots.size()];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::vector<Block> _slots;
+  // Keep the producer and consumer indices on separate cache lines
+  char _pad0[64];
+  std::atomic<size_t> _head{0};
+  char _pad1[64];
+  std::atomic<size_t> _tail{0};
+};
+
+// Sizes one producer allocates
+static std::vector<size_t> make_sizes(const std::string &mix, size_t count,
+                                      unsigned int seed) {
+  std::mt19937 rng(seed);
+  SizeDistribution dist(mix);
+  std::vector<size_t> sizes(count);
+  for (auto &size : sizes) {
+    size = dist(rng);
+  }
+  return sizes;
+}
+
+static bool read_stats(BuddyAllocator<ZStatsConfig> *allocator,
+                       BuddyStats &stats) {
+  stats = allocator->stats();
+  return true;
+}
+
+static bool read_stats(void * /*allocator*/, BuddyStats & /*stats*/) {
+  return false;
+}
+
+// Producers allocate their sizes and hand the blocks round robin to the
+// consumers, which free them. A producer that finds the heap exhausted waits
+// for the consumers to free blocks before it gives up on an allocation. The
+// run is timed from the first thread starting until the last one is done.
+template <typename Allocator>
+static HandoffResult run_handoff(Allocator *allocator,
+                                 const std::vector<std::vector<size_t>> &sizes,
+                                 unsigned int consumers, size_t queueSize) {
+  const auto producers = static_cast<unsigned int>(sizes.size());
+  const unsigned int threads = producers + consumers;
+  const int max_retries = 1000;
+
+  std::vector<std::unique_ptr<HandoffQueue>> queues;
+  for (unsigned int i = 0; i < producers * consumers; i++) {
+    queues.emplace_back(new HandoffQueue(queueSize));
+  }
+  std::atomic<unsigned int> producers_done{0};
+  std::vector<uint64_t> failed(producers, 0);
+  std::vector<std::chrono::steady_clock::time_point> start_times(threads);
+  std::vector<std::chrono::steady_clock::time_point> end_times(threads);
+  SpinBarrier barrier(threads);
+
+  auto produce = [&](unsigned int p) {
+    barrier.wait();
+    start_times[p] = std::chrono::steady_clock::now();
+    unsigned int consumer = p % consumers;
+    for (const size_t size : sizes[p]) {
+      void *ptr = allocator->allocate(size);
+      for (int retry = 0; ptr == nullptr && retry < max_retries; retry++) {
+        std::this_thread::yield();
+        ptr = allocator->allocate(size);
+      }
+      if (ptr == nullptr) {
+        failed[p]++;
+        continue;
+      }
+
+      HandoffQueue &queue = *queues[p * consumers + consumer];
+      while (!queue.push({ptr, size})) {
+        std::this_thread::yield();
+      }
+      consumer = (consumer + 1) % consumers;
+    }
+    end_times[p] = std::chrono::steady_clock::now();
+    producers_done.fetch_add(1, std::memory_order_release);
+  };
+
+  auto consume = [&](unsigned int c) {
+    barrier.wait();
+    start_times[producers + c] = std::chrono::steady_clock::now();
+    while (true) {
+      // Read before draining, so no block pushed before the last producer
+      // finished is left behind
+      const bool done =
+          producers_done.load(std::memory_order_acquire) == producers;
+      bool found = false;
+      for (unsigned int p = 0; p < producers; p++) {
+        Block block;
+        while (queues[p * consumers + c]->pop(block)) {
+          allocator->deallocate(block.ptr, block.size);
+          found = true;
+        }
+      }
+      if (done && !found) {
+        break;
+      }
+      if (!found) {
+        std::this_thread::yield();
+      }
+    }
+    end_times[producers + c] = std::chrono::steady_clock::now();
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int p = 0; p < producers; p++) {
+    workers.emplace_back(produce, p);
+  }
+  for (unsigned int c = 0; c < consumers; c++) {
+    workers.emplace_back(consume, c);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  HandoffResult result;
+  result.seconds =
+      std::chrono::duration<double>(
+          *std::max_element(end_times.begin(), end_times.end()) -
+          *std::min_element(start_times.begin(), start_times.end()))
+          .count();
+  for (unsigned int p = 0; p < producers; p++) {
+    result.blocks += sizes[p].size() - failed[p];
+    result.failed += failed[p];
+  }
+  result.counted = read_stats(allocator, result.stats);
+  return result;
+}
+
+template <typename Config>
+static bool run(const Options &options, ResultsFile &results) {
+  for (const auto &name : options.allocators) {
+    for (const auto &ratio : options.ratios) {
+      for (const auto &mix : options.mixes) {
+        std::vector<std::vector<size_t>> sizes;
+        for (unsigned int p = 0; p < ratio.first; p++) {
+          sizes.push_back(make_sizes(mix, options.blocks, p + 1));
+        }
+
+        for (const int lazy : options.lazyThresholds) {
+          HandoffResult result;
+          const auto handoff = [&](auto *allocator) {
+            result = run_handoff(allocator, sizes, ratio.second,
+                                 options.queueSize);
+          };
+          if (!with_allocator<Config>(name, lazy, handoff)) {
+            return false;
+          }
+
+          std::cout << name << " " << ratio.first << " " << ratio.second
+                    << " " << mix << " " << lazy << " " << result.blocks
+                    << " " << result.seconds << " "
+                    << static_cast<double>(result.blocks) / result.seconds
+                    << " " << result.failed;
+          if (result.counted) {
+            std::cout << " " << result.stats.scanRetries << " "
+                      << result.stats.regionWaits << " "
+                      << result.stats.lazyWaits;
+          } else {
+            std::cout << " - - -";
+          }
+          std::cout << std::endl;
+
+          const double rate =
+              static_cast<double>(result.blocks) / result.seconds;
+          if (result.counted) {
+            results.row(name, ratio.first, ratio.second, mix, lazy,
+                        result.blocks, result.seconds, rate, result.failed,
+                        result.stats.scanRetries, result.stats.regionWaits,
+                        result.stats.lazyWaits);
+          } else {
+            results.row(name, ratio.first, ratio.second, mix, lazy,
+                        result.blocks, result.seconds, rate, result.failed, "",
+                        "", "");
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options]\n"
+      << "  -a allocators   comma separated, or all (bt)\n"
+      << "  -r ratios       producer:consumer thread counts, comma separated "
+         "(1:1)\n"
+      << "  -m mixes        small, medium, large, mixed or a fixed size, "
+         "comma\n"
+      << "                  separated, or all (small)\n"
+      << "  -l thresholds   lazy thresholds, comma separated (0)\n"
+      << "  -n blocks       blocks allocated by each producer (100000)\n"
+      << "  -q size         blocks each producer to consumer queue holds (64)\n"
+      << "  -C              leave out the contention counters\n"
+      << "  -o file         also write the results as CSV, or JSON for .json"
+      << std::endl;
+}
+
+// Measures blocks freed on another thread than the one that allocated them.
+// Producer threads allocate blocks of a size mix and pass them through queues
+// to consumer threads, which free them. Prints the blocks passed per second,
+// and for the buddy allocators the regions skipped while scanning, the frees
+// that waited for a region lock and the lazy list operations that found the
+// list locked.
+int main(int argc, char **argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:r:m:l:n:q:Co:h")) != -1) {
+    switch (opt) {
+    case 'a': {
+      std::istringstream iss(optarg);
+      std::string name;
+      options.allocators.clear();
+      while (std::getline(iss, name, ',')) {
+        if (name == "all") {
+          options.allocators.insert(options.allocators.end(), allocatorNames,
+                                    allocatorNames + numAllocatorNames);
+        } else if (!name.empty()) {
+          options.allocators.push_back(name);
+        }
+      }
+      break;
+    }
+    case 'r': {
+      std::istringstream iss(optarg);
+      std::string ratio;
+      options.ratios.clear();
+      while (std::getline(iss, ratio, ',')) {
+        const size_t colon = ratio.find(':');
+        const int producers = std::atoi(ratio.c_str());
+        const int consumers =
+            colon == std::string::npos ? 0 : std::atoi(&ratio[colon + 1]);
+        if (producers <= 0 || consumers <= 0) {
+          std::cerr << "Invalid ratio: " << ratio << std::endl;
+          return 1;
+        }
+        options.ratios.emplace_back(producers, consumers);
+      }
+      break;
+    }
+    case 'm': {
+      std::istringstream iss(optarg);
+      std::string mix;
+      options.mixes.clear();
+      while (std::getline(iss, mix, ',')) {
+        if (mix == "all") {
+          options.mixes.insert(options.mixes.end(), std::begin(sizeDistNames),
+                               std::end(sizeDistNames));
+        } else if (SizeDistribution::valid(mix)) {
+          options.mixes.push_back(mix);
+        } else {
+          std::cerr << "Unknown size mix: " << mix << std::endl;
+          return 1;
+        }
+      }
+      break;
+    }
+    case 'l': {
+      std::istringstream iss(optarg);
+      std::string threshold;
+      options.lazyThresholds.clear();
+      while (std::getline(iss, threshold, ',')) {
+        options.lazyThresholds.push_back(std::atoi(threshold.c_str()));
+      }
+      break;
+    }
+    case 'n':
+      options.blocks = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'q':
+      options.queueSize = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'C':
+      options.counters = false;
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || options.allocators.empty() || options.ratios.empty() ||
+      options.mixes.empty() || options.lazyThresholds.empty() ||
+      options.queueSize == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  ResultsFile results(argc, argv);
+  results.set("config", options.counters ? "z-stats" : "z");
+  results.set("blocks_per_producer", options.blocks);
+  results.set("queue_size", options.queueSize);
+  if (!options.output.empty() &&
+      !results.open(options.output,
+                    {"allocator", "producers", "consumers", "mix", "lazy",
+                     "blocks", "seconds", "blocks_per_s", "failed",
+                     "scan_retries", "region_waits", "lazy_waits"})) {
+    return 1;
+  }
+
+  std::cout << "allocator producers consumers mix lazy blocks seconds "
+               "blocks/s failed scan-retries region-waits lazy-waits"
+            << std::endl;
+  const bool ok = options.counters ? run<ZStatsConfig>(options, results)
+                                   : run<ZConfig>(options, results);
+  return results.close() && ok ? 0 : 1;
+}
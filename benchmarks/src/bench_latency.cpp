@@ -0,0 +1,186 @@
+#include "allocators.hpp"
+#include "cycles.hpp"
+#include "results.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static void usage(const char *program) {
+  std::cout << "Usage: " << program << " [options]\n"
+            << "  -a allocators   comma separated, or all (all)\n"
+            << "  -n samples      measured samples per size (10000)\n"
+            << "  -w warmup       unmeasured samples per size (1000)\n"
+            << "  -b batch        operations timed together per sample (1)\n"
+            << "  -l threshold    lazy threshold (0)\n"
+            << "  -o file         also write the results as CSV, or JSON for "
+               ".json"
+            << std::endl;
+}
+
+static void print_summary(const std::string &allocator, size_t size,
+                          unsigned int level, const char *op,
+                          std::vector<uint64_t> &samples, double cyclesPerNs,
+                          ResultsFile &results) {
+  const LatencySummary summary = summarize(samples, cyclesPerNs);
+  std::cout << allocator << " " << size << " " << level << " " << op << " "
+            << summary.p50 << " " << summary.p90 << " " << summary.p99 << " "
+            << summary.p999 << " " << summary.max << std::endl;
+  results.row(allocator, size, level, op, summary.p50, summary.p90,
+              summary.p99, summary.p999, summary.max);
+}
+
+// Times every block size of ZConfig on one allocator, returning false if an
+// allocation fails
+template <typename Allocator>
+static bool measure(Allocator *allocator, const std::string &allocator_name,
+                    size_t samples, size_t warmup, size_t batch,
+                    uint64_t overhead, double cycles_ns,
+                    ResultsFile &results) {
+  for (int level = ZConfig::numLevels - 1; level >= 0; level--) {
+    const size_t size = ZConfig::maxBlockSize >> level;
+    const size_t blocks =
+        ZConfig::numRegions * ZConfig::maxBlockSize / size;
+    const size_t level_batch = batch < blocks ? batch : blocks;
+
+    std::vector<void *> ptrs(level_batch);
+    std::vector<uint64_t> alloc_samples;
+    std::vector<uint64_t> free_samples;
+    alloc_samples.reserve(samples);
+    free_samples.reserve(samples);
+
+    for (size_t i = 0; i < warmup + samples; i++) {
+      const uint64_t alloc_start = cycles_start();
+      for (size_t b = 0; b < level_batch; b++) {
+        ptrs[b] = allocator->allocate(size);
+      }
+      const uint64_t alloc_end = cycles_end();
+
+      for (size_t b = 0; b < level_batch; b++) {
+        if (ptrs[b] == nullptr) {
+          std::cerr << "Failed to allocate " << size << " bytes with "
+                    << allocator_name << std::endl;
+          return false;
+        }
+      }
+
+      const uint64_t free_start = cycles_start();
+      for (size_t b = 0; b < level_batch; b++) {
+        allocator->deallocate(ptrs[b], size);
+      }
+      const uint64_t free_end = cycles_end();
+
+      if (i < warmup) {
+        continue;
+      }
+      const uint64_t alloc_cycles = alloc_end - alloc_start;
+      const uint64_t free_cycles = free_end - free_start;
+      alloc_samples.push_back(
+          (alloc_cycles > overhead ? alloc_cycles - overhead : 0) /
+          level_batch);
+      free_samples.push_back(
+          (free_cycles > overhead ? free_cycles - overhead : 0) /
+          level_batch);
+    }
+
+    print_summary(allocator_name, size, level, "alloc", alloc_samples,
+                  cycles_ns, results);
+    print_summary(allocator_name, size, level, "free", free_samples,
+                  cycles_ns, results);
+  }
+  return true;
+}
+
+// Measures the latency of allocating and freeing each block size of a ZGC
+// sized allocator, reporting the percentiles in nanoseconds. Every sample
+// times a batch of allocations followed by their frees, less the timer
+// overhead, divided by the batch size.
+int main(int argc, char **argv) {
+  std::string allocators = "all";
+  size_t samples = 10000;
+  size_t warmup = 1000;
+  size_t batch = 1;
+  int lazy_threshold = 0;
+  std::string output;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:n:w:b:l:o:h")) != -1) {
+    switch (opt) {
+    case 'a':
+      allocators = optarg;
+      break;
+    case 'n':
+      samples = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'w':
+      warmup = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'b':
+      batch = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'l':
+      lazy_threshold = std::atoi(optarg);
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || samples == 0 || batch == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> names;
+  std::istringstream iss(allocators);
+  std::string name;
+  while (std::getline(iss, name, ',')) {
+    if (name == "all") {
+      names.insert(names.end(), allocatorNames,
+                   allocatorNames + numAllocatorNames);
+    } else if (!name.empty()) {
+      names.push_back(name);
+    }
+  }
+
+  const double cycles_ns = cycles_per_ns();
+  const uint64_t overhead = cycles_overhead();
+  std::cout << "# " << cycles_ns << " cycles/ns, timer overhead " << overhead
+            << " cycles" << std::endl;
+  ResultsFile results(argc, argv);
+  results.set("config", "z");
+  results.set("lazy", lazy_threshold);
+  results.set("samples", samples);
+  results.set("warmup", warmup);
+  results.set("batch", batch);
+  results.set("cycles_per_ns", cycles_ns);
+  results.set("timer_overhead_cycles", overhead);
+  if (!output.empty() &&
+      !results.open(output, {"allocator", "size", "level", "op", "p50_ns",
+                             "p90_ns", "p99_ns", "p999_ns", "max_ns"})) {
+    return 1;
+  }
+  std::cout << "allocator size level op p50 p90 p99 p99.9 max" << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+
+  for (const auto &allocator_name : names) {
+    bool measured = false;
+    const auto run = [&](auto *allocator) {
+      measured = measure(allocator, allocator_name, samples, warmup, batch,
+                         overhead, cycles_ns, results);
+    };
+    if (!with_allocator<ZConfig>(allocator_name, lazy_threshold, run) ||
+        !measured) {
+      return 1;
+    }
+  }
+
+  return results.close() ? 0 : 1;
+}
@@ -0,0 +1,384 @@
+#include "allocators.hpp"
+#include "results.hpp"
+#include "size_dist.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+struct Options {
+  std::vector<std::string> allocators = {
+      allocatorNames, allocatorNames + numBuddyAllocatorNames};
+  std::vector<std::string> configs = {"z", "large-quad"};
+  std::string sizes = "mixed";
+  // Share of the heap the filled phase allocates, in block bytes
+  unsigned int fillPercent = 75;
+  int lazyThreshold = 0;
+  // Write every allocated block, so the payload counts in the RSS
+  bool writeBlocks = false;
+  unsigned int seed = 42;
+  std::string output;
+};
+
+static const char *const phaseNames[] = {"created", "filled", "half-freed",
+                                         "refilled", "freed"};
+static const size_t numPhases = sizeof(phaseNames) / sizeof(phaseNames[0]);
+
+// Memory of the process at a point of the run
+struct MemorySnapshot {
+  size_t rss;
+  long minorFaults;
+  long majorFaults;
+};
+
+// Resident set size of the process in bytes, from /proc/self/smaps_rollup, or
+// from /proc/self/statm on kernels without it
+static size_t read_rss() {
+  std::ifstream rollup("/proc/self/smaps_rollup");
+  std::string key;
+  while (rollup >> key) {
+    if (key == "Rss:") {
+      size_t kib = 0;
+      rollup >> kib;
+      return kib * 1024;
+    }
+    rollup.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0;
+  size_t resident = 0;
+  if (statm >> pages >> resident) {
+    return resident * sysconf(_SC_PAGESIZE);
+  }
+  return 0;
+}
+
+static MemorySnapshot snapshot() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return {read_rss(), usage.ru_minflt, usage.ru_majflt};
+}
+
+struct PhaseReport {
+  size_t liveBytes = 0;
+  size_t blocks = 0;
+  uint64_t failed = 0;
+  // Since the snapshot before the allocator was created
+  size_t rssBytes = 0;
+  long rssDelta = 0;
+  // Since the previous phase
+  long minorFaults = 0;
+  long majorFaults = 0;
+};
+
+struct MemoryReport {
+  std::string allocator;
+  std::string config;
+  size_t metadataBytes = 0;
+  size_t heapBytes = 0;
+  PhaseReport phases[numPhases];
+};
+
+template <typename Config> static size_t block_size(size_t size) {
+  const size_t rounded = BuddyHelper::round_up_pow2(size);
+  return rounded < Config::minBlockSize ? Config::minBlockSize : rounded;
+}
+
+// Request sizes whose blocks fill the given share of the heap of Config.
+// Sizes above the largest block are drawn again.
+template <typename Config>
+static std::vector<uint32_t> fill_sizes(const Options &options) {
+  SizeDistribution distribution(options.sizes);
+  std::mt19937 rng(options.seed);
+  const size_t target = heap_size<Config>() / 100 * options.fillPercent;
+  std::vector<uint32_t> sizes;
+  size_t total = 0;
+  while (total < target) {
+    const size_t size = distribution(rng);
+    if (size == 0 || size > Config::maxBlockSize) {
+      continue;
+    }
+    sizes.push_back(static_cast<uint32_t>(size));
+    total += block_size<Config>(size);
+  }
+  return sizes;
+}
+
+// Creates the allocator, fills the heap, frees every other block, allocates
+// them again and frees everything, taking the RSS and the page faults after
+// each phase. The sizes and the block addresses are allocated up front, so the
+// bookkeeping does not change the RSS during the run.
+template <typename Config>
+static bool run(const Options &options, MemoryReport &report) {
+  const std::vector<uint32_t> sizes = fill_sizes<Config>(options);
+  std::vector<void *> blocks(sizes.size(), nullptr);
+  report.heapBytes = heap_size<Config>();
+
+  MemorySnapshot previous = snapshot();
+  const size_t baseline = previous.rss;
+  size_t live_bytes = 0;
+  size_t live_blocks = 0;
+  unsigned int phase = 0;
+  uint64_t failed = 0;
+  const auto end_phase = [&]() {
+    const MemorySnapshot now = snapshot();
+    PhaseReport &p = report.phases[phase++];
+    p.liveBytes = live_bytes;
+    p.blocks = live_blocks;
+    p.failed = failed;
+    p.rssBytes = now.rss;
+    p.rssDelta = static_cast<long>(now.rss) - static_cast<long>(baseline);
+    p.minorFaults = now.minorFaults - previous.minorFaults;
+    p.majorFaults = now.majorFaults - previous.majorFaults;
+    previous = now;
+    failed = 0;
+  };
+
+  const auto run_phases = [&](auto *allocator) {
+    report.metadataBytes = sizeof(*allocator);
+    const auto allocate = [&](size_t i) {
+      blocks[i] = allocator->allocate(sizes[i]);
+      if (blocks[i] == nullptr) {
+        failed++;
+        return;
+      }
+      if (options.writeBlocks) {
+        std::memset(blocks[i], 0xA5, sizes[i]);
+      }
+      live_bytes += sizes[i];
+      live_blocks++;
+    };
+    const auto deallocate = [&](size_t i) {
+      if (blocks[i] != nullptr) {
+        allocator->deallocate(blocks[i], sizes[i]);
+        blocks[i] = nullptr;
+        live_bytes -= sizes[i];
+        live_blocks--;
+      }
+    };
+
+    end_phase();
+    for (size_t i = 0; i < sizes.size(); i++) {
+      allocate(i);
+    }
+    end_phase();
+    for (size_t i = 1; i < sizes.size(); i += 2) {
+      deallocate(i);
+    }
+    end_phase();
+    for (size_t i = 1; i < sizes.size(); i += 2) {
+      allocate(i);
+    }
+    end_phase();
+    for (size_t i = 0; i < sizes.size(); i++) {
+      deallocate(i);
+    }
+    end_phase();
+  };
+  return with_allocator<Config>(report.allocator, options.lazyThreshold,
+                                run_phases);
+}
+
+static double kib(long bytes) { return static_cast<double>(bytes) / 1024.0; }
+
+static void print_phases(const std::vector<MemoryReport> &reports) {
+  std::cout << std::left << std::setw(12) << "allocator" << std::setw(13)
+            << "config" << std::setw(12) << "phase" << std::right
+            << std::setw(12) << "live KiB" << std::setw(10) << "blocks"
+            << std::setw(8) << "failed" << std::setw(12) << "RSS+ KiB"
+            << std::setw(10) << "faults" << std::endl;
+  std::cout << std::fixed << std::setprecision(0);
+  for (const MemoryReport &r : reports) {
+    for (size_t p = 0; p < numPhases; p++) {
+      const PhaseReport &phase = r.phases[p];
+      std::cout << std::left << std::setw(12) << r.allocator << std::setw(13)
+                << r.config << std::setw(12) << phaseNames[p] << std::right
+                << std::setw(12) << kib(phase.liveBytes) << std::setw(10)
+                << phase.blocks << std::setw(8) << phase.failed
+                << std::setw(12) << kib(phase.rssDelta) << std::setw(10)
+                << phase.minorFaults + phase.majorFaults << std::endl;
+    }
+  }
+  std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// Metadata and resident memory per allocator and config. The overhead is the
+// RSS added by the filled heap per live byte, which only counts the payload
+// pages the allocator touched unless the blocks are written.
+static void print_efficiency(const std::vector<MemoryReport> &reports) {
+  std::cout << "\nmemory efficiency" << std::endl;
+  std::cout << std::left << std::setw(12) << "allocator" << std::setw(13)
+            << "config" << std::right << std::setw(14) << "metadata KiB"
+            << std::setw(11) << "of heap %" << std::setw(13)
+            << "created KiB" << std::setw(12) << "filled KiB" << std::setw(11)
+            << "RSS/live" << std::setw(12) << "freed KiB" << std::endl;
+  std::cout << std::fixed;
+  for (const MemoryReport &r : reports) {
+    const PhaseReport &created = r.phases[0];
+    const PhaseReport &filled = r.phases[1];
+    const PhaseReport &freed = r.phases[numPhases - 1];
+    std::cout << std::left << std::setw(12) << r.allocator << std::setw(13)
+              << r.config << std::right << std::setprecision(1)
+              << std::setw(14) << kib(r.metadataBytes) << std::setprecision(2)
+              << std::setw(11)
+              << 100.0 * static_cast<double>(r.metadataBytes) /
+                     static_cast<double>(r.heapBytes)
+              << std::setprecision(0) << std::setw(13)
+              << kib(created.rssDelta) << std::setw(12)
+              << kib(filled.rssDelta) << std::setprecision(3)
+              << std::setw(11)
+              << (filled.liveBytes == 0
+                      ? 0.0
+                      : static_cast<double>(filled.rssDelta) /
+                            static_cast<double>(filled.liveBytes))
+              << std::setprecision(0) << std::setw(12) << kib(freed.rssDelta)
+              << std::endl;
+  }
+  std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options]\n"
+      << "  -a allocators   comma separated, or all (the buddy allocators)\n"
+      << "  -c configs      z,small-single,small-double,large-quad,malloc,"
+         "stats,z-stats\n"
+      << "                  or all (z,large-quad). The 2 MiB configs of autotune.out are "
+         "not listed.\n"
+      << "  -d sizes        small, medium, large, mixed, or a spec of "
+         "workload_gen (mixed)\n"
+      << "  -f percent      share of the heap to fill, in block bytes (75)\n"
+      << "  -l threshold    lazy threshold (0)\n"
+      << "  -w              write every allocated block\n"
+      << "  -s seed         seed of the sizes (42)\n"
+      << "  -o file         also write the results as CSV, or JSON for .json"
+      << std::endl;
+}
+
+static std::vector<std::string> split_list(const char *arg,
+                                           const char *const *all,
+                                           size_t numAll) {
+  std::vector<std::string> items;
+  std::istringstream iss(arg);
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (item == "all") {
+      items.insert(items.end(), all, all + numAll);
+    } else if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+// Measures the memory each allocator uses beyond the payload: the size of the
+// allocator object, which holds the bitmaps and trees, and the RSS and page
+// faults after creating it, filling the heap, freeing every other block,
+// allocating them again and freeing everything. Each allocator and config
+// runs in turn in this process, and the RSS is taken relative to the process
+// before the allocator was created.
+int main(int argc, char **argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:c:d:f:l:ws:o:h")) != -1) {
+    switch (opt) {
+    case 'a':
+      options.allocators =
+          split_list(optarg, allocatorNames, numAllocatorNames);
+      break;
+    case 'c':
+      options.configs = split_list(optarg, configNames, numConfigNames);
+      break;
+    case 'd':
+      options.sizes = optarg;
+      break;
+    case 'f':
+      options.fillPercent = std::atoi(optarg);
+      break;
+    case 'l':
+      options.lazyThreshold = std::atoi(optarg);
+      break;
+    case 'w':
+      options.writeBlocks = true;
+      break;
+    case 's':
+      options.seed = std::atoi(optarg);
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || options.allocators.empty() ||
+      options.configs.empty() || options.fillPercent == 0 ||
+      options.fillPercent > 100) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (!SizeDistribution::valid(options.sizes)) {
+    std::cerr << "Invalid size distribution: " << options.sizes << std::endl;
+    return 1;
+  }
+
+  ResultsFile results(argc, argv);
+  results.set("sizes", options.sizes);
+  results.set("fill_percent", options.fillPercent);
+  results.set("lazy", options.lazyThreshold);
+  results.set("write_blocks", options.writeBlocks ? "yes" : "no");
+  if (!options.output.empty() &&
+      !results.open(options.output,
+                    {"allocator", "config", "phase", "metadata_bytes",
+                     "heap_bytes", "live_bytes", "blocks", "failed",
+                     "rss_bytes", "rss_delta_bytes", "minor_faults",
+                     "major_faults"})) {
+    return 1;
+  }
+
+  std::vector<MemoryReport> reports;
+  for (const auto &config : options.configs) {
+    for (const auto &name : options.allocators) {
+      MemoryReport report;
+      report.allocator = name;
+      report.config = config;
+      bool ok = false;
+      const auto run_config = [&](auto *type) {
+        using Config = typename std::remove_pointer<decltype(type)>::type;
+        ok = run<Config>(options, report);
+      };
+      if (!with_config(config, run_config)) {
+        std::cerr << "Unknown config: " << config << std::endl;
+        return 1;
+      }
+      if (!ok) {
+        return 1;
+      }
+
+      for (size_t p = 0; p < numPhases; p++) {
+        const PhaseReport &phase = report.phases[p];
+        results.row(name, config, phaseNames[p], report.metadataBytes,
+                    report.heapBytes, phase.liveBytes, phase.blocks,
+                    phase.failed, phase.rssBytes, phase.rssDelta,
+                    phase.minorFaults, phase.majorFaults);
+      }
+      reports.push_back(report);
+    }
+  }
+
+  print_phases(reports);
+  print_efficiency(reports);
+  return results.close() ? 0 : 1;
+}
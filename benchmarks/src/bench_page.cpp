@@ -1,31 +1,28 @@
-#include "../../include/buddy_allocator.hpp"
-#include "../../include/buddy_config.hpp"
-#include "../../include/buddy_helper.hpp"
-#include "../../include/buddy_instantiations.hpp"
-
-#include "../../include/bbuddy.hpp"
-#include "../../include/bbuddy_instantiations.hpp"
-
-#include "../../include/btbuddy.hpp"
-#include "../../include/btbuddy_instantiations.hpp"
-
-#include "../../include/ibuddy.hpp"
-#include "../../include/ibuddy_instantiations.hpp"
+#include "allocators.hpp"
+#include "perf_counters.hpp"
+#include "results.hpp"
 
 #include <time.h>
 
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <string>
 #include <sys/mman.h>
+#include <unistd.h>
+
+static void usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [-a allocator] [-l lazy threshold] [-o results file] <N>\n"
+            << "The allocator is binary, bt, bt-blocked, wbt, wbt8 or ibuddy "
+               "(ibuddy), the\n"
+            << "lazy threshold 10 by default, and the results file is CSV, "
+               "or JSON for .json"
+            << std::endl;
+}
 
-int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <N>" << std::endl;
-    return 1;
-  }
-
-  const int N = std::atoi(argv[1]);
+template <typename Allocator>
+static bool fill_pages(int N, int lazyThreshold, ResultsFile &results) {
   const int sizes[] = {16,   32,   64,    128,   256,   512,    1024,  2048,
                        4096, 8192, 16384, 32768, 65536, 131072, 262144};
 
@@ -33,49 +30,107 @@ int main(int argc, char *argv[]) {
   void *mem = mmap(nullptr, 2 * 1024 * 1024, PROT_READ | PROT_WRITE,
                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
   void *allocator_mem =
-      mmap(nullptr, sizeof(BTBuddyAllocator<ZConfig>), PROT_READ | PROT_WRITE,
+      mmap(nullptr, sizeof(Allocator), PROT_READ | PROT_WRITE,
            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  if (mem == MAP_FAILED) {
+  if (mem == MAP_FAILED || allocator_mem == MAP_FAILED) {
     std::cerr << "Failed to mmap memory" << std::endl;
-    return 1;
+    return false;
   }
 
   const int page_size = 2097152;
 
+  // Hardware counters of each size go to stderr, keeping stdout for the times
+  PerfCounters counters;
+
   for (const auto &size : sizes) {
     const int num_allocs = page_size / size;
+    PerfSample total;
     for (int i = 0; i < N; i++) {
       // Create buddy instance
-      BuddyAllocator<ZConfig> *btbuddy =
-          //   BTBuddyAllocator<ZConfig>::create(allocator_mem, mem, 10, false);
-        //   BinaryBuddyAllocator<ZConfig>::create(allocator_mem, mem, 10, false);
-      IBuddyAllocator<ZConfig>::create(allocator_mem, mem, 10, false);
+      Allocator *buddy =
+          Allocator::create(allocator_mem, mem, lazyThreshold, false);
 
       // Start the timer
       timespec start, end;
+      counters.start();
       clock_gettime(CLOCK_MONOTONIC_RAW, &start);
 
       // Fill the page with allocations
       for (int j = 0; j < num_allocs; j++) {
-        void *ptr = btbuddy->allocate(size);
+        void *ptr = buddy->allocate(size);
         asm volatile("" : : "r,m"(ptr) : "memory");
         if (ptr == nullptr) {
           std::cerr << "Error: " << ptr << " is null" << std::endl;
-          return 1;
+          return false;
         }
       }
 
       // Stop the timer
       clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+      total.add(counters.stop());
 
-      //   const double elapsedTime = end.tv_nsec - start.tv_nsec;
       // Calculate the elapsed time in microseconds
       const double elapsedTime = (end.tv_sec - start.tv_sec) * 1000000.0 +
                                  (end.tv_nsec - start.tv_nsec) / 1000.0;
 
       std::cout << elapsedTime << " " << size << std::endl;
+      results.row(size, i, elapsedTime);
     }
+
+    std::cerr << size << " ";
+    total.print(std::cerr, static_cast<uint64_t>(N) * num_allocs);
   }
 
-  return 0;
+  munmap(allocator_mem, sizeof(Allocator));
+  munmap(mem, 2 * 1024 * 1024);
+  return true;
+}
+
+// Times filling a 2 MiB page with blocks of each size, N times per size
+int main(int argc, char *argv[]) {
+  std::string name = "ibuddy";
+  int lazy_threshold = 10;
+  std::string output;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:l:o:")) != -1) {
+    switch (opt) {
+    case 'a':
+      name = optarg;
+      break;
+    case 'l':
+      lazy_threshold = std::atoi(optarg);
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - optind != 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  const int N = std::atoi(argv[optind]);
+
+  ResultsFile results(argc, argv);
+  results.set("allocator", name);
+  results.set("config", "z");
+  results.set("lazy", lazy_threshold);
+  if (!output.empty() &&
+      !results.open(output, {"size", "repetition", "time_us"})) {
+    return 1;
+  }
+
+  bool ok = false;
+  const auto run = [&](auto *type) {
+    using Allocator = typename std::remove_pointer<decltype(type)>::type;
+    ok = fill_pages<Allocator>(N, lazy_threshold, results);
+  };
+  if (!with_buddy_type<ZConfig>(name, run)) {
+    std::cerr << "Unknown allocator: " << name << std::endl;
+    return 1;
+  }
+  return results.close() && ok ? 0 : 1;
 }
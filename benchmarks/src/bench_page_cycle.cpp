@@ -0,0 +1,413 @@
+#include "allocators.hpp"
+#include "results.hpp"
+#include "size_dist.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct Options {
+  std::vector<std::string> allocators = {"bt"};
+  std::vector<std::string> dists = {"mixed"};
+  std::vector<unsigned int> survival = {10};
+  size_t pages = 64;
+  // Pages kept free for relocation, collection starts once only these are left
+  size_t reserve = 8;
+  // Pages with at most this share of live bytes are evacuated
+  unsigned int evacuateLimit = 75;
+  unsigned int cycles = 20;
+  // Results file, CSV or JSON
+  std::string output;
+};
+
+struct Object {
+  uintptr_t addr;
+  size_t size;
+};
+
+// A ZConfig allocator managing one page, with the objects allocated in it
+template <typename Allocator> struct Page {
+  Allocator *allocator;
+  uintptr_t start;
+  std::vector<Object> objects;
+};
+
+struct CycleResult {
+  uint64_t allocs = 0;
+  uint64_t allocBytes = 0;
+  double allocSeconds = 0.0;
+  uint64_t liveBytes = 0;
+  uint64_t relocatedBytes = 0;
+  uint64_t evacuated = 0;
+  uint64_t reclaimed = 0;
+  uint64_t freePages = 0;
+  // Mean fragmentation index of the pages with live objects left, and the
+  // rounding waste of the live objects
+  double externalFragmentation = 0.0;
+  double internalFragmentation = 0.0;
+};
+
+static size_t block_size(size_t size) {
+  const size_t min_size = ZConfig::minBlockSize;
+  return std::max(BuddyHelper::round_up_pow2(size), min_size);
+}
+
+// Frees everything in a page except the given objects, sorted by address.
+// deallocate_range only takes allocated memory, so the page is filled first
+// and the gaps between the objects are freed, as a collector that only knows
+// the live objects would rebuild it.
+template <typename Allocator>
+static void reclaim_gaps(Page<Allocator> &page,
+                         const std::vector<Object> &live) {
+  page.allocator->fill();
+  uintptr_t gap_start = page.start;
+  for (const Object &object : live) {
+    if (object.addr > gap_start) {
+      page.allocator->deallocate_range(reinterpret_cast<void *>(gap_start),
+                                       object.addr - gap_start);
+    }
+    gap_start = object.addr + block_size(object.size);
+  }
+  const uintptr_t page_end = page.start + heap_size<ZConfig>();
+  if (page_end > gap_start) {
+    page.allocator->deallocate_range(reinterpret_cast<void *>(gap_start),
+                                     page_end - gap_start);
+  }
+}
+
+// Simulates the ZGC page lifecycle over a set of pages. The mutator allocates
+// objects into the pages with space left and then into free pages, until only
+// the reserve is free. A collection then marks each object live with the
+// survival rate. Pages with few live bytes are evacuated, their live objects
+// copied into reserve pages and the page freed whole with deallocate_range.
+// The other pages keep their live objects and the dead space between them is
+// freed in place.
+template <typename Allocator>
+static bool run_cycles(const Options &options, const std::string &dist,
+                       unsigned int survival,
+                       std::vector<CycleResult> &results) {
+  const size_t page_size = heap_size<ZConfig>();
+  const size_t heap_bytes = options.pages * page_size;
+  void *heap = mmap(nullptr, heap_bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (heap == MAP_FAILED) {
+    std::cerr << "Failed to mmap memory" << std::endl;
+    return false;
+  }
+
+  std::vector<Page<Allocator>> pages(options.pages);
+  for (size_t i = 0; i < options.pages; i++) {
+    pages[i].start = reinterpret_cast<uintptr_t>(heap) + i * page_size;
+    pages[i].allocator = Allocator::create(
+        nullptr, reinterpret_cast<void *>(pages[i].start), 0, false);
+  }
+
+  // Pages with free space in allocation order, and pages that are empty
+  std::vector<size_t> partial;
+  std::vector<size_t> empty;
+  for (size_t i = options.pages; i > 0; i--) {
+    empty.push_back(i - 1);
+  }
+
+  std::mt19937 rng(1);
+  SizeDistribution sizes(dist);
+  std::uniform_int_distribution<unsigned int> percent(0, 99);
+
+  for (unsigned int cycle = 0; cycle < options.cycles; cycle++) {
+    CycleResult result;
+
+    // Mutator
+    std::vector<size_t> used;
+    size_t current = 0;
+    bool have_page = false;
+    const auto start_time = std::chrono::steady_clock::now();
+    while (true) {
+      if (!have_page) {
+        if (!partial.empty()) {
+          current = partial.front();
+          partial.erase(partial.begin());
+        } else if (empty.size() > options.reserve) {
+          current = empty.back();
+          empty.pop_back();
+        } else {
+          break;
+        }
+        used.push_back(current);
+        have_page = true;
+      }
+
+      const size_t size = sizes(rng);
+      void *ptr = pages[current].allocator->allocate(size);
+      if (ptr == nullptr) {
+        have_page = false;
+        continue;
+      }
+      pages[current].objects.push_back(
+          {reinterpret_cast<uintptr_t>(ptr), size});
+      result.allocs++;
+      result.allocBytes += size;
+    }
+    result.allocSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start_time)
+                              .count();
+
+    // Mark
+    std::vector<std::vector<Object>> live(options.pages);
+    for (const size_t p : used) {
+      for (const Object &object : pages[p].objects) {
+        if (percent(rng) < survival) {
+          live[p].push_back(object);
+          result.liveBytes += object.size;
+        }
+      }
+    }
+
+    // Relocate and reclaim. Evacuation stops at the first object that does
+    // not fit in the reserve, leaving the rest of the page in place.
+    size_t target = 0;
+    bool have_target = false;
+    std::vector<size_t> targets;
+    for (const size_t p : used) {
+      size_t live_blocks = 0;
+      for (const Object &object : live[p]) {
+        live_blocks += block_size(object.size);
+      }
+
+      std::vector<Object> kept;
+      bool evacuate = live_blocks * 100 <= page_size * options.evacuateLimit;
+      for (const Object &object : live[p]) {
+        void *copy = nullptr;
+        while (evacuate && copy == nullptr) {
+          if (!have_target) {
+            if (empty.empty()) {
+              evacuate = false;
+              break;
+            }
+            target = empty.back();
+            empty.pop_back();
+            targets.push_back(target);
+            have_target = true;
+          }
+          copy = pages[target].allocator->allocate(object.size);
+          if (copy == nullptr) {
+            have_target = false;
+          }
+        }
+        if (copy == nullptr) {
+          kept.push_back(object);
+          continue;
+        }
+        std::memcpy(copy, reinterpret_cast<void *>(object.addr), object.size);
+        pages[target].objects.push_back(
+            {reinterpret_cast<uintptr_t>(copy), object.size});
+        result.relocatedBytes += object.size;
+      }
+
+      std::sort(kept.begin(), kept.end(),
+                [](const Object &a, const Object &b) { return a.addr < b.addr; });
+      reclaim_gaps(pages[p], kept);
+      pages[p].objects = kept;
+      if (kept.empty()) {
+        empty.push_back(p);
+        result.evacuated++;
+      } else {
+        partial.push_back(p);
+        result.reclaimed++;
+      }
+    }
+    // Relocation targets take new objects once the collection is done
+    partial.insert(partial.end(), targets.begin(), targets.end());
+
+    // Measure the pages with live objects
+    uint64_t live_requested = 0;
+    uint64_t live_blocks = 0;
+    for (const size_t p : partial) {
+      result.externalFragmentation += pages[p].allocator->fragmentation();
+      for (const Object &object : pages[p].objects) {
+        live_requested += object.size;
+        live_blocks += block_size(object.size);
+      }
+    }
+    if (!partial.empty()) {
+      result.externalFragmentation /= static_cast<double>(partial.size());
+    }
+    if (live_blocks != 0) {
+      result.internalFragmentation =
+          1.0 - static_cast<double>(live_requested) /
+                    static_cast<double>(live_blocks);
+    }
+    result.freePages = empty.size();
+    results.push_back(result);
+  }
+
+  for (auto &page : pages) {
+    munmap(page.allocator, sizeof(Allocator));
+  }
+  munmap(heap, heap_bytes);
+  return true;
+}
+
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options]\n"
+      << "  -a allocators   binary,bt,bt-blocked,wbt,wbt8,ibuddy or all (bt)\n"
+      << "  -d dists        object sizes, small, medium, large, mixed or a "
+         "fixed\n"
+      << "                  size, comma separated, or all (mixed)\n"
+      << "  -s survival     percent of objects alive at each collection, "
+         "comma\n"
+      << "                  separated (10)\n"
+      << "  -p pages        pages of 2 MiB (64)\n"
+      << "  -r pages        pages kept free for relocation (8)\n"
+      << "  -e percent      evacuate pages with at most this share live (75)\n"
+      << "  -c cycles       collection cycles (20)\n"
+      << "  -o file         also write the results as CSV, or JSON for .json"
+      << std::endl;
+}
+
+// Measures fragmentation over repeated ZGC collection cycles, where each page
+// is a ZConfig allocator. Prints one line per cycle with the allocation
+// throughput, the bytes relocated, the pages evacuated and reclaimed in place,
+// and the fragmentation of the pages still in use.
+int main(int argc, char **argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:d:s:p:r:e:c:o:h")) != -1) {
+    switch (opt) {
+    case 'a': {
+      std::istringstream iss(optarg);
+      std::string name;
+      options.allocators.clear();
+      while (std::getline(iss, name, ',')) {
+        if (name == "all") {
+          // The baselines have no deallocate_range
+          options.allocators.insert(options.allocators.end(), allocatorNames,
+                                    allocatorNames + numBuddyAllocatorNames);
+        } else if (!name.empty()) {
+          options.allocators.push_back(name);
+        }
+      }
+      break;
+    }
+    case 'd': {
+      std::istringstream iss(optarg);
+      std::string dist;
+      options.dists.clear();
+      while (std::getline(iss, dist, ',')) {
+        if (dist == "all") {
+          options.dists.insert(options.dists.end(), std::begin(sizeDistNames),
+                               std::end(sizeDistNames));
+        } else if (SizeDistribution::valid(dist)) {
+          options.dists.push_back(dist);
+        } else {
+          std::cerr << "Unknown size distribution: " << dist << std::endl;
+          return 1;
+        }
+      }
+      break;
+    }
+    case 's': {
+      std::istringstream iss(optarg);
+      std::string survival;
+      options.survival.clear();
+      while (std::getline(iss, survival, ',')) {
+        options.survival.push_back(std::atoi(survival.c_str()));
+      }
+      break;
+    }
+    case 'p':
+      options.pages = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'r':
+      options.reserve = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'e':
+      options.evacuateLimit = std::atoi(optarg);
+      break;
+    case 'c':
+      options.cycles = std::atoi(optarg);
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || options.allocators.empty() || options.dists.empty() ||
+      options.survival.empty() || options.reserve >= options.pages ||
+      options.evacuateLimit > 100) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  ResultsFile results(argc, argv);
+  results.set("config", "z");
+  results.set("pages", options.pages);
+  results.set("reserve", options.reserve);
+  results.set("evacuate_limit", options.evacuateLimit);
+  results.set("cycles", options.cycles);
+  if (!options.output.empty() &&
+      !results.open(options.output,
+                    {"allocator", "dist", "survival", "cycle", "allocs",
+                     "alloc_bytes", "allocs_per_s", "live_bytes",
+                     "relocated_bytes", "evacuated", "reclaimed", "free_pages",
+                     "external_frag", "internal_frag"})) {
+    return 1;
+  }
+
+  std::cout << "allocator dist survival cycle allocs alloc-bytes allocs/s "
+               "live-bytes relocated-bytes evacuated reclaimed free-pages "
+               "external-frag internal-frag"
+            << std::endl;
+  for (const auto &name : options.allocators) {
+    for (const auto &dist : options.dists) {
+      for (const unsigned int survival : options.survival) {
+        std::vector<CycleResult> cycle_results;
+        bool ok = false;
+        const auto cycles = [&](auto *type) {
+          using Allocator = typename std::remove_pointer<decltype(type)>::type;
+          ok = run_cycles<Allocator>(options, dist, survival, cycle_results);
+        };
+        if (!with_buddy_type<ZConfig>(name, cycles)) {
+          std::cerr << "Unknown allocator: " << name << std::endl;
+          return 1;
+        }
+        if (!ok) {
+          return 1;
+        }
+
+        for (size_t cycle = 0; cycle < cycle_results.size(); cycle++) {
+          const CycleResult &result = cycle_results[cycle];
+          std::cout << name << " " << dist << " " << survival << " " << cycle
+                    << " " << result.allocs << " " << result.allocBytes << " "
+                    << static_cast<double>(result.allocs) /
+                           result.allocSeconds
+                    << " " << result.liveBytes << " " << result.relocatedBytes
+                    << " " << result.evacuated << " " << result.reclaimed
+                    << " " << result.freePages << " "
+                    << result.externalFragmentation << " "
+                    << result.internalFragmentation << std::endl;
+          results.row(name, dist, survival, cycle, result.allocs,
+                      result.allocBytes,
+                      static_cast<double>(result.allocs) / result.allocSeconds,
+                      result.liveBytes, result.relocatedBytes,
+                      result.evacuated, result.reclaimed, result.freePages,
+                      result.externalFragmentation,
+                      result.internalFragmentation);
+        }
+      }
+    }
+  }
+  return results.close() ? 0 : 1;
+}
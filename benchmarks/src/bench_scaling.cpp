@@ -0,0 +1,331 @@
+#include "allocators.hpp"
+#include "replay_threads.hpp"
+#include "results.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <unistd.h>
+
+struct Options {
+  std::vector<std::string> allocators = {"bt"};
+  std::vector<int> regions = {1, 2, 4, 8, 16};
+  unsigned int maxThreads = 1;
+  unsigned int freePercent = 50;
+  size_t minSize = 16;
+  size_t maxSize = 256;
+  // Live blocks each thread keeps at most
+  size_t workingSet = 1024;
+  unsigned int milliseconds = 1000;
+  bool pin = true;
+  // Results file, CSV or JSON
+  std::string output;
+};
+
+struct ScalingResult {
+  uint64_t ops = 0;
+  uint64_t failed = 0;
+  double seconds = 0.0;
+};
+
+// CPUs the process may run on, which the threads are pinned to in turn
+static std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+static void pin_thread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    std::cerr << "Failed to pin a thread to CPU " << cpu << std::endl;
+  }
+}
+
+// Every thread draws operations from its own generator, freeing a random one
+// of its live blocks freePercent of the time and allocating otherwise. A
+// thread with no live blocks allocates, and one with a full working set or a
+// failed allocation frees. Only successful allocations and frees count as
+// operations, failed allocations are counted apart. The threads run until the
+// main thread stops them after the given duration.
+template <typename Allocator>
+static ScalingResult run_scaling(Allocator *allocator, const Options &options,
+                                 unsigned int threads,
+                                 const std::vector<int> &cpus) {
+  std::atomic<bool> stop{false};
+  std::vector<uint64_t> ops(threads, 0);
+  std::vector<uint64_t> failed(threads, 0);
+  std::vector<std::chrono::steady_clock::time_point> start_times(threads);
+  std::vector<std::chrono::steady_clock::time_point> end_times(threads);
+  SpinBarrier barrier(threads + 1);
+
+  auto run = [&](unsigned int t) {
+    if (options.pin && !cpus.empty()) {
+      pin_thread(cpus[t % cpus.size()]);
+    }
+    std::mt19937 rng(t + 1);
+    std::uniform_int_distribution<size_t> size_dist(options.minSize,
+                                                    options.maxSize);
+    std::uniform_int_distribution<unsigned int> percent(0, 99);
+    std::vector<std::pair<void *, size_t>> live;
+    live.reserve(options.workingSet);
+    uint64_t thread_ops = 0;
+
+    barrier.wait();
+    start_times[t] = std::chrono::steady_clock::now();
+    while (!stop.load(std::memory_order_relaxed)) {
+      const bool free_op = !live.empty() &&
+                           (live.size() == options.workingSet ||
+                            percent(rng) < options.freePercent);
+      if (!free_op) {
+        const size_t size = size_dist(rng);
+        void *ptr = allocator->allocate(size);
+        if (ptr != nullptr) {
+          live.emplace_back(ptr, size);
+          thread_ops++;
+          continue;
+        }
+        failed[t]++;
+        if (live.empty()) {
+          continue;
+        }
+      }
+
+      const size_t i = rng() % live.size();
+      allocator->deallocate(live[i].first, live[i].second);
+      live[i] = live.back();
+      live.pop_back();
+      thread_ops++;
+    }
+    end_times[t] = std::chrono::steady_clock::now();
+
+    for (const auto &block : live) {
+      allocator->deallocate(block.first, block.second);
+    }
+    ops[t] = thread_ops;
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < threads; t++) {
+    workers.emplace_back(run, t);
+  }
+  barrier.wait();
+  std::this_thread::sleep_for(std::chrono::milliseconds(options.milliseconds));
+  stop.store(true, std::memory_order_relaxed);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  ScalingResult result;
+  result.seconds =
+      std::chrono::duration<double>(
+          *std::max_element(end_times.begin(), end_times.end()) -
+          *std::min_element(start_times.begin(), start_times.end()))
+          .count();
+  for (unsigned int t = 0; t < threads; t++) {
+    result.ops += ops[t];
+    result.failed += failed[t];
+  }
+  return result;
+}
+
+// Thread counts of the sweep, doubling from 1 up to and including the maximum
+static std::vector<unsigned int> thread_counts(unsigned int maxThreads) {
+  std::vector<unsigned int> counts;
+  for (unsigned int t = 1; t < maxThreads; t *= 2) {
+    counts.push_back(t);
+  }
+  counts.push_back(maxThreads);
+  return counts;
+}
+
+template <typename Config>
+static bool run_regions(const Options &options, const std::string &name,
+                        int regions, const std::vector<int> &cpus,
+                        ResultsFile &results) {
+  double base_rate = 0.0;
+  for (const unsigned int threads : thread_counts(options.maxThreads)) {
+    ScalingResult result;
+    const auto scaling = [&](auto *allocator) {
+      result = run_scaling(allocator, options, threads, cpus);
+    };
+    if (!with_allocator<Config>(name, 0, scaling)) {
+      return false;
+    }
+
+    const double rate = static_cast<double>(result.ops) / result.seconds;
+    if (threads == 1) {
+      base_rate = rate;
+    }
+    std::cout << name << " " << regions << " " << threads << " " << result.ops
+              << " " << result.seconds << " " << rate << " "
+              << rate / base_rate << " " << result.failed << std::endl;
+    results.row(name, regions, threads, result.ops, result.seconds, rate,
+                rate / base_rate, result.failed);
+  }
+  return true;
+}
+
+// Every region count splits the same 2 MiB heap, so only the number of
+// regions and their size change
+static bool run(const Options &options, const std::string &name, int regions,
+                const std::vector<int> &cpus, ResultsFile &results) {
+  switch (regions) {
+  case 1:
+    return run_regions<TuneConfig<1, false, 0>>(options, name, regions, cpus,
+                                                results);
+  case 2:
+    return run_regions<TuneConfig<2, false, 0>>(options, name, regions, cpus,
+                                                results);
+  case 4:
+    return run_regions<TuneConfig<4, false, 0>>(options, name, regions, cpus,
+                                                results);
+  case 8:
+    return run_regions<TuneConfig<8, false, 0>>(options, name, regions, cpus,
+                                                results);
+  case 16:
+    return run_regions<TuneConfig<16, false, 0>>(options, name, regions, cpus,
+                                                 results);
+  default:
+    std::cerr << "Unsupported region count: " << regions << std::endl;
+    return false;
+  }
+}
+
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options]\n"
+      << "  -a allocators   comma separated, or all (bt)\n"
+      << "  -r regions      region counts out of 1,2,4,8,16, comma separated "
+         "(all)\n"
+      << "  -t threads      largest thread count, the sweep doubles from 1 "
+         "(CPUs)\n"
+      << "  -f percent      share of operations that free (50)\n"
+      << "  -s min-max      range of allocation sizes (16-256)\n"
+      << "  -w blocks       live blocks per thread at most (1024)\n"
+      << "  -d ms           duration of each run (1000)\n"
+      << "  -P              do not pin the threads to CPUs\n"
+      << "  -o file         also write the results as CSV, or JSON for .json"
+      << std::endl;
+}
+
+// Measures how allocation throughput scales with threads for allocators that
+// split a 2 MiB heap into different numbers of regions. Each run lasts a fixed time,
+// with the threads pinned to the allowed CPUs in turn, and reports the
+// operations per second and the speedup over one thread.
+int main(int argc, char **argv) {
+  Options options;
+  const std::vector<int> cpus = allowed_cpus();
+  options.maxThreads = cpus.empty() ? 1 : cpus.size();
+
+  int opt;
+  while ((opt = getopt(argc, argv, "a:r:t:f:s:w:d:Po:h")) != -1) {
+    switch (opt) {
+    case 'a': {
+      std::istringstream iss(optarg);
+      std::string name;
+      options.allocators.clear();
+      while (std::getline(iss, name, ',')) {
+        if (name == "all") {
+          options.allocators.insert(options.allocators.end(), allocatorNames,
+                                    allocatorNames + numAllocatorNames);
+        } else if (!name.empty()) {
+          options.allocators.push_back(name);
+        }
+      }
+      break;
+    }
+    case 'r': {
+      std::istringstream iss(optarg);
+      std::string regions;
+      options.regions.clear();
+      while (std::getline(iss, regions, ',')) {
+        options.regions.push_back(std::atoi(regions.c_str()));
+      }
+      break;
+    }
+    case 't':
+      options.maxThreads = std::atoi(optarg);
+      break;
+    case 'f':
+      options.freePercent = std::atoi(optarg);
+      break;
+    case 's': {
+      char *end;
+      options.minSize = std::strtoull(optarg, &end, 10);
+      options.maxSize =
+          *end == '-' ? std::strtoull(end + 1, nullptr, 10) : options.minSize;
+      break;
+    }
+    case 'w':
+      options.workingSet = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'd':
+      options.milliseconds = std::atoi(optarg);
+      break;
+    case 'P':
+      options.pin = false;
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || options.allocators.empty() ||
+      options.regions.empty() || options.maxThreads == 0 ||
+      options.freePercent > 100 || options.minSize == 0 ||
+      options.maxSize < options.minSize || options.workingSet == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  ResultsFile results(argc, argv);
+  results.set("allowed_cpus", cpus.size());
+  results.set("pinned", options.pin);
+  results.set("free_percent", options.freePercent);
+  results.set("min_size", options.minSize);
+  results.set("max_size", options.maxSize);
+  results.set("working_set", options.workingSet);
+  results.set("milliseconds", options.milliseconds);
+  if (!options.output.empty() &&
+      !results.open(options.output,
+                    {"allocator", "regions", "threads", "ops", "seconds",
+                     "ops_per_s", "speedup", "failed"})) {
+    return 1;
+  }
+
+  std::cout << "# " << cpus.size() << " CPUs"
+            << (options.pin ? ", threads pinned" : "") << std::endl;
+  std::cout << "allocator regions threads ops seconds ops/s speedup failed"
+            << std::endl;
+  for (const auto &name : options.allocators) {
+    for (const int regions : options.regions) {
+      if (!run(options, name, regions, cpus, results)) {
+        return 1;
+      }
+    }
+  }
+  return results.close() ? 0 : 1;
+}
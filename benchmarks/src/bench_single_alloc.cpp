@@ -1,87 +1,231 @@
-#include "../../include/buddy_allocator.hpp"
-#include "../../include/buddy_config.hpp"
-#include "../../include/buddy_helper.hpp"
-#include "../../include/buddy_instantiations.hpp"
+#include "allocators.hpp"
+#include "cycles.hpp"
+#include "results.hpp"
 
-#include "../../include/bbuddy.hpp"
-#include "../../include/bbuddy_instantiations.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
-#include "../../include/btbuddy.hpp"
-#include "../../include/btbuddy_instantiations.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct Options {
+  std::vector<std::string> allocators = {"bt"};
+  int lazyThreshold = 0;
+  std::vector<size_t> sizes;
+  size_t repetitions = 10000;
+  size_t warmup = 100;
+  bool free = false;
+  bool fresh = false;
+  bool means = false;
+  // Results file, CSV or JSON
+  std::string output;
+};
+
+// Times one allocation, or one free, of each size per repetition. A block of
+// the size is allocated and freed first, which leaves it in the lazy layer if
+// there is one, and every repetition frees what it allocated. With fresh set
+// the allocator is created again before every repetition, as in a process
+// per measurement, otherwise once per size. The memory is reused, so the heap
+// pages are faulted in during the warmup and not while timing. Times are read
+// from the cycle counter less the timer overhead and converted to
+// nanoseconds. Prints a "time size" record per repetition, or the mean per
+// size, and writes every repetition to the results file.
+template <typename Allocator>
+static bool measure(const Options &options, const std::string &name,
+                    uint64_t overhead, double cycles_ns,
+                    ResultsFile &results) {
+  void *addr = mmap(nullptr, sizeof(Allocator), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void *start = mmap(nullptr, heap_size<ZConfig>(), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED || start == MAP_FAILED) {
+    std::cerr << "Failed to mmap memory" << std::endl;
+    return false;
+  }
 
-#include "../../include/ibuddy.hpp"
-#include "../../include/ibuddy_instantiations.hpp"
+  bool ok = true;
+  for (const size_t size : options.sizes) {
+    double total = 0.0;
+    Allocator *allocator = nullptr;
+    for (size_t i = 0; i < options.warmup + options.repetitions && ok; i++) {
+      if (allocator == nullptr || options.fresh) {
+        allocator =
+            Allocator::create(addr, start, options.lazyThreshold, false);
+        allocator->deallocate(allocator->allocate(size), size);
+      }
+
+      uint64_t begin = 0, end = 0;
+      void *ptr;
+      if (options.free) {
+        ptr = allocator->allocate(size);
+        if (ptr != nullptr) {
+          begin = cycles_start();
+          allocator->deallocate(ptr, size);
+          end = cycles_end();
+        }
+      } else {
+        begin = cycles_start();
+        ptr = allocator->allocate(size);
+        asm volatile("" : : "r,m"(ptr) : "memory");
+        end = cycles_end();
+        if (ptr != nullptr) {
+          allocator->deallocate(ptr, size);
+        }
+      }
+      if (ptr == nullptr) {
+        std::cerr << "Failed to allocate " << size << " bytes with " << name
+                  << std::endl;
+        ok = false;
+        break;
+      }
+
+      if (i < options.warmup) {
+        continue;
+      }
+      const uint64_t cycles = end - begin;
+      const double time =
+          static_cast<double>(cycles > overhead ? cycles - overhead : 0) /
+          cycles_ns;
+      total += time;
+      if (!options.means) {
+        std::cout << time << " " << size << "\n";
+      }
+      results.row(name, size, options.free ? "free" : "alloc",
+                  i - options.warmup, time);
+    }
+    if (ok && options.means) {
+      std::cout << name << " " << size << " "
+                << total / static_cast<double>(options.repetitions) << "\n";
+    }
+  }
+  std::cout.flush();
 
-#include <time.h>
+  munmap(addr, sizeof(Allocator));
+  munmap(start, heap_size<ZConfig>());
+  return ok;
+}
 
-#include <cstdlib>
-#include <ctime>
-#include <iostream>
-#include <sys/mman.h>
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options]\n"
+      << "  -a allocators   binary,bt,bt-blocked,wbt,wbt8,ibuddy or all (bt)\n"
+      << "  -l threshold    lazy threshold (0)\n"
+      << "  -s sizes        comma separated (every block size of ZConfig)\n"
+      << "  -n count        measured repetitions per size (10000)\n"
+      << "  -w count        unmeasured repetitions per size first (100)\n"
+      << "  -f              time the free instead of the allocation\n"
+      << "  -F              create the allocator again every repetition\n"
+      << "  -m              print the mean per size instead of every time\n"
+      << "  -o file         also write every time as CSV, or JSON for .json"
+      << std::endl;
+}
 
+// Measures single allocations and frees on ZGC sized allocators, repeating
+// them in one process instead of starting a process per measurement
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " <N> <size>" << std::endl;
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:l:s:n:w:fFmo:h")) != -1) {
+    switch (opt) {
+    case 'a': {
+      std::istringstream iss(optarg);
+      std::string name;
+      options.allocators.clear();
+      while (std::getline(iss, name, ',')) {
+        if (name == "all") {
+          options.allocators.insert(options.allocators.end(), allocatorNames,
+                                    allocatorNames + numBuddyAllocatorNames);
+        } else if (!name.empty()) {
+          options.allocators.push_back(name);
+        }
+      }
+      break;
+    }
+    case 'l':
+      options.lazyThreshold = std::atoi(optarg);
+      break;
+    case 's': {
+      std::istringstream iss(optarg);
+      std::string size;
+      while (std::getline(iss, size, ',')) {
+        options.sizes.push_back(std::strtoull(size.c_str(), nullptr, 10));
+      }
+      break;
+    }
+    case 'n':
+      options.repetitions = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'w':
+      options.warmup = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'f':
+      options.free = true;
+      break;
+    case 'F':
+      options.fresh = true;
+      break;
+    case 'm':
+      options.means = true;
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || options.allocators.empty() ||
+      options.repetitions == 0) {
+    usage(argv[0]);
     return 1;
   }
+  if (options.sizes.empty()) {
+    for (size_t size = ZConfig::minBlockSize; size <= ZConfig::maxBlockSize;
+         size *= 2) {
+      options.sizes.push_back(size);
+    }
+  }
+  for (const size_t size : options.sizes) {
+    if (size == 0 || size > ZConfig::maxBlockSize) {
+      std::cerr << "Invalid size: " << size << std::endl;
+      return 1;
+    }
+  }
 
-  int N = std::atoi(argv[1]);
-  int size = std::atoi(argv[2]);
-
-  // mmap 2MB
-  void *mem = mmap(nullptr, 2 * 1024 * 1024, PROT_READ | PROT_WRITE,
-                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  void *allocator_mem =
-      mmap(nullptr, sizeof(BTBuddyAllocator<ZConfig>), PROT_READ | PROT_WRITE,
-           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  if (mem == MAP_FAILED) {
-    std::cerr << "Failed to mmap memory" << std::endl;
+  const double cycles_ns = cycles_per_ns();
+  const uint64_t overhead = cycles_overhead();
+
+  ResultsFile results(argc, argv);
+  results.set("config", "z");
+  results.set("lazy", options.lazyThreshold);
+  results.set("repetitions", options.repetitions);
+  results.set("warmup", options.warmup);
+  results.set("fresh", options.fresh);
+  results.set("cycles_per_ns", cycles_ns);
+  results.set("timer_overhead_cycles", overhead);
+  if (!options.output.empty() &&
+      !results.open(options.output,
+                    {"allocator", "size", "op", "repetition", "time_ns"})) {
     return 1;
   }
 
-  double totalTime = 0.0;
-
-  for (int i = 0; i < N; i++) {
-    // Create btbuddy instance
-    BuddyAllocator<ZConfig> *btbuddy =
-        BTBuddyAllocator<ZConfig>::create(allocator_mem, mem, 10, false);
-        // BinaryBuddyAllocator<ZConfig>::create(allocator_mem, mem, 10, false);
-
-    // Place allocation in the lazy layer
-    void *ptr1 = btbuddy->allocate(size);
-    // std::cout << "Allocated address: " << ptr1 << std::endl;
-    btbuddy->deallocate(ptr1, size);
-
-    // Start the timer
-    timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
-
-    // Allocate once
-    void *ptr = btbuddy->allocate(size);
-    asm volatile("" : : "r,m"(ptr) : "memory");
-
-    // Stop the timer
-    clock_gettime(CLOCK_MONOTONIC_RAW, &end);
-    if (ptr != mem) {
-      std::cerr << "Error: " << ptr << " != " << mem << std::endl;
+  for (const auto &name : options.allocators) {
+    bool ok = false;
+    const auto run = [&](auto *type) {
+      using Allocator = typename std::remove_pointer<decltype(type)>::type;
+      ok = measure<Allocator>(options, name, overhead, cycles_ns, results);
+    };
+    if (!with_buddy_type<ZConfig>(name, run)) {
+      std::cerr << "Unknown allocator: " << name << std::endl;
+      return 1;
+    }
+    if (!ok) {
       return 1;
     }
-
-    // Calculate the elapsed time in nanoseconds
-    const double elapsedTime = end.tv_nsec - start.tv_nsec;
-
-    // Print the allocated address and elapsed time
-    // std::cout << "Allocated address: " << ptr << ", Elapsed time: " <<
-    // elapsedTime << " ms" << std::endl;
-
-    totalTime += elapsedTime;
   }
-
-  // Calculate the average time
-  double averageTime = totalTime / N;
-
-  // Print the average time
-  std::cout << "Average time: " << averageTime << " ns" << std::endl;
-
-  return 0;
+  return results.close() ? 0 : 1;
 }
@@ -12,6 +12,8 @@
 #include "../../include/ibuddy.hpp"
 #include "../../include/ibuddy_instantiations.hpp"
 
+#include "perf_counters.hpp"
+
 #include <array>
 #include <cassert>
 #include <chrono>
@@ -114,6 +116,9 @@ int main() {
 
   process_file(filename, allocation_sizes);
 
+  // The counters follow the threads created below
+  PerfCounters counters;
+  counters.start();
   auto start_time = std::chrono::high_resolution_clock::now();
 
   for (int i = 0; i < n_cycles; i++) {
@@ -140,9 +145,15 @@ int main() {
   // assert(allocator->allocate(1) == nullptr);
 
   auto end_time = std::chrono::high_resolution_clock::now();
+  const PerfSample perf = counters.stop();
   auto duration = end_time - start_time;
   const double seconds = std::chrono::duration<double>(duration).count();
   std::cout << "Concurrent took: " << seconds << " seconds" << std::endl;
+
+  const size_t allocs_per_run =
+      const_allocs ? allocs_per_thread : allocation_sizes.size();
+  perf.print(std::cout, static_cast<uint64_t>(n_cycles) * n_threads *
+                            runs_per_thread * allocs_per_run);
   // allocator->empty_lazy_list();
   // allocator->print_free_list();
 }
\ No newline at end of file
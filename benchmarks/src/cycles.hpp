@@ -0,0 +1,100 @@
+#ifndef CYCLES_HPP_
+#define CYCLES_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Cycle counter for timing single operations, which are below the resolution
+// of clock_gettime. On x86 the time stamp counter is read with fences so that
+// the measured code can not be reordered around the reads, elsewhere it falls
+// back to the steady clock in nanoseconds.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Reads the counter once every earlier instruction has finished
+inline uint64_t cycles_start() {
+  unsigned int low, high;
+  asm volatile("lfence\n\trdtsc" : "=a"(low), "=d"(high) : : "memory");
+  return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+// Reads the counter once the measured code has finished, before any later
+// instruction starts
+inline uint64_t cycles_end() {
+  unsigned int low, high;
+  asm volatile("rdtscp\n\tlfence" : "=a"(low), "=d"(high) : : "rcx", "memory");
+  return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+#else
+
+inline uint64_t cycles_start() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline uint64_t cycles_end() { return cycles_start(); }
+
+#endif
+
+// Counter ticks per nanosecond, measured against the steady clock over about
+// 50 ms
+inline double cycles_per_ns() {
+  const auto start_time = std::chrono::steady_clock::now();
+  const uint64_t start = cycles_start();
+  while (std::chrono::steady_clock::now() - start_time <
+         std::chrono::milliseconds(50)) {
+  }
+  const uint64_t end = cycles_end();
+  const auto end_time = std::chrono::steady_clock::now();
+
+  const double ns =
+      std::chrono::duration<double, std::nano>(end_time - start_time).count();
+  return static_cast<double>(end - start) / ns;
+}
+
+// Ticks taken by an empty measurement, the smallest of many so that
+// interrupts do not count
+inline uint64_t cycles_overhead() {
+  uint64_t overhead = UINT64_MAX;
+  for (int i = 0; i < 10000; i++) {
+    const uint64_t start = cycles_start();
+    const uint64_t end = cycles_end();
+    overhead = std::min(overhead, end - start);
+  }
+  return overhead;
+}
+
+struct LatencySummary {
+  double p50 = 0.0;
+  double p90 = 0.0;
+  double p99 = 0.0;
+  double p999 = 0.0;
+  double max = 0.0;
+};
+
+// Summarizes samples in ticks as nanoseconds, sorting them
+inline LatencySummary summarize(std::vector<uint64_t> &samples,
+                                double cyclesPerNs) {
+  LatencySummary summary;
+  if (samples.empty()) {
+    return summary;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  auto at = [&](double p) {
+    const size_t i = static_cast<size_t>(p * (samples.size() - 1));
+    return static_cast<double>(samples[i]) / cyclesPerNs;
+  };
+  summary.p50 = at(0.5);
+  summary.p90 = at(0.9);
+  summary.p99 = at(0.99);
+  summary.p999 = at(0.999);
+  summary.max = at(1.0);
+  return summary;
+}
+
+#endif // CYCLES_HPP_
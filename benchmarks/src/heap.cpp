@@ -1,243 +1,391 @@
+#include "allocators.hpp"
+#include "results.hpp"
+#include "trace.hpp"
 
+#include <algorithm>
 #include <chrono>
-#include <fstream>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
-#include <map>
 #include <sstream>
+#include <string>
 #include <vector>
 
-#include <sys/mman.h>
-
-#include "../../include/buddy_allocator.hpp"
-#include "../../include/buddy_config.hpp"
-#include "../../include/buddy_helper.hpp"
-#include "../../include/buddy_instantiations.hpp"
-
-#include "../../include/bbuddy.hpp"
-#include "../../include/bbuddy_instantiations.hpp"
-
-#include "../../include/btbuddy.hpp"
-#include "../../include/btbuddy_instantiations.hpp"
-
-#include "../../include/ibuddy.hpp"
-#include "../../include/ibuddy_instantiations.hpp"
-
-struct Operation {
-  char type;
-  std::string id;
-  size_t size;
+#include <unistd.h>
+
+struct Options {
+  std::vector<std::string> allocators = {"binary", "bt", "ibuddy"};
+  std::vector<std::string> configs = {"z"};
+  int lazyThreshold = 0;
+  // Heap states taken evenly over the replay
+  size_t samples = 100;
+  // Take a heap state whenever a free follows an allocation instead
+  bool phases = false;
+  // Print the free block histogram of every heap state
+  bool holes = false;
+  // Results files of the summary and of the heap states, CSV or JSON
+  std::string output;
+  std::string samplesOutput;
 };
 
-struct Allocation {
-  void *addr;
-  size_t size;
+// Heap state after an operation of the replay
+struct HeapSample {
+  uint64_t op;
+  // Requested bytes and block bytes of the live blocks
+  size_t liveBytes;
+  size_t blockBytes;
+  // Heap bytes not in a free list, which includes the lazy lists
+  size_t usedBytes;
+  uint64_t failed;
+  double externalFragmentation;
+  // Free blocks of each level over all regions, read from the allocator
+  std::vector<unsigned int> holes;
 };
 
-static const size_t BLOCK_HEADER_SIZE = 0;
-
-static const size_t PAGE_SIZE = 2097152;
-// static const size_t PAGE_SIZE = 10 * 1000 * 1024;
-
-std::map<std::string, Allocation> heap;
-std::vector<Operation> operations;
+struct HeapReport {
+  std::string allocator;
+  std::string config;
+  size_t heapSize = 0;
+  size_t maxBlockSize = 0;
+  uint64_t ops = 0;
+  uint64_t failed = 0;
+  double seconds = 0.0;
+  size_t peakUsedBytes = 0;
+  size_t peakLiveBytes = 0;
+  std::vector<HeapSample> samples;
+  // Over the heap states
+  double meanExternalFragmentation = 0.0;
+  double maxExternalFragmentation = 0.0;
+  double meanInternalFragmentation = 0.0;
+};
 
-std::vector<bool> collect_heap(void *heap_start) {
-  uintptr_t hstart = (uintptr_t)heap_start;
-  std::vector<bool> partitions(PAGE_SIZE / 16, false);
+static double internal_fragmentation(const HeapSample &sample) {
+  return sample.blockBytes == 0
+             ? 0.0
+             : 1.0 - static_cast<double>(sample.liveBytes) /
+                         static_cast<double>(sample.blockBytes);
+}
 
-  // Fill heap table.
-  for (const auto &obj : heap) {
-    const Allocation &a = obj.second;
-    size_t ostart = (((uintptr_t)a.addr) - hstart) / 16;
-    for (int i = 0; i < (BLOCK_HEADER_SIZE / 16); i++) {
-      partitions[ostart - 1 - i] = true;
-    }
+// Size of the block a buddy allocator of Config gives for a request
+template <typename Config> static size_t block_size(size_t size) {
+  const size_t rounded = BuddyHelper::round_up_pow2(size);
+  return rounded < Config::minBlockSize ? Config::minBlockSize : rounded;
+}
 
-    for (int i = 0; i < (BuddyHelper::round_up_pow2(a.size) / 16); i++) {
-      // for (int i = 0; i < (a.size / 16); i++) {
-      partitions[ostart + i] = true;
+template <typename Config, typename Allocator>
+static HeapSample take_sample(Allocator *allocator, uint64_t op,
+                              size_t liveBytes, size_t blockBytes,
+                              uint64_t failed) {
+  HeapSample sample = {op,      liveBytes, blockBytes,
+                       heap_size<Config>() - allocator->free_size(),
+                       failed,  allocator->fragmentation(),
+                       std::vector<unsigned int>(Config::numLevels, 0)};
+  unsigned int counts[Config::numLevels];
+  for (uint8_t r = 0; r < Config::numRegions; r++) {
+    allocator->free_block_histogram(r, counts);
+    for (unsigned int l = 0; l < Config::numLevels; l++) {
+      sample.holes[l] += counts[l];
     }
   }
-
-  return partitions;
+  return sample;
 }
 
-std::vector<size_t> collect_heap_holes(void *heap_start) {
-  std::vector<size_t> holes;
-  std::vector<bool> partitions = collect_heap(heap_start);
+// Replays the trace once timed, and once more on a fresh allocator that
+// tracks the footprint after every operation and takes the heap states
+template <typename Config>
+static bool replay(const Options &options, const std::string &name,
+                   const std::vector<TraceOp> &ops, uint64_t numIds,
+                   HeapReport &report) {
+  report.heapSize = heap_size<Config>();
+  report.maxBlockSize = Config::maxBlockSize;
+  report.ops = ops.size();
+
+  const auto timed = [&](auto *allocator) {
+    std::vector<TraceLive> live(numIds, TraceLive{nullptr, 0});
+    const auto start = std::chrono::steady_clock::now();
+    report.failed = replay_ops(allocator, ops.data(), ops.size(), live.data());
+    report.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  };
+
+  const auto measured = [&](auto *allocator) {
+    std::vector<TraceLive> live(numIds, TraceLive{nullptr, 0});
+    const uint64_t interval = std::max<uint64_t>(1, ops.size() / options.samples);
+    size_t liveBytes = 0;
+    size_t blockBytes = 0;
+    uint64_t failed = 0;
+    for (uint64_t i = 0; i < ops.size(); i++) {
+      const TraceOp &op = ops[i];
+      if (options.phases && i > 0 && op.type == 'f' &&
+          ops[i - 1].type == 'a') {
+        report.samples.push_back(take_sample<Config>(
+            allocator, i, liveBytes, blockBytes, failed));
+      }
+
+      if (op.type == 'a') {
+        void *addr = allocator->allocate(op.size);
+        live[op.id] = {addr, op.size};
+        if (addr == nullptr) {
+          failed++;
+        } else {
+          liveBytes += op.size;
+          blockBytes += block_size<Config>(op.size);
+        }
+      } else if (op.id != TRACE_NULL_ID && live[op.id].addr != nullptr) {
+        allocator->deallocate(live[op.id].addr, live[op.id].size);
+        live[op.id].addr = nullptr;
+        liveBytes -= live[op.id].size;
+        blockBytes -= block_size<Config>(live[op.id].size);
+      }
 
-  size_t counter = 0;
-  for (size_t i = 0; i < partitions.size(); i++) {
-    if (partitions[i] || i == (partitions.size() - 1)) {
-      if (i != 0 && counter > 0) {
-        holes.push_back(counter);
+      report.peakUsedBytes =
+          std::max(report.peakUsedBytes,
+                   heap_size<Config>() - allocator->free_size());
+      report.peakLiveBytes = std::max(report.peakLiveBytes, liveBytes);
+      if (!options.phases &&
+          ((i + 1) % interval == 0 || i + 1 == ops.size())) {
+        report.samples.push_back(take_sample<Config>(
+            allocator, i + 1, liveBytes, blockBytes, failed));
       }
-      counter = 0;
-    } else {
-      counter += 16;
     }
+  };
+
+  bool ok = false;
+  const auto run = [&](auto *type) {
+    using Allocator = typename std::remove_pointer<decltype(type)>::type;
+    ok = with_buddy<Allocator, Config>(options.lazyThreshold, timed) &&
+         with_buddy<Allocator, Config>(options.lazyThreshold, measured);
+  };
+  if (!with_buddy_type<Config>(name, run)) {
+    std::cerr << "Unknown allocator: " << name << std::endl;
+    return false;
   }
-
-  return holes;
+  return ok;
 }
 
-void dump_heap_state(void *heap_start) {
-  std::map<size_t, size_t> counts;
-  std::vector<size_t> holes = collect_heap_holes(heap_start);
-  size_t last_free = 0;
-
-  for (size_t i = 0; i < holes.size(); i++) {
-    if (i == holes.size() - 1) {
-      last_free = holes[i];
-    } else {
-      counts[holes[i]]++;
+static std::string hole_histogram(const HeapReport &report,
+                                  const HeapSample &sample) {
+  std::ostringstream oss;
+  for (size_t l = sample.holes.size(); l-- > 0;) {
+    if (sample.holes[l] > 0) {
+      oss << (oss.tellp() > 0 ? " " : "") << sample.holes[l] << "x"
+          << (report.maxBlockSize >> l);
     }
   }
+  return oss.str();
+}
 
-  for (const auto &pair : counts) {
-    std::cout << std::setw(7) << pair.second << " " << pair.first << std::endl;
+static void summarize(HeapReport &report) {
+  for (const HeapSample &s : report.samples) {
+    report.meanExternalFragmentation += s.externalFragmentation;
+    report.maxExternalFragmentation =
+        std::max(report.maxExternalFragmentation, s.externalFragmentation);
+    report.meanInternalFragmentation += internal_fragmentation(s);
+  }
+  if (!report.samples.empty()) {
+    report.meanExternalFragmentation /= report.samples.size();
+    report.meanInternalFragmentation /= report.samples.size();
   }
-
-  std::cout << "END " << last_free << std::endl;
-  // std::cout << "END " << std::endl;
 }
 
-void print_free_blocks(void *heap_start) {
-  std::vector<size_t> holes = collect_heap_holes(heap_start);
-
-  for (size_t hole : holes) {
-    std::cout << hole << std::endl;
+static void print_summary(const std::vector<HeapReport> &reports) {
+  std::cout << "allocator config ns/op failed peak-used peak-live "
+               "peak-overhead external-frag(mean,max) internal-frag(mean)"
+            << std::endl;
+  for (const HeapReport &r : reports) {
+    std::cout << r.allocator << " " << r.config << " "
+              << r.seconds * 1e9 / std::max<double>(1, r.ops) << " "
+              << r.failed << " " << r.peakUsedBytes << " " << r.peakLiveBytes
+              << " "
+              << (r.peakLiveBytes == 0
+                      ? 0.0
+                      : static_cast<double>(r.peakUsedBytes) /
+                            static_cast<double>(r.peakLiveBytes))
+              << " " << r.meanExternalFragmentation << ","
+              << r.maxExternalFragmentation << " "
+              << r.meanInternalFragmentation << std::endl;
   }
 }
 
-void print_heap(void *heap_start) {
-  std::vector<bool> partitions = collect_heap(heap_start);
-
-  for (size_t i = 0; i < partitions.size(); i++) {
-    if (partitions[i])
-      std::cout << '1';
-    else
-      std::cout << "\033[41m \033[0m";
-
-    if (i % 256 == 255)
-      std::cout << std::endl;
+// External fragmentation and used share of the heap at every tenth of the
+// replay
+static void print_over_time(const std::vector<HeapReport> &reports) {
+  std::cout << "\nexternal fragmentation / used heap at 10%, 20%, ... of the "
+               "operations"
+            << std::endl;
+  for (const HeapReport &r : reports) {
+    if (r.samples.empty()) {
+      continue;
+    }
+    std::cout << std::left << std::setw(12) << r.allocator << std::setw(13)
+              << r.config << std::right << std::fixed << std::setprecision(2);
+    for (unsigned int tenth = 1; tenth <= 10; tenth++) {
+      const uint64_t op = r.ops * tenth / 10;
+      const auto it = std::lower_bound(
+          r.samples.begin(), r.samples.end(), op,
+          [](const HeapSample &s, uint64_t o) { return s.op < o; });
+      const HeapSample &s = it == r.samples.end() ? r.samples.back() : *it;
+      std::cout << " " << s.externalFragmentation << "/"
+                << static_cast<double>(s.usedBytes) /
+                       static_cast<double>(r.heapSize);
+    }
+    std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
   }
 }
 
-uint8_t *mmap_allocate(size_t pool_size) {
-  return static_cast<uint8_t *>(mmap(nullptr, pool_size, PROT_READ | PROT_WRITE,
-                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options] <trace>\n"
+      << "The trace is binary, or text with 'a <id> <size>' and "
+         "'f <id> <size>' lines.\n"
+      << "  -a allocators   comma separated buddy allocators, or all "
+         "(binary,bt,ibuddy)\n"
+      << "  -c configs      z,small-single,small-double,large-quad,malloc,"
+         "stats,z-stats\n"
+      << "                  or all (z). The 2 MiB configs of autotune.out are "
+         "not listed.\n"
+      << "  -l threshold    lazy threshold (0)\n"
+      << "  -n count        heap states taken evenly over the replay (100)\n"
+      << "  -p              take a heap state whenever a free follows an "
+         "allocation\n"
+      << "  -H              print the free block histogram of every heap "
+         "state\n"
+      << "  -o file         write the summary as CSV, or JSON for .json\n"
+      << "  -s file         write every heap state as CSV, or JSON for .json"
+      << std::endl;
 }
 
-void process_file(const std::string &filename) {
-  std::ifstream file(filename);
-
-  if (!file.is_open()) {
-    std::cerr << "Failed to open the file: " << filename << std::endl;
-    exit(1);
+static std::vector<std::string> split_list(const char *arg,
+                                           const char *const *all,
+                                           size_t numAll) {
+  std::vector<std::string> items;
+  std::istringstream iss(arg);
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (item == "all") {
+      items.insert(items.end(), all, all + numAll);
+    } else if (!item.empty()) {
+      items.push_back(item);
+    }
   }
+  return items;
+}
 
-  char type;
-  std::string id;
-  size_t size;
-  std::string line;
+// Replays a trace through each allocator and config in turn and reports
+// the time per operation, the peak footprint, the failed allocations and the
+// fragmentation over time, side by side. The fragmentation and the free
+// block histograms are read from the allocator state.
+int main(int argc, char **argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:c:l:n:pHo:s:h")) != -1) {
+    switch (opt) {
+    case 'a':
+      options.allocators =
+          split_list(optarg, allocatorNames, numBuddyAllocatorNames);
+      break;
+    case 'c':
+      options.configs = split_list(optarg, configNames, numConfigNames);
+      break;
+    case 'l':
+      options.lazyThreshold = std::atoi(optarg);
+      break;
+    case 'n':
+      options.samples = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'p':
+      options.phases = true;
+      break;
+    case 'H':
+      options.holes = true;
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    case 's':
+      options.samplesOutput = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (argc - optind != 1 || options.allocators.empty() ||
+      options.configs.empty() || options.samples == 0) {
+    usage(argv[0]);
+    return 1;
+  }
 
-  while (std::getline(file, line)) {
-    std::istringstream iss(line);
-    iss >> type >> id >> size;
-    operations.push_back({type, id, size});
+  std::vector<TraceOp> ops;
+  uint64_t numIds = 0;
+  if (!load_trace(argv[optind], ops, numIds)) {
+    return 1;
   }
 
-  file.close();
-}
+  ResultsFile summary(argc, argv);
+  ResultsFile samples(argc, argv);
+  for (ResultsFile *results : {&summary, &samples}) {
+    results->set("trace", argv[optind]);
+    results->set("lazy", options.lazyThreshold);
+  }
+  if (!options.output.empty() &&
+      !summary.open(options.output,
+                    {"allocator", "config", "ops", "seconds", "ns_per_op",
+                     "failed", "peak_used_bytes", "peak_live_bytes",
+                     "mean_external_frag", "max_external_frag",
+                     "mean_internal_frag"})) {
+    return 1;
+  }
+  if (!options.samplesOutput.empty() &&
+      !samples.open(options.samplesOutput,
+                    {"allocator", "config", "heap_bytes", "op", "live_bytes",
+                     "block_bytes", "used_bytes", "failed", "external_frag",
+                     "internal_frag", "holes"})) {
+    return 1;
+  }
 
-void apply_distribution(BuddyAllocator<ZConfig> *allocator, void *heap_start) {
-  size_t counter = 0;
-  size_t allocated_size = 0;
-  size_t used_size = 0;
-  bool prev_alloc = false;
-  for (const Operation &op : operations) {
-    counter++;
-    // if (!prev_alloc && op.type == 'a') {
-    //   allocator->empty_lazy_list();
-    // }
-    if (prev_alloc && op.type == 'f') {
-      dump_heap_state(heap_start);
-    }
-    prev_alloc = op.type == 'a';
-
-    // if (counter % 1000 == 0) {
-    //   dump_heap_state(heap_start);
-    //   std::cout << "Allocated: " << allocated_size << " Used: " << used_size
-    //             << " Waste: "
-    //             << (float)(allocated_size - used_size) / (float)allocated_size
-    //             << std::endl;
-    // }
-
-    if (op.type == 'a') {
-      if (op.size > 262144) {
-        std::cout << "Skipping too large allocate request of: " << op.size
-                  << std::endl;
-        continue;
+  std::vector<HeapReport> reports;
+  for (const auto &config : options.configs) {
+    for (const auto &name : options.allocators) {
+      HeapReport report;
+      report.allocator = name;
+      report.config = config;
+      bool ok = false;
+      const auto run = [&](auto *type) {
+        using Config = typename std::remove_pointer<decltype(type)>::type;
+        ok = replay<Config>(options, name, ops, numIds, report);
+      };
+      if (!with_config(config, run)) {
+        std::cerr << "Unknown config: " << config << std::endl;
+        return 1;
       }
-      void *addr = allocator->allocate(op.size);
-      if (addr != nullptr) {
-        // heap[op.id] = {addr, JSMallocUtil::align_up(op.size, 16)};
-        heap[op.id] = {addr, op.size};
-        // heap[op.id] = {addr, BuddyHelper::round_up_pow2(op.size)};
-        allocated_size += BuddyHelper::round_up_pow2(op.size);
-        used_size += op.size;
-      } else {
-        std::cout << "Failed to allocate: " << op.size << std::endl;
+      if (!ok) {
+        return 1;
       }
-    } else if (op.type == 'f') {
-      if (op.id == "(nil)") {
-        // allocator.free(nullptr);
-        allocator->deallocate(nullptr, 0);
-      } else {
-        // allocator.free(heap[op.id].addr);
-        allocator->deallocate(heap[op.id].addr, heap[op.id].size);
-        heap.erase(op.id);
-        allocated_size -= BuddyHelper::round_up_pow2(op.size);
-        used_size -= op.size;
+
+      summarize(report);
+      for (const HeapSample &s : report.samples) {
+        samples.row(name, config, report.heapSize, s.op, s.liveBytes,
+                    s.blockBytes, s.usedBytes, s.failed,
+                    s.externalFragmentation, internal_fragmentation(s),
+                    hole_histogram(report, s));
+        if (options.holes) {
+          std::cout << name << " " << config << " op " << s.op << ": "
+                    << hole_histogram(report, s) << std::endl;
+        }
       }
+      summary.row(name, config, report.ops, report.seconds,
+                  report.seconds * 1e9 / std::max<double>(1, report.ops),
+                  report.failed, report.peakUsedBytes, report.peakLiveBytes,
+                  report.meanExternalFragmentation,
+                  report.maxExternalFragmentation,
+                  report.meanInternalFragmentation);
+      reports.push_back(std::move(report));
     }
   }
-}
-
-int main(int argc, char **argv) {
-
-  if (argc < 2) {
-    std::cout << "Usage: ./" << argv[0] << " <filename>" << std::endl;
-    std::cout << "The provided file should describe an allocation/free pattern "
-                 "on the following form:"
-              << std::endl;
-    std::cout << "Allocation:\t 'a <id> <size>'" << std::endl;
-    std::cout << "Free:\t\t 'f <id> <size>'" << std::endl;
-    exit(1);
-  }
-
-  std::string filename = argv[1];
-
-  void *pool = mmap_allocate(PAGE_SIZE);
-  // JSMallocZ allocator(pool, PAGE_SIZE, false);
-  BuddyAllocator<ZConfig> *allocator =
-      // BinaryBuddyAllocator<ZConfig>::create(nullptr, pool, 0, false);
-      BTBuddyAllocator<ZConfig>::create(nullptr, pool, 0, false);
-      // IBuddyAllocator<ZConfig>::create(nullptr, pool, 1000, false);
-
-  process_file(filename);
-
-  // auto start_time = std::chrono::high_resolution_clock::now();
-  apply_distribution(allocator, pool);
-  // print_heap(pool);
-  // print_free_blocks(pool);
-
-  // auto end_time = std::chrono::high_resolution_clock::now();
-  // auto duration = end_time - start_time;
-  // const double seconds = std::chrono::duration<double>(duration).count();
-  // std::cout << seconds << std::endl;
 
-  return 0;
+  print_summary(reports);
+  print_over_time(reports);
+  return summary.close() && samples.close() ? 0 : 1;
 }
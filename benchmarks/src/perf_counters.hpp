@@ -0,0 +1,163 @@
+#ifndef PERF_COUNTERS_HPP_
+#define PERF_COUNTERS_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Hardware counters read around a measured section with perf_event_open.
+// Each event is opened on its own, so events the machine or container does
+// not allow are left out, and with none of them only the time is measured.
+// The counters follow threads created after they were opened, and count a
+// thread once it has exited, so threads must be joined before stop().
+
+enum PerfEvent {
+  Cycles,
+  Instructions,
+  L1DMisses,
+  LLCMisses,
+  DTLBMisses,
+  BranchMisses,
+  NumPerfEvents
+};
+
+static const char *const perfEventNames[NumPerfEvents] = {
+    "cycles",     "instructions", "l1d-misses",
+    "llc-misses", "dtlb-misses",  "branch-misses"};
+
+struct PerfSample {
+  double seconds = 0.0;
+  // Counts scaled up for the time the event was multiplexed out, negative
+  // for unavailable events
+  double counts[NumPerfEvents] = {-1, -1, -1, -1, -1, -1};
+
+  void add(const PerfSample &other) {
+    seconds += other.seconds;
+    for (int i = 0; i < NumPerfEvents; i++) {
+      counts[i] = other.counts[i] < 0
+                      ? -1
+                      : (counts[i] < 0 ? 0 : counts[i]) + other.counts[i];
+    }
+  }
+
+  // Prints the counts per operation on one line
+  void print(std::ostream &out, uint64_t ops) const {
+    out << "perf:";
+    bool any = false;
+    for (int i = 0; i < NumPerfEvents; i++) {
+      if (counts[i] >= 0) {
+        out << " " << perfEventNames[i] << " "
+            << counts[i] / static_cast<double>(ops) << "/op";
+        any = true;
+      }
+    }
+    if (!any) {
+      out << " counters unavailable, " << seconds * 1e9 / ops << " ns/op";
+    }
+    out << std::endl;
+  }
+};
+
+class PerfCounters {
+public:
+  PerfCounters() {
+    const uint64_t cache_miss =
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    open_event(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open_event(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open_event(L1DMisses, PERF_TYPE_HW_CACHE,
+               PERF_COUNT_HW_CACHE_L1D | cache_miss);
+    open_event(LLCMisses, PERF_TYPE_HW_CACHE,
+               PERF_COUNT_HW_CACHE_LL | cache_miss);
+    open_event(DTLBMisses, PERF_TYPE_HW_CACHE,
+               PERF_COUNT_HW_CACHE_DTLB | cache_miss);
+    open_event(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  ~PerfCounters() {
+    for (const int fd : _fds) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  // Whether any hardware event could be opened
+  bool available() const {
+    for (const int fd : _fds) {
+      if (fd >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void start() {
+    for (const int fd : _fds) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+    _startTime = std::chrono::steady_clock::now();
+  }
+
+  PerfSample stop() {
+    const auto end_time = std::chrono::steady_clock::now();
+    PerfSample sample;
+    sample.seconds =
+        std::chrono::duration<double>(end_time - _startTime).count();
+
+    for (int i = 0; i < NumPerfEvents; i++) {
+      if (_fds[i] < 0) {
+        continue;
+      }
+      ioctl(_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+      // Value, time enabled and time running
+      uint64_t values[3];
+      if (read(_fds[i], values, sizeof(values)) != sizeof(values)) {
+        continue;
+      }
+      sample.counts[i] =
+          values[2] == 0 ? 0.0
+                         : static_cast<double>(values[0]) *
+                               static_cast<double>(values[1]) /
+                               static_cast<double>(values[2]);
+    }
+    return sample;
+  }
+
+private:
+  void open_event(PerfEvent event, uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    _fds[event] = static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  int _fds[NumPerfEvents] = {-1, -1, -1, -1, -1, -1};
+  std::chrono::steady_clock::time_point _startTime;
+};
+
+#endif // PERF_COUNTERS_HPP_
@@ -0,0 +1,261 @@
+#ifndef REPLAY_THREADS_HPP_
+#define REPLAY_THREADS_HPP_
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Operation of a per-thread stream. Every allocation of the trace has its own
+// slot, which its free refers to, so reused ids never mix up two blocks.
+struct StreamOp {
+  // Position in the whole trace
+  uint64_t index;
+  uint32_t slot;
+  uint32_t size;
+  char type;
+};
+
+// Splits a trace into one stream per thread. Operations go to the thread
+// recorded in the trace if there is one. Otherwise allocations are dealt out
+// round robin by id, and frees go to the allocating thread, or in
+// crossPercent percent of the cases to the next thread. Frees of blocks that
+// are not allocated at that point are dropped.
+inline std::vector<std::vector<StreamOp>>
+split_trace(const TraceOp *ops, uint64_t num_ops, uint64_t numIds,
+            unsigned int threads, unsigned int crossPercent,
+            uint32_t &numSlots) {
+
+  bool recorded = false;
+  for (uint64_t i = 0; i < num_ops && !recorded; i++) {
+    recorded = ops[i].thread != 0;
+  }
+
+  const uint32_t no_slot = 0xFFFFFFFF;
+  std::vector<uint32_t> slots(numIds, no_slot);
+  std::vector<uint32_t> sizes(numIds, 0);
+  std::vector<unsigned int> owners(numIds, 0);
+  std::vector<std::vector<StreamOp>> streams(threads);
+  numSlots = 0;
+
+  for (uint64_t i = 0; i < num_ops; i++) {
+    const TraceOp &op = ops[i];
+    if (op.id == TRACE_NULL_ID) {
+      continue;
+    }
+
+    unsigned int thread;
+    StreamOp stream_op = {i, 0, op.size, op.type};
+    if (op.type == 'a') {
+      thread = recorded ? op.thread % threads : op.id % threads;
+      stream_op.slot = numSlots++;
+      slots[op.id] = stream_op.slot;
+      sizes[op.id] = op.size;
+      owners[op.id] = thread;
+    } else {
+      if (slots[op.id] == no_slot) {
+        continue;
+      }
+      thread = owners[op.id];
+      if (recorded) {
+        thread = op.thread % threads;
+      } else if ((op.id * 2654435761U) % 100 < crossPercent) {
+        thread = (thread + 1) % threads;
+      }
+      stream_op.slot = slots[op.id];
+      stream_op.size = sizes[op.id];
+      slots[op.id] = no_slot;
+    }
+    streams[thread].push_back(stream_op);
+  }
+
+  return streams;
+}
+
+inline std::vector<std::vector<StreamOp>>
+split_trace(const TraceFile &trace, unsigned int threads,
+            unsigned int crossPercent, uint32_t &numSlots) {
+  return split_trace(trace.ops(), trace.header().numOps,
+                     trace.header().numIds, threads, crossPercent, numSlots);
+}
+
+// Barrier for the replay threads, which spin instead of sleeping so that they
+// leave it together
+class SpinBarrier {
+public:
+  explicit SpinBarrier(unsigned int count) : _count(count) {}
+
+  void wait() {
+    const unsigned int generation = _generation.load(std::memory_order_acquire);
+    if (_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == _count) {
+      _waiting.store(0, std::memory_order_relaxed);
+      _generation.fetch_add(1, std::memory_order_release);
+      return;
+    }
+    while (_generation.load(std::memory_order_acquire) == generation) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  const unsigned int _count;
+  std::atomic<unsigned int> _waiting{0};
+  std::atomic<unsigned int> _generation{0};
+};
+
+struct ThreadedReplayResult {
+  uint64_t ops = 0;
+  uint64_t failed = 0;
+  double seconds = 0.0;
+  // Latency of every operation in nanoseconds, sorted
+  std::vector<uint32_t> latencies;
+  // Hardware counters of all threads from their creation until they are
+  // joined, if given counters
+  PerfSample perf;
+
+  uint32_t percentile(double p) const {
+    if (latencies.empty()) {
+      return 0;
+    }
+    const size_t i = static_cast<size_t>(p / 100.0 * (latencies.size() - 1));
+    return latencies[i];
+  }
+};
+
+// Replays a trace on the given number of threads at the same time. With a
+// sync interval the threads meet at a barrier after every syncInterval
+// operations of the trace, otherwise they run freely. A free of a block
+// allocated by another thread waits until the allocation has happened, which
+// can not deadlock as it always waits for an earlier operation of the trace.
+// Without sizedFrees the blocks are freed without their size, which needs a
+// config with a size map.
+template <typename Allocator>
+ThreadedReplayResult
+replay_trace_threads(Allocator *allocator, const TraceOp *ops,
+                     uint64_t num_ops, uint64_t numIds, unsigned int threads,
+                     uint64_t syncInterval, unsigned int crossPercent,
+                     PerfCounters *counters = nullptr,
+                     bool sizedFrees = true) {
+  uint32_t num_slots = 0;
+  const std::vector<std::vector<StreamOp>> streams =
+      split_trace(ops, num_ops, numIds, threads, crossPercent, num_slots);
+
+  // Address of each allocation, failed allocations are marked so their frees
+  // do not wait forever
+  std::unique_ptr<std::atomic<void *>[]> live(
+      new std::atomic<void *>[num_slots]);
+  for (uint32_t i = 0; i < num_slots; i++) {
+    live[i].store(nullptr, std::memory_order_relaxed);
+  }
+  static char failed_marker;
+  void *const failed_alloc = &failed_marker;
+
+  const uint64_t windows =
+      syncInterval == 0 ? 1 : (num_ops + syncInterval - 1) / syncInterval;
+  std::vector<std::vector<uint32_t>> latencies(threads);
+  std::vector<uint64_t> failed(threads, 0);
+  std::vector<std::chrono::steady_clock::time_point> start_times(threads);
+  std::vector<std::chrono::steady_clock::time_point> end_times(threads);
+  SpinBarrier barrier(threads);
+
+  auto replay = [&](unsigned int t) {
+    const std::vector<StreamOp> &stream = streams[t];
+    std::vector<uint32_t> &latency = latencies[t];
+    latency.reserve(stream.size());
+    size_t pos = 0;
+
+    barrier.wait();
+    start_times[t] = std::chrono::steady_clock::now();
+    for (uint64_t w = 0; w < windows; w++) {
+      const uint64_t end = syncInterval == 0 ? num_ops : (w + 1) * syncInterval;
+      for (; pos < stream.size() && stream[pos].index < end; pos++) {
+        const StreamOp &op = stream[pos];
+        std::chrono::steady_clock::time_point start_time;
+        if (op.type == 'a') {
+          start_time = std::chrono::steady_clock::now();
+          void *addr = allocator->allocate(op.size);
+          latency.push_back(static_cast<uint32_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start_time)
+                  .count()));
+          if (addr == nullptr) {
+            failed[t]++;
+            addr = failed_alloc;
+          }
+          live[op.slot].store(addr, std::memory_order_release);
+        } else {
+          void *addr;
+          while ((addr = live[op.slot].load(std::memory_order_acquire)) ==
+                 nullptr) {
+            std::this_thread::yield();
+          }
+          if (addr == failed_alloc) {
+            continue;
+          }
+          start_time = std::chrono::steady_clock::now();
+          if (sizedFrees) {
+            allocator->deallocate(addr, op.size);
+          } else {
+            allocator->deallocate(addr);
+          }
+          latency.push_back(static_cast<uint32_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start_time)
+                  .count()));
+        }
+      }
+      if (syncInterval != 0) {
+        barrier.wait();
+      }
+    }
+    end_times[t] = std::chrono::steady_clock::now();
+  };
+
+  if (counters != nullptr) {
+    counters->start();
+  }
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < threads; t++) {
+    workers.emplace_back(replay, t);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  // Time from the common start until the last thread is done
+  ThreadedReplayResult result;
+  if (counters != nullptr) {
+    result.perf = counters->stop();
+  }
+  result.seconds =
+      std::chrono::duration<double>(
+          *std::max_element(end_times.begin(), end_times.end()) -
+          *std::min_element(start_times.begin(), start_times.end()))
+          .count();
+  for (unsigned int t = 0; t < threads; t++) {
+    result.failed += failed[t];
+    result.latencies.insert(result.latencies.end(), latencies[t].begin(),
+                            latencies[t].end());
+  }
+  result.ops = result.latencies.size();
+  std::sort(result.latencies.begin(), result.latencies.end());
+  return result;
+}
+
+template <typename Allocator>
+ThreadedReplayResult
+replay_trace_threads(Allocator *allocator, const TraceFile &trace,
+                     unsigned int threads, uint64_t syncInterval,
+                     unsigned int crossPercent,
+                     PerfCounters *counters = nullptr) {
+  return replay_trace_threads(allocator, trace.ops(), trace.header().numOps,
+                              trace.header().numIds, threads, syncInterval,
+                              crossPercent, counters);
+}
+
+#endif // REPLAY_THREADS_HPP_
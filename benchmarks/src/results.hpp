@@ -0,0 +1,255 @@
+#ifndef RESULTS_HPP_
+#define RESULTS_HPP_
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+// Flags the benchmarks were compiled with, set by the Makefile
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+// Results file of a benchmark run, with a row per measurement and the
+// metadata needed to compare runs from different machines and builds: the
+// command, date, host, kernel, CPU model, CPU count, compiler and flags, and
+// whatever the benchmark adds, such as the config. Written as CSV with the
+// metadata in leading "# key: value" lines, or as JSON if the file name ends
+// in .json. Every benchmark takes the file name with -o and keeps printing
+// its plain text output.
+class ResultsFile {
+public:
+  ResultsFile(int argc, char **argv) {
+    std::string command;
+    for (int i = 0; i < argc; i++) {
+      command += (i == 0 ? "" : " ") + std::string(argv[i]);
+    }
+    const std::string program = argv[0];
+    const size_t slash = program.rfind('/');
+    set("benchmark", slash == std::string::npos ? program
+                                                : program.substr(slash + 1));
+    set("command", command);
+
+    char date[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ",
+                  std::gmtime(&now));
+    set("date", date);
+
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    set("host", host);
+    struct utsname name;
+    if (uname(&name) == 0) {
+      set("kernel", std::string(name.sysname) + " " + name.release + " " +
+                        name.machine);
+    }
+    set("cpu", cpu_model());
+    set("cpus", sysconf(_SC_NPROCESSORS_ONLN));
+#ifdef __clang__
+    set("compiler", "clang " __clang_version__);
+#else
+    set("compiler", "gcc " __VERSION__);
+#endif
+    set("flags", BUILD_FLAGS);
+#ifdef __OPTIMIZE__
+    set("optimized", "yes");
+#else
+    set("optimized", "no");
+#endif
+  }
+
+  ResultsFile(const ResultsFile &) = delete;
+  ResultsFile &operator=(const ResultsFile &) = delete;
+  ~ResultsFile() { close(); }
+
+  // Adds or replaces a metadata entry, before the file is opened
+  template <typename Value>
+  void set(const std::string &key, const Value &value) {
+    std::ostringstream oss;
+    oss << value;
+    for (auto &entry : _metadata) {
+      if (entry.first == key) {
+        entry.second = oss.str();
+        return;
+      }
+    }
+    _metadata.emplace_back(key, oss.str());
+  }
+
+  // Creates the file and writes the metadata, printing the reason and
+  // returning false on failure
+  bool open(const std::string &path, const std::vector<std::string> &columns) {
+    _path = path;
+    _out.open(path);
+    if (!_out.is_open()) {
+      std::cerr << "Failed to open the file: " << path << std::endl;
+      return false;
+    }
+    _json =
+        path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    _columns = columns;
+    _rows = 0;
+
+    if (_json) {
+      _out << "{\n  \"metadata\": {";
+      for (size_t i = 0; i < _metadata.size(); i++) {
+        _out << (i == 0 ? "\n" : ",\n") << "    "
+             << json_string(_metadata[i].first) << ": "
+             << json_value(_metadata[i].second);
+      }
+      _out << "\n  },\n  \"results\": [";
+    } else {
+      for (const auto &entry : _metadata) {
+        _out << "# " << entry.first << ": " << entry.second << "\n";
+      }
+      for (size_t i = 0; i < _columns.size(); i++) {
+        _out << (i == 0 ? "" : ",") << _columns[i];
+      }
+      _out << "\n";
+    }
+    return _out.good();
+  }
+
+  bool is_open() const { return _out.is_open(); }
+
+  // Writes a row with a value per column, doing nothing if the file is not
+  // open
+  template <typename... Values> void row(const Values &...values) {
+    if (!_out.is_open()) {
+      return;
+    }
+    std::vector<std::string> fields;
+    add_fields(fields, values...);
+
+    if (_json) {
+      _out << (_rows == 0 ? "\n" : ",\n") << "    {";
+      for (size_t i = 0; i < fields.size() && i < _columns.size(); i++) {
+        _out << (i == 0 ? "" : ", ") << json_string(_columns[i]) << ": "
+             << json_value(fields[i]);
+      }
+      _out << "}";
+    } else {
+      for (size_t i = 0; i < fields.size(); i++) {
+        _out << (i == 0 ? "" : ",") << csv_field(fields[i]);
+      }
+      _out << "\n";
+    }
+    _rows++;
+  }
+
+  // Finishes the file, printing the reason and returning false if it could
+  // not be written
+  bool close() {
+    if (!_out.is_open()) {
+      return true;
+    }
+    if (_json) {
+      _out << (_rows == 0 ? "" : "\n  ") << "]\n}\n";
+    }
+    _out.close();
+    if (_out.fail()) {
+      std::cerr << "Failed to write the file: " << _path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+private:
+  static void add_fields(std::vector<std::string> & /*fields*/) {}
+
+  template <typename Value, typename... Values>
+  static void add_fields(std::vector<std::string> &fields, const Value &value,
+                         const Values &...values) {
+    std::ostringstream oss;
+    oss << std::setprecision(10) << value;
+    fields.push_back(oss.str());
+    add_fields(fields, values...);
+  }
+
+  static std::string cpu_model() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+      if (line.compare(0, 10, "model name") == 0) {
+        const size_t colon = line.find(':');
+        if (colon != std::string::npos && colon + 2 <= line.size()) {
+          return line.substr(colon + 2);
+        }
+      }
+    }
+    return "unknown";
+  }
+
+  // Whether the value is a number as JSON writes them, which leaves out the
+  // nan, inf and hexadecimal forms strtod accepts
+  static bool is_number(const std::string &value) {
+    if (value.empty() ||
+        value.find_first_not_of("0123456789+-.eE") != std::string::npos ||
+        (value[0] != '-' && (value[0] < '0' || value[0] > '9'))) {
+      return false;
+    }
+    char *end;
+    std::strtod(value.c_str(), &end);
+    return *end == '\0';
+  }
+
+  static std::string json_string(const std::string &value) {
+    std::string quoted = "\"";
+    for (const char c : value) {
+      if (c == '"' || c == '\\') {
+        quoted += '\\';
+        quoted += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        quoted += escaped;
+      } else {
+        quoted += c;
+      }
+    }
+    return quoted + "\"";
+  }
+
+  // Numbers are written as JSON numbers, empty values, which stand for
+  // unmeasured ones, as null and anything else as a string
+  static std::string json_value(const std::string &value) {
+    if (value.empty()) {
+      return "null";
+    }
+    return is_number(value) ? value : json_string(value);
+  }
+
+  static std::string csv_field(const std::string &value) {
+    if (value.find_first_of(",\"\n") == std::string::npos) {
+      return value;
+    }
+    std::string quoted = "\"";
+    for (const char c : value) {
+      quoted += c;
+      if (c == '"') {
+        quoted += '"';
+      }
+    }
+    return quoted + "\"";
+  }
+
+  std::vector<std::pair<std::string, std::string>> _metadata;
+  std::vector<std::string> _columns;
+  std::string _path;
+  std::ofstream _out;
+  bool _json = false;
+  size_t _rows = 0;
+};
+
+#endif // RESULTS_HPP_
@@ -0,0 +1,205 @@
+#ifndef SIZE_DIST_HPP_
+#define SIZE_DIST_HPP_
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char *const sizeDistNames[] = {"small", "medium", "large",
+                                            "mixed"};
+
+// Allocation sizes drawn from a distribution given as a spec:
+//   small, medium, large  uniform over 16-256, 256-4096 and 4096-65536 bytes
+//   mixed                 90% small, 9% medium and 1% large sizes
+//   <n>                   the fixed size n
+//   poisson[:l]           2^k bytes for k from a Poisson distribution with mean
+//                         l (6), k below 4 redrawn, moved by up to half either
+//                         way, rounded to 8 and kept within 16 and 2^18 bytes,
+//                         as benchmarks/data/dist.txt was made
+//   lognormal:mu:sigma    e^x bytes for x normally distributed
+//   bimodal:a:b:p         a bytes, or b bytes p percent of the time
+//   trace:<file>          the allocation sizes of a binary trace, drawn
+//                         uniformly
+class SizeDistribution {
+public:
+  explicit SizeDistribution(const std::string &spec) { _valid = parse(spec); }
+
+  static bool valid(const std::string &spec) {
+    return SizeDistribution(spec)._valid;
+  }
+
+  size_t operator()(std::mt19937 &rng) {
+    switch (_kind) {
+    case Kind::Uniform:
+      return std::uniform_int_distribution<size_t>(_a, _b)(rng);
+    case Kind::Mixed: {
+      const int p = std::uniform_int_distribution<int>(0, 99)(rng);
+      return p < 90   ? std::uniform_int_distribution<size_t>(16, 256)(rng)
+             : p < 99 ? std::uniform_int_distribution<size_t>(257, 4096)(rng)
+                      : std::uniform_int_distribution<size_t>(4097, 65536)(rng);
+    }
+    case Kind::Poisson:
+      return poisson(rng);
+    case Kind::LogNormal: {
+      const double size = _lognormal(rng) + 0.5;
+      return size < 1.0 ? 1 : static_cast<size_t>(size);
+    }
+    case Kind::Bimodal:
+      return std::uniform_real_distribution<double>(0.0, 100.0)(rng) < _p
+                 ? _b
+                 : _a;
+    case Kind::Empirical:
+      return _sizes[std::uniform_int_distribution<size_t>(
+          0, _sizes.size() - 1)(rng)];
+    case Kind::Fixed:
+      break;
+    }
+    return _a;
+  }
+
+private:
+  enum class Kind {
+    Fixed,
+    Uniform,
+    Mixed,
+    Poisson,
+    LogNormal,
+    Bimodal,
+    Empirical
+  };
+
+  bool parse(const std::string &spec) {
+    std::vector<std::string> parts;
+    std::istringstream iss(spec);
+    std::string part;
+    while (std::getline(iss, part, ':')) {
+      parts.push_back(part);
+    }
+    if (parts.empty()) {
+      return false;
+    }
+
+    const std::string &kind = parts[0];
+    if (parts.size() == 1 && kind == "small") {
+      return uniform(16, 256);
+    } else if (parts.size() == 1 && kind == "medium") {
+      return uniform(257, 4096);
+    } else if (parts.size() == 1 && kind == "large") {
+      return uniform(4097, 65536);
+    } else if (parts.size() == 1 && kind == "mixed") {
+      _kind = Kind::Mixed;
+      return true;
+    } else if (kind == "poisson" && parts.size() <= 2) {
+      _kind = Kind::Poisson;
+      return poisson_table(parts.size() == 2 ? std::atof(parts[1].c_str())
+                                             : 6.0);
+    } else if (kind == "lognormal" && parts.size() == 3) {
+      _kind = Kind::LogNormal;
+      const double mu = std::atof(parts[1].c_str());
+      const double sigma = std::atof(parts[2].c_str());
+      if (sigma <= 0.0) {
+        return false;
+      }
+      _lognormal = std::lognormal_distribution<double>(mu, sigma);
+      return true;
+    } else if (kind == "bimodal" && parts.size() == 4) {
+      _kind = Kind::Bimodal;
+      _a = std::strtoull(parts[1].c_str(), nullptr, 10);
+      _b = std::strtoull(parts[2].c_str(), nullptr, 10);
+      _p = std::atof(parts[3].c_str());
+      return _a > 0 && _b > 0 && _p >= 0.0 && _p <= 100.0;
+    } else if (kind == "trace" && parts.size() >= 2) {
+      _kind = Kind::Empirical;
+      return load_trace(spec.substr(kind.size() + 1));
+    } else if (parts.size() == 1) {
+      _kind = Kind::Fixed;
+      _a = std::strtoull(kind.c_str(), nullptr, 10);
+      return _a > 0;
+    }
+    return false;
+  }
+
+  bool uniform(size_t a, size_t b) {
+    _kind = Kind::Uniform;
+    _a = a;
+    _b = b;
+    return true;
+  }
+
+  bool load_trace(const std::string &path) {
+    TraceFile trace;
+    if (!trace.open(path.c_str())) {
+      return false;
+    }
+    const TraceOp *ops = trace.ops();
+    for (uint64_t i = 0; i < trace.header().numOps; i++) {
+      if (ops[i].type == 'a' && ops[i].size > 0) {
+        _sizes.push_back(ops[i].size);
+      }
+    }
+    if (_sizes.empty()) {
+      std::cerr << "No allocations in the trace: " << path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Cumulative probabilities of k from 4 to 19, where 19 stands for every k
+  // above 18, with k below 4 left out. Drawing from the table takes one
+  // random number where std::poisson_distribution takes several.
+  bool poisson_table(double mean) {
+    if (mean <= 0.0) {
+      return false;
+    }
+    double p = std::exp(-mean);
+    double below = 0.0;
+    for (int k = 0; k < 4; k++) {
+      below += p;
+      p *= mean / (k + 1);
+    }
+    double sum = 0.0;
+    for (int k = 4; k <= 18; k++) {
+      sum += p;
+      _cdf.push_back(sum / (1.0 - below));
+      p *= mean / (k + 1);
+    }
+    _cdf.push_back(1.0);
+    return below < 1.0;
+  }
+
+  size_t poisson(std::mt19937 &rng) {
+    const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    const int k = 4 + static_cast<int>(
+                          std::upper_bound(_cdf.begin(), _cdf.end() - 1, u) -
+                          _cdf.begin());
+    if (k > 18) {
+      return size_t(1) << 18;
+    }
+
+    const double block = static_cast<double>(size_t(1) << k);
+    const double jitter = std::uniform_real_distribution<double>(-1, 1)(rng);
+    const double size = block + 0.5 * block * jitter;
+    const auto rounded = static_cast<size_t>(std::lround(size / 8.0)) * 8;
+    return std::min(std::max(rounded, size_t(16)), size_t(1) << 18);
+  }
+
+  Kind _kind = Kind::Fixed;
+  bool _valid = false;
+  size_t _a = 0;
+  size_t _b = 0;
+  double _p = 0.0;
+  std::vector<double> _cdf;
+  std::lognormal_distribution<double> _lognormal;
+  std::vector<uint32_t> _sizes;
+};
+
+#endif // SIZE_DIST_HPP_
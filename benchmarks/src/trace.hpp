@@ -0,0 +1,260 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include "perf_counters.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary allocation trace, written by trace_convert and workload_gen. A
+// TraceHeader is followed by numOps operations. Ids are dense, from 0 to
+// numIds - 1, so a replay keeps the live blocks in a flat array indexed by id.
+
+static const char TRACE_MAGIC[4] = {'B', 'T', 'R', 'C'};
+static const uint32_t TRACE_VERSION = 1;
+
+// Id of the frees of a null pointer
+static const uint32_t TRACE_NULL_ID = 0xFFFFFFFF;
+
+struct TraceHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t numOps;
+  uint64_t numIds;
+};
+
+struct TraceOp {
+  uint32_t id;
+  // Requested size, only set for allocations
+  uint32_t size;
+  // 'a' for allocations and 'f' for frees
+  char type;
+  // Thread that performs the operation in a multithreaded replay
+  uint8_t thread;
+  uint16_t reserved;
+};
+
+// Read-only mapping of a binary trace file
+class TraceFile {
+public:
+  TraceFile() = default;
+  TraceFile(const TraceFile &) = delete;
+  TraceFile &operator=(const TraceFile &) = delete;
+  ~TraceFile() {
+    if (_data != MAP_FAILED) {
+      munmap(_data, _size);
+    }
+  }
+
+  // Maps the file, printing the reason and returning false on failure
+  bool open(const char *path) {
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      std::cerr << "Failed to open the file: " << path << std::endl;
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(TraceHeader)) {
+      std::cerr << "Not a trace file: " << path << std::endl;
+      close(fd);
+      return false;
+    }
+
+    _size = st.st_size;
+    _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (_data == MAP_FAILED) {
+      std::cerr << "Failed to mmap the file: " << path << std::endl;
+      return false;
+    }
+
+    const TraceHeader &h = header();
+    if (std::memcmp(h.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+        h.version != TRACE_VERSION ||
+        _size != sizeof(TraceHeader) + h.numOps * sizeof(TraceOp)) {
+      std::cerr << "Not a version " << TRACE_VERSION
+                << " trace file: " << path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  const TraceHeader &header() const {
+    return *static_cast<const TraceHeader *>(_data);
+  }
+
+  const TraceOp *ops() const {
+    return reinterpret_cast<const TraceOp *>(static_cast<const char *>(_data) +
+                                             sizeof(TraceHeader));
+  }
+
+private:
+  void *_data = MAP_FAILED;
+  size_t _size = 0;
+};
+
+// Reads a text trace of 'a <id> <size>' and 'f <id> <size>' lines, numbering
+// the ids in order of first use. Frees of (nil) get TRACE_NULL_ID.
+inline bool read_text_trace(const char *path, std::vector<TraceOp> &ops,
+                            uint64_t &numIds) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open the file: " << path << std::endl;
+    return false;
+  }
+
+  std::unordered_map<std::string, uint32_t> ids;
+  std::string line;
+  size_t line_number = 0;
+
+  while (std::getline(file, line)) {
+    line_number++;
+    std::istringstream iss(line);
+    char type;
+    std::string id;
+    size_t size = 0;
+    if (!(iss >> type >> id >> size) || (type != 'a' && type != 'f')) {
+      if (!line.empty()) {
+        std::cerr << "Skipping malformed line " << line_number << ": " << line
+                  << std::endl;
+      }
+      continue;
+    }
+
+    TraceOp op = {0, 0, type, 0, 0};
+    if (type == 'f' && id == "(nil)") {
+      op.id = TRACE_NULL_ID;
+    } else {
+      // Frees of unknown ids get an id too, the replay skips them
+      auto it = ids.emplace(id, static_cast<uint32_t>(ids.size())).first;
+      op.id = it->second;
+    }
+    if (type == 'a') {
+      op.size = static_cast<uint32_t>(size);
+    }
+    ops.push_back(op);
+  }
+  numIds = ids.size();
+  return true;
+}
+
+// Reads a binary or text trace into memory, printing the reason and returning
+// false on failure
+inline bool load_trace(const char *path, std::vector<TraceOp> &ops,
+                       uint64_t &numIds) {
+  char magic[sizeof(TRACE_MAGIC)] = {};
+  std::ifstream(path, std::ios::binary).read(magic, sizeof(magic));
+  if (std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+    return read_text_trace(path, ops, numIds);
+  }
+  TraceFile trace;
+  if (!trace.open(path)) {
+    return false;
+  }
+  ops.assign(trace.ops(), trace.ops() + trace.header().numOps);
+  numIds = trace.header().numIds;
+  return true;
+}
+
+struct ReplayResult {
+  uint64_t ops = 0;
+  uint64_t failed = 0;
+  double seconds = 0.0;
+  // Hardware counters of the replay loop, if given counters
+  PerfSample perf;
+};
+
+// Block of a trace id, null if not live
+struct TraceLive {
+  void *addr;
+  uint32_t size;
+};
+
+// Replays count operations on the live blocks, returning the failed
+// allocations. Frees of blocks whose allocation failed are skipped.
+template <typename Allocator>
+uint64_t replay_ops(Allocator *allocator, const TraceOp *ops, uint64_t count,
+                    TraceLive *live) {
+  uint64_t failed = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    const TraceOp &op = ops[i];
+    if (op.type == 'a') {
+      void *addr = allocator->allocate(op.size);
+      failed += addr == nullptr;
+      live[op.id] = {addr, op.size};
+    } else if (op.id != TRACE_NULL_ID && live[op.id].addr != nullptr) {
+      allocator->deallocate(live[op.id].addr, live[op.id].size);
+      live[op.id].addr = nullptr;
+    }
+  }
+  return failed;
+}
+
+// Replays every operation of a trace. Only the replay loop is timed and
+// counted.
+template <typename Allocator>
+ReplayResult replay_trace(Allocator *allocator, const TraceFile &trace,
+                          PerfCounters *counters = nullptr) {
+  std::vector<TraceLive> live(trace.header().numIds, TraceLive{nullptr, 0});
+  const uint64_t num_ops = trace.header().numOps;
+  ReplayResult result;
+
+  if (counters != nullptr) {
+    counters->start();
+  }
+  const auto start_time = std::chrono::steady_clock::now();
+  result.failed = replay_ops(allocator, trace.ops(), num_ops, live.data());
+  const auto end_time = std::chrono::steady_clock::now();
+  if (counters != nullptr) {
+    result.perf = counters->stop();
+  }
+
+  result.ops = num_ops;
+  result.seconds = std::chrono::duration<double>(end_time - start_time).count();
+  return result;
+}
+
+// Replays the operations of a source as they are made, without holding the
+// whole trace in memory. The source fills a batch of operations at a time
+// with size_t generate(TraceOp *ops, size_t count), returning 0 at the end,
+// and has uint64_t numIds(), the ids handed out so far. Only the replay of
+// each batch is timed, and no hardware counters are read.
+template <typename Allocator, typename Source>
+ReplayResult replay_stream(Allocator *allocator, Source &source,
+                           size_t batchSize = 1 << 16) {
+  std::vector<TraceOp> batch(batchSize);
+  std::vector<TraceLive> live;
+  ReplayResult result;
+
+  size_t count;
+  while ((count = source.generate(batch.data(), batch.size())) > 0) {
+    if (live.size() < source.numIds()) {
+      live.resize(source.numIds(), TraceLive{nullptr, 0});
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    result.failed += replay_ops(allocator, batch.data(), count, live.data());
+    const auto end_time = std::chrono::steady_clock::now();
+
+    result.ops += count;
+    result.seconds +=
+        std::chrono::duration<double>(end_time - start_time).count();
+  }
+  return result;
+}
+
+#endif // TRACE_HPP_
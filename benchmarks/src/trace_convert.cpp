@@ -0,0 +1,161 @@
+#include "../../include/malloc_trace.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Reads a capture of tracelib.so. The records are put in time order, as each
+// thread writes its own batches, and every allocation gets a new id, so an
+// address reused after a free is a new block. A realloc that moves or
+// resizes a block is a free of the old block and an allocation of the new
+// one. The thread numbers of the capture are kept, modulo 256.
+static bool read_capture(const char *path, std::vector<TraceOp> &ops,
+                         uint64_t &numIds) {
+  std::ifstream file(path, std::ios::binary);
+  MallocTraceHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.version != MALLOC_TRACE_VERSION) {
+    std::cerr << "Not a version " << MALLOC_TRACE_VERSION
+              << " capture: " << path << std::endl;
+    return false;
+  }
+  std::vector<MallocTraceRecord> records;
+  MallocTraceRecord record;
+  while (file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    records.push_back(record);
+  }
+  if (file.gcount() != 0) {
+    std::cerr << "Ignoring a partial record at the end of " << path
+              << std::endl;
+  }
+  std::stable_sort(records.begin(), records.end(),
+                   [](const MallocTraceRecord &a, const MallocTraceRecord &b) {
+                     return a.time < b.time;
+                   });
+
+  std::unordered_map<uint64_t, uint32_t> live;
+  uint32_t next_id = 0;
+  uint64_t unknown_frees = 0;
+  uint64_t reused = 0;
+  uint64_t truncated = 0;
+  uint16_t max_thread = 0;
+
+  const auto free_block = [&](uint64_t addr, uint8_t thread) {
+    if (addr == 0) {
+      ops.push_back({TRACE_NULL_ID, 0, 'f', thread, 0});
+      return;
+    }
+    auto it = live.find(addr);
+    if (it == live.end()) {
+      // Allocated before the capture started, or by the C library itself
+      unknown_frees++;
+      return;
+    }
+    ops.push_back({it->second, 0, 'f', thread, 0});
+    live.erase(it);
+  };
+  const auto allocate_block = [&](uint64_t addr, uint64_t size,
+                                  uint8_t thread) {
+    if (addr == 0) {
+      return;
+    }
+    if (live.count(addr) != 0) {
+      // The free of the block was not recorded, or recorded later than its
+      // reuse by another thread
+      reused++;
+      free_block(addr, thread);
+    }
+    if (size > UINT32_MAX) {
+      truncated++;
+      size = UINT32_MAX;
+    }
+    // malloc(0) returns a block of its own too
+    ops.push_back({next_id, std::max<uint32_t>(size, 1), 'a', thread, 0});
+    live.emplace(addr, next_id++);
+  };
+
+  for (const MallocTraceRecord &r : records) {
+    const uint8_t thread = static_cast<uint8_t>(r.thread);
+    max_thread = std::max(max_thread, r.thread);
+    switch (r.call) {
+    case 'f':
+      free_block(r.addr, thread);
+      break;
+    case 'r':
+      if (r.oldAddr == 0) {
+        allocate_block(r.addr, r.size, thread);
+      } else if (r.addr != 0 || r.size == 0) {
+        // A failed realloc leaves the old block allocated
+        free_block(r.oldAddr, thread);
+        allocate_block(r.addr, r.size, thread);
+      }
+      break;
+    default:
+      allocate_block(r.addr, r.size, thread);
+      break;
+    }
+  }
+  numIds = next_id;
+
+  std::cout << "Read " << records.size() << " calls of " << max_thread + 1
+            << " threads of process " << header.pid << ", skipped "
+            << unknown_frees << " frees of blocks allocated before the capture"
+            << std::endl;
+  if (reused > 0 || truncated > 0) {
+    std::cout << reused << " blocks were allocated again before their free "
+              << "was seen, " << truncated << " sizes did not fit 32 bits"
+              << std::endl;
+  }
+  return true;
+}
+
+// Converts a text trace, or a capture of the malloc calls of a program made
+// with tracelib.so, into the binary trace format
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cout << "Usage: " << argv[0]
+              << " <text trace or capture> <binary trace>" << std::endl;
+    return 1;
+  }
+
+  char magic[sizeof(MALLOC_TRACE_MAGIC)] = {};
+  std::ifstream(argv[1], std::ios::binary).read(magic, sizeof(magic));
+  const bool capture =
+      std::memcmp(magic, MALLOC_TRACE_MAGIC, sizeof(magic)) == 0;
+
+  std::vector<TraceOp> ops;
+  uint64_t numIds = 0;
+  if (!(capture ? read_capture(argv[1], ops, numIds)
+                : read_text_trace(argv[1], ops, numIds))) {
+    return 1;
+  }
+
+  TraceHeader header = {};
+  std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  header.version = TRACE_VERSION;
+  header.numOps = ops.size();
+  header.numIds = numIds;
+
+  FILE *out = std::fopen(argv[2], "wb");
+  if (out == nullptr) {
+    std::cerr << "Failed to open the file: " << argv[2] << std::endl;
+    return 1;
+  }
+  const bool written =
+      std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+      std::fwrite(ops.data(), sizeof(TraceOp), ops.size(), out) == ops.size();
+  if (std::fclose(out) != 0 || !written) {
+    std::cerr << "Failed to write the file: " << argv[2] << std::endl;
+    return 1;
+  }
+
+  std::cout << "Converted " << header.numOps << " operations on "
+            << header.numIds << " ids" << std::endl;
+  return 0;
+}
@@ -0,0 +1,162 @@
+#include "allocators.hpp"
+#include "replay_threads.hpp"
+#include "results.hpp"
+#include "trace.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+static void usage(const char *program) {
+  std::cout << "Usage: " << program
+            << " [-t threads] [-s sync interval] [-x cross free percent]"
+               " [-o results file]"
+               " <binary trace>"
+               " [binary|bt|bt-blocked|wbt|wbt8|ibuddy|malloc|tlsf|all]"
+               " [lazy threshold]"
+            << std::endl;
+}
+
+// Count of a hardware event per operation, empty if it was not counted
+static std::string per_op(const PerfSample &perf, PerfEvent event,
+                          uint64_t ops) {
+  if (perf.counts[event] < 0) {
+    return "";
+  }
+  return std::to_string(perf.counts[event] / static_cast<double>(ops));
+}
+
+static void add_row(ResultsFile &results, const char *allocator,
+                    unsigned int threads, uint64_t ops, double seconds,
+                    uint64_t failed, const PerfSample &perf,
+                    const std::string &p50, const std::string &p99,
+                    const std::string &p999, const std::string &max) {
+  results.row(allocator, threads, ops, seconds,
+              seconds * 1e9 / static_cast<double>(ops), failed, p50, p99, p999,
+              max,
+              per_op(perf, Cycles, ops), per_op(perf, Instructions, ops),
+              per_op(perf, L1DMisses, ops), per_op(perf, LLCMisses, ops),
+              per_op(perf, DTLBMisses, ops), per_op(perf, BranchMisses, ops));
+}
+
+// Replays a binary trace from trace_convert on a ZGC sized allocator. With
+// more than one thread the trace is split into one stream per thread, see
+// replay_threads.hpp.
+int main(int argc, char **argv) {
+  unsigned int threads = 1;
+  uint64_t sync_interval = 0;
+  unsigned int cross_percent = 0;
+  std::string output;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:s:x:o:")) != -1) {
+    switch (opt) {
+    case 't':
+      threads = std::atoi(optarg);
+      break;
+    case 's':
+      sync_interval = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'x':
+      cross_percent = std::atoi(optarg);
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || argc - optind > 3 || threads == 0 ||
+      cross_percent > 100) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  TraceFile trace;
+  if (!trace.open(argv[optind])) {
+    return 1;
+  }
+
+  const char *name = argc - optind > 1 ? argv[optind + 1] : "bt";
+  const int lazy_threshold =
+      argc - optind > 2 ? std::atoi(argv[optind + 2]) : 0;
+  const bool all = std::strcmp(name, "all") == 0;
+
+  ResultsFile results(argc, argv);
+  results.set("trace", argv[optind]);
+  results.set("config", "z");
+  results.set("lazy", lazy_threshold);
+  results.set("sync_interval", sync_interval);
+  results.set("cross_percent", cross_percent);
+  if (!output.empty() &&
+      !results.open(output,
+                    {"allocator", "threads", "ops", "seconds", "ns_per_op",
+                     "failed", "p50_ns", "p99_ns", "p999_ns", "max_ns",
+                     "cycles_per_op", "instructions_per_op",
+                     "l1d_misses_per_op", "llc_misses_per_op",
+                     "dtlb_misses_per_op", "branch_misses_per_op"})) {
+    return 1;
+  }
+
+  PerfCounters counters;
+  if (!counters.available()) {
+    std::cerr << "Hardware counters unavailable, measuring time only"
+              << std::endl;
+  }
+
+  for (const char *allocator_name : allocatorNames) {
+    if (!all && std::strcmp(name, allocator_name) != 0) {
+      continue;
+    }
+
+    const auto replay = [&](auto *allocator) {
+      if (threads == 1 && sync_interval == 0 && cross_percent == 0) {
+        const ReplayResult result = replay_trace(allocator, trace, &counters);
+        std::cout << allocator_name << ": replayed " << result.ops
+                  << " operations in " << result.seconds << " s, "
+                  << result.seconds * 1e9 / static_cast<double>(result.ops)
+                  << " ns/op, " << result.failed << " failed allocations"
+                  << std::endl;
+        result.perf.print(std::cout, result.ops);
+        add_row(results, allocator_name, threads, result.ops, result.seconds,
+                result.failed, result.perf, "", "", "", "");
+      } else {
+        const ThreadedReplayResult result =
+            replay_trace_threads(allocator, trace, threads, sync_interval,
+                                 cross_percent, &counters);
+        std::cout << allocator_name << ": replayed " << result.ops
+                  << " operations on " << threads << " threads in "
+                  << result.seconds << " s, "
+                  << static_cast<double>(result.ops) / result.seconds
+                  << " ops/s, latency p50 " << result.percentile(50)
+                  << " ns, p99 " << result.percentile(99) << " ns, p99.9 "
+                  << result.percentile(99.9) << " ns, max "
+                  << result.percentile(100) << " ns, " << result.failed
+                  << " failed allocations" << std::endl;
+        result.perf.print(std::cout, result.ops);
+        add_row(results, allocator_name, threads, result.ops, result.seconds,
+                result.failed, result.perf,
+                std::to_string(result.percentile(50)),
+                std::to_string(result.percentile(99)),
+                std::to_string(result.percentile(99.9)),
+                std::to_string(result.percentile(100)));
+      }
+    };
+    if (!with_allocator<ZConfig>(allocator_name, lazy_threshold, replay)) {
+      return 1;
+    }
+    if (!all) {
+      return results.close() ? 0 : 1;
+    }
+  }
+
+  if (!all) {
+    std::cerr << "Unknown allocator: " << name << std::endl;
+    return 1;
+  }
+  return results.close() ? 0 : 1;
+}
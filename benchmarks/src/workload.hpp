@@ -0,0 +1,162 @@
+#ifndef WORKLOAD_HPP_
+#define WORKLOAD_HPP_
+
+#include "size_dist.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// How many allocations an object outlives, given as a spec:
+//   none                    objects live until the end
+//   exp:mean                exponentially distributed with the given mean
+//   gen:young:short:long    young percent of the objects die young, with
+//                           exponential lifetimes of mean short, and the
+//                           rest with mean long
+class LifetimeModel {
+public:
+  static const uint64_t forever = std::numeric_limits<uint64_t>::max();
+
+  explicit LifetimeModel(const std::string &spec) { _valid = parse(spec); }
+
+  static bool valid(const std::string &spec) {
+    return LifetimeModel(spec)._valid;
+  }
+
+  // Allocations until the object is freed, at least 1, or forever
+  uint64_t operator()(std::mt19937 &rng) {
+    if (_kind == Kind::None) {
+      return forever;
+    }
+
+    double mean = _mean;
+    if (_kind == Kind::Generational &&
+        std::uniform_real_distribution<double>(0.0, 100.0)(rng) >= _young) {
+      mean = _oldMean;
+    }
+    const double lifetime =
+        std::exponential_distribution<double>(1.0 / mean)(rng);
+    return lifetime < 1.0 ? 1 : static_cast<uint64_t>(lifetime);
+  }
+
+private:
+  enum class Kind { None, Exponential, Generational };
+
+  bool parse(const std::string &spec) {
+    std::vector<std::string> parts;
+    std::istringstream iss(spec);
+    std::string part;
+    while (std::getline(iss, part, ':')) {
+      parts.push_back(part);
+    }
+
+    if (parts.size() == 1 && parts[0] == "none") {
+      _kind = Kind::None;
+      return true;
+    } else if (parts.size() == 2 && parts[0] == "exp") {
+      _kind = Kind::Exponential;
+      _mean = std::atof(parts[1].c_str());
+      return _mean > 0.0;
+    } else if (parts.size() == 4 && parts[0] == "gen") {
+      _kind = Kind::Generational;
+      _young = std::atof(parts[1].c_str());
+      _mean = std::atof(parts[2].c_str());
+      _oldMean = std::atof(parts[3].c_str());
+      return _young >= 0.0 && _young <= 100.0 && _mean > 0.0 &&
+             _oldMean > 0.0;
+    }
+    return false;
+  }
+
+  Kind _kind = Kind::None;
+  bool _valid = false;
+  double _young = 0.0;
+  double _mean = 0.0;
+  double _oldMean = 0.0;
+};
+
+// Makes the operations of a synthetic workload: a number of allocations with
+// sizes from a size distribution, each freed once it has outlived its
+// lifetime in allocations. Objects still live at the end are freed last if
+// freeAll is set. The ids of freed objects are handed out again, so the
+// number of ids stays close to the largest number of live objects.
+class WorkloadGenerator {
+public:
+  WorkloadGenerator(const SizeDistribution &sizes,
+                    const LifetimeModel &lifetimes, uint64_t allocations,
+                    size_t maxSize, bool freeAll, unsigned int seed)
+      : _sizes(sizes), _lifetimes(lifetimes), _allocations(allocations),
+        _maxSize(maxSize), _freeAll(freeAll), _rng(seed) {}
+
+  // Fills ops with up to count next operations, returning how many, or 0
+  // once the workload is done
+  size_t generate(TraceOp *ops, size_t count) {
+    size_t made = 0;
+    while (made < count) {
+      TraceOp &op = ops[made];
+      op.thread = 0;
+      op.reserved = 0;
+      if (!_deaths.empty() && (_deaths.top().time <= _allocated ||
+                               (_allocated == _allocations && _freeAll))) {
+        op.id = _deaths.top().id;
+        op.size = 0;
+        op.type = 'f';
+        _freeIds.push_back(op.id);
+        _deaths.pop();
+      } else if (_allocated < _allocations) {
+        op.id = new_id();
+        op.size = static_cast<uint32_t>(std::min(_sizes(_rng), _maxSize));
+        op.type = 'a';
+        _allocated++;
+        const uint64_t lifetime = _lifetimes(_rng);
+        if (lifetime != LifetimeModel::forever) {
+          _deaths.push({_allocated + lifetime, op.id});
+        }
+      } else {
+        break;
+      }
+      made++;
+    }
+    return made;
+  }
+
+  uint64_t numIds() const { return _numIds; }
+
+private:
+  struct Death {
+    uint64_t time;
+    uint32_t id;
+
+    bool operator>(const Death &other) const { return time > other.time; }
+  };
+
+  uint32_t new_id() {
+    if (_freeIds.empty()) {
+      return _numIds++;
+    }
+    const uint32_t id = _freeIds.back();
+    _freeIds.pop_back();
+    return id;
+  }
+
+  SizeDistribution _sizes;
+  LifetimeModel _lifetimes;
+  const uint64_t _allocations;
+  const size_t _maxSize;
+  const bool _freeAll;
+  std::mt19937 _rng;
+  uint64_t _allocated = 0;
+  uint32_t _numIds = 0;
+  std::vector<uint32_t> _freeIds;
+  std::priority_queue<Death, std::vector<Death>, std::greater<Death>> _deaths;
+};
+
+#endif // WORKLOAD_HPP_
@@ -0,0 +1,237 @@
+#include "allocators.hpp"
+#include "size_dist.hpp"
+#include "trace.hpp"
+#include "workload.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+struct Options {
+  uint64_t allocations = 1000000;
+  std::string sizes = "poisson";
+  std::string lifetimes = "exp:1000";
+  size_t maxSize = ZConfig::maxBlockSize;
+  bool freeAll = false;
+  unsigned int seed = 1;
+  const char *output = nullptr;
+  bool text = false;
+  std::vector<std::string> allocators;
+  int lazyThreshold = 0;
+};
+
+static const size_t batchSize = 1 << 16;
+
+static WorkloadGenerator make_generator(const Options &options) {
+  return WorkloadGenerator(SizeDistribution(options.sizes),
+                           LifetimeModel(options.lifetimes),
+                           options.allocations, options.maxSize,
+                           options.freeAll, options.seed);
+}
+
+// Streams the workload into a binary trace, writing the header last once the
+// number of operations and ids is known
+static bool write_binary(const Options &options, TraceHeader &header) {
+  FILE *out = std::fopen(options.output, "wb");
+  if (out == nullptr) {
+    std::cerr << "Failed to open the file: " << options.output << std::endl;
+    return false;
+  }
+
+  WorkloadGenerator generator = make_generator(options);
+  std::vector<TraceOp> batch(batchSize);
+  std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  header.version = TRACE_VERSION;
+  bool written = std::fwrite(&header, sizeof(header), 1, out) == 1;
+
+  size_t count;
+  while (written &&
+         (count = generator.generate(batch.data(), batch.size())) > 0) {
+    written = std::fwrite(batch.data(), sizeof(TraceOp), count, out) == count;
+    header.numOps += count;
+  }
+  header.numIds = generator.numIds();
+  written = written && std::fseek(out, 0, SEEK_SET) == 0 &&
+            std::fwrite(&header, sizeof(header), 1, out) == 1;
+
+  if (std::fclose(out) != 0 || !written) {
+    std::cerr << "Failed to write the file: " << options.output << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Writes the workload as 'a <id> <size>' and 'f <id> <size>' lines, the text
+// format of trace_convert and add_frees
+static bool write_text(const Options &options, TraceHeader &header) {
+  FILE *out = std::fopen(options.output, "w");
+  if (out == nullptr) {
+    std::cerr << "Failed to open the file: " << options.output << std::endl;
+    return false;
+  }
+
+  WorkloadGenerator generator = make_generator(options);
+  std::vector<TraceOp> batch(batchSize);
+  std::vector<uint32_t> sizes;
+  bool written = true;
+
+  size_t count;
+  while (written &&
+         (count = generator.generate(batch.data(), batch.size())) > 0) {
+    sizes.resize(generator.numIds());
+    for (size_t i = 0; i < count && written; i++) {
+      const TraceOp &op = batch[i];
+      if (op.type == 'a') {
+        sizes[op.id] = op.size;
+      }
+      written = std::fprintf(out, "%c %u %u\n", op.type, op.id,
+                             sizes[op.id]) > 0;
+    }
+    header.numOps += count;
+  }
+  header.numIds = generator.numIds();
+
+  if (std::fclose(out) != 0 || !written) {
+    std::cerr << "Failed to write the file: " << options.output << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool replay(const Options &options) {
+  for (const auto &name : options.allocators) {
+    const auto run = [&](auto *allocator) {
+      WorkloadGenerator generator = make_generator(options);
+      const ReplayResult result = replay_stream(allocator, generator);
+      std::cout << name << ": replayed " << result.ops << " operations in "
+                << result.seconds << " s, "
+                << result.seconds * 1e9 / static_cast<double>(result.ops)
+                << " ns/op, " << result.failed << " failed allocations"
+                << std::endl;
+    };
+    if (!with_allocator<ZConfig>(name, options.lazyThreshold, run)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void usage(const char *program) {
+  std::cout
+      << "Usage: " << program << " [options] (-o file | -a allocators)\n"
+      << "  -n count        allocations (1000000)\n"
+      << "  -s sizes        size distribution: small, medium, large, mixed, "
+         "a fixed\n"
+      << "                  size, poisson[:mean], lognormal:mu:sigma,\n"
+      << "                  bimodal:a:b:percent or trace:<binary trace> "
+         "(poisson)\n"
+      << "  -l lifetimes    allocations an object outlives: none, exp:mean "
+         "or\n"
+      << "                  gen:young percent:young mean:old mean "
+         "(exp:1000)\n"
+      << "  -m bytes        largest size, larger sizes are cut down (262144)\n"
+      << "  -F              free the objects still live at the end\n"
+      << "  -S seed         random seed (1)\n"
+      << "  -o file         write a binary trace\n"
+      << "  -T              write a text trace instead\n"
+      << "  -a allocators   replay on ZGC sized allocators instead, comma "
+         "separated,\n"
+      << "                  or all\n"
+      << "  -L threshold    lazy threshold of the replay (0)" << std::endl;
+}
+
+// Generates synthetic allocation workloads from a size distribution and a
+// lifetime model. The operations are made in batches and either written to a
+// trace file as they are made or replayed straight on the allocators, so
+// workloads of hundreds of millions of operations need no memory for the
+// whole trace. The same options and seed give the same workload.
+int main(int argc, char **argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:l:m:FS:o:Ta:L:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      options.allocations = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 's':
+      if (!SizeDistribution::valid(optarg)) {
+        std::cerr << "Invalid size distribution: " << optarg << std::endl;
+        return 1;
+      }
+      options.sizes = optarg;
+      break;
+    case 'l':
+      if (!LifetimeModel::valid(optarg)) {
+        std::cerr << "Invalid lifetime model: " << optarg << std::endl;
+        return 1;
+      }
+      options.lifetimes = optarg;
+      break;
+    case 'm':
+      options.maxSize = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'F':
+      options.freeAll = true;
+      break;
+    case 'S':
+      options.seed = std::strtoul(optarg, nullptr, 10);
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    case 'T':
+      options.text = true;
+      break;
+    case 'a': {
+      std::istringstream iss(optarg);
+      std::string name;
+      options.allocators.clear();
+      while (std::getline(iss, name, ',')) {
+        if (name == "all") {
+          options.allocators.insert(options.allocators.end(), allocatorNames,
+                                    allocatorNames + numAllocatorNames);
+        } else if (!name.empty()) {
+          options.allocators.push_back(name);
+        }
+      }
+      break;
+    }
+    case 'L':
+      options.lazyThreshold = std::atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || options.maxSize == 0 ||
+      (options.output == nullptr) == options.allocators.empty() ||
+      (options.text && options.output == nullptr)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (!options.allocators.empty()) {
+    return replay(options) ? 0 : 1;
+  }
+
+  TraceHeader header = {};
+  const auto start_time = std::chrono::steady_clock::now();
+  if (!(options.text ? write_text(options, header)
+                     : write_binary(options, header))) {
+    return 1;
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start_time)
+                             .count();
+  std::cout << "Generated " << header.numOps << " operations on "
+            << header.numIds << " ids in " << seconds << " s" << std::endl;
+  return 0;
+}
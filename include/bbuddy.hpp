@@ -22,6 +22,8 @@ protected:
   void *allocate_internal(size_t size) override;
   void deallocate_internal(void *ptr, size_t size) override;
   void init_bitmaps(bool startFull) override;
+  bool block_is_free(uintptr_t ptr, uint8_t region, uint8_t level) override;
+  bool block_is_used(uintptr_t ptr, uint8_t region, uint8_t level) override;
 
 private:
   void init_free_lists();
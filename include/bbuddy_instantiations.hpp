@@ -9,5 +9,25 @@ template class BinaryBuddyAllocator<SmallSingleConfig>;
 template class BinaryBuddyAllocator<SmallDoubleConfig>;
 template class BinaryBuddyAllocator<LargeQuadConfig>;
 template class BinaryBuddyAllocator<MallocConfig>;
+template class BinaryBuddyAllocator<StatsConfig>;
+template class BinaryBuddyAllocator<ZStatsConfig>;
+template class BinaryBuddyAllocator<TuneConfig<1, false, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<1, true, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<1, true, 8>>;
+template class BinaryBuddyAllocator<TuneConfig<2, false, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<2, true, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<2, true, 8>>;
+template class BinaryBuddyAllocator<TuneConfig<4, false, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<4, true, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<4, true, 4>>;
+template class BinaryBuddyAllocator<TuneConfig<4, true, 8>>;
+template class BinaryBuddyAllocator<TuneConfig<8, false, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<8, true, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<8, true, 4>>;
+template class BinaryBuddyAllocator<TuneConfig<8, true, 8>>;
+template class BinaryBuddyAllocator<TuneConfig<16, false, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<16, true, 0>>;
+template class BinaryBuddyAllocator<TuneConfig<16, true, 4>>;
+template class BinaryBuddyAllocator<TuneConfig<16, true, 8>>;
 
 #endif // BBUDDY_INSTANTIATIONS_HPP_
\ No newline at end of file
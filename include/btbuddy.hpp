@@ -7,7 +7,9 @@
 #include <cstddef>
 #include <cstdint>
 
-template <typename Config>
+// With BlockedLayout the byte-sized levels of the tree are stored as cache line
+// sized subtrees, a one-level van Emde Boas layout, instead of breadth-first
+template <typename Config, bool BlockedLayout = false>
 class BTBuddyAllocator : public BuddyAllocator<Config> {
 public:
   BTBuddyAllocator(void *start, int lazyThreshold, bool startFull);
@@ -18,24 +20,42 @@ public:
   static BTBuddyAllocator *create(void *addr, void *start,
                                       int lazyThreshold, bool startFull);
 
-  // void deallocate_range(void *ptr, size_t size) override;
+  void deallocate_range(void *ptr, size_t size) override;
 
+  size_t largest_free_block(uint8_t region) override;
+  void free_block_histogram(uint8_t region, unsigned int *counts) override;
   void print_free_list() override;
 
+  // Defined by the tests to check the tree layout
+  template <typename Allocator> friend struct TreeLayoutAccess;
+
 protected:
   void *allocate_internal(size_t size) override;
   void deallocate_internal(void *ptr, size_t size) override;
   void init_bitmaps(bool startFull) override;
+  bool block_is_free(uintptr_t ptr, uint8_t region, uint8_t level) override;
+  bool block_is_used(uintptr_t ptr, uint8_t region, uint8_t level) override;
 
 private:
   void init_free_lists();
   uint8_t tree_height(size_t size);
+  void reset_subtree(uint8_t region, unsigned int index, uint8_t level);
+  void deallocate_locked(void *ptr, size_t size);
+  // Byte offset of a node of a byte-sized level within the tree of a region
+  unsigned int tree_offset(unsigned int index, uint8_t level);
   void set_tree(uint8_t region, unsigned int index, unsigned char value);
   unsigned char get_tree(uint8_t region, unsigned int index);
   
-  unsigned char _btTree[Config::numRegions][1U << Config::numLevels];
+  alignas(64) unsigned char
+      _btTree[Config::numRegions][1U << Config::numLevels];
   unsigned char _btBits[Config::numLevels] = {8};
   unsigned int _levelOffsets[Config::numLevels] = {0};
+
+  // Height of the subtrees that fill one cache line in the blocked layout
+  static const uint8_t blockHeight = 6;
+  uint8_t _blockDepths[Config::numLevels] = {0};
+  uint8_t _blockShifts[Config::numLevels] = {0};
+  unsigned int _blockOffsets[Config::numLevels] = {0};
 };
 
 #endif // BTBUDDY_HPP
\ No newline at end of file
@@ -9,5 +9,51 @@ template class BTBuddyAllocator<SmallSingleConfig>;
 template class BTBuddyAllocator<SmallDoubleConfig>;
 template class BTBuddyAllocator<LargeQuadConfig>;
 template class BTBuddyAllocator<MallocConfig>;
+template class BTBuddyAllocator<StatsConfig>;
+template class BTBuddyAllocator<ZStatsConfig>;
+template class BTBuddyAllocator<TuneConfig<1, false, 0>>;
+template class BTBuddyAllocator<TuneConfig<1, true, 0>>;
+template class BTBuddyAllocator<TuneConfig<1, true, 8>>;
+template class BTBuddyAllocator<TuneConfig<2, false, 0>>;
+template class BTBuddyAllocator<TuneConfig<2, true, 0>>;
+template class BTBuddyAllocator<TuneConfig<2, true, 8>>;
+template class BTBuddyAllocator<TuneConfig<4, false, 0>>;
+template class BTBuddyAllocator<TuneConfig<4, true, 0>>;
+template class BTBuddyAllocator<TuneConfig<4, true, 4>>;
+template class BTBuddyAllocator<TuneConfig<4, true, 8>>;
+template class BTBuddyAllocator<TuneConfig<8, false, 0>>;
+template class BTBuddyAllocator<TuneConfig<8, true, 0>>;
+template class BTBuddyAllocator<TuneConfig<8, true, 4>>;
+template class BTBuddyAllocator<TuneConfig<8, true, 8>>;
+template class BTBuddyAllocator<TuneConfig<16, false, 0>>;
+template class BTBuddyAllocator<TuneConfig<16, true, 0>>;
+template class BTBuddyAllocator<TuneConfig<16, true, 4>>;
+template class BTBuddyAllocator<TuneConfig<16, true, 8>>;
+
+template class BTBuddyAllocator<ZConfig, true>;
+template class BTBuddyAllocator<SmallSingleConfig, true>;
+template class BTBuddyAllocator<SmallDoubleConfig, true>;
+template class BTBuddyAllocator<LargeQuadConfig, true>;
+template class BTBuddyAllocator<MallocConfig, true>;
+template class BTBuddyAllocator<StatsConfig, true>;
+template class BTBuddyAllocator<ZStatsConfig, true>;
+template class BTBuddyAllocator<TuneConfig<1, false, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<1, true, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<1, true, 8>, true>;
+template class BTBuddyAllocator<TuneConfig<2, false, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<2, true, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<2, true, 8>, true>;
+template class BTBuddyAllocator<TuneConfig<4, false, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<4, true, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<4, true, 4>, true>;
+template class BTBuddyAllocator<TuneConfig<4, true, 8>, true>;
+template class BTBuddyAllocator<TuneConfig<8, false, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<8, true, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<8, true, 4>, true>;
+template class BTBuddyAllocator<TuneConfig<8, true, 8>, true>;
+template class BTBuddyAllocator<TuneConfig<16, false, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<16, true, 0>, true>;
+template class BTBuddyAllocator<TuneConfig<16, true, 4>, true>;
+template class BTBuddyAllocator<TuneConfig<16, true, 8>, true>;
 
 #endif // BTBUDDY_INSTANTIATIONS_HPP_
\ No newline at end of file
@@ -4,14 +4,37 @@
 // Include necessary headers
 #include "buddy_config.hpp"
 #include "buddy_helper.hpp"
+#include "buddy_stats.hpp"
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <mutex>
 
+// Region selection policy of the free list based allocators
+enum class Placement {
+  // Use the first region in scan order with a large enough free block
+  FirstFit,
+  // Use the region whose fitting free block is the tightest fit
+  BestFit
+};
+
+// A wholly allocated buddy block whose relocation lets the free space around
+// it coalesce. Binary and IBuddy with a split bitmap (a size map of 0 size
+// bits) report single allocations. Otherwise the block can hold several
+// allocations, which all have to be relocated to free it.
+struct EvacuationCandidate {
+  void *block;
+  // Bytes that have to be relocated
+  size_t size;
+  // Size of the free block formed once the block is relocated
+  size_t freeSize;
+};
+
 // Define the BuddyAllocator class
 
 template <typename Config> class BuddyAllocator {
+  static_assert(Config::numLevels <= 32, "Free level masks hold 32 levels");
+
 public:
   // Constructor
   BuddyAllocator(void *start, int lazyThreshold, bool startFull);
@@ -29,6 +52,16 @@ public:
   virtual void deallocate_range(void *ptr, size_t size);
   void empty_lazy_list();
   void fill();
+  void set_placement(Placement placement);
+  size_t evacuation_candidates(void *ptr, size_t size,
+                               EvacuationCandidate *candidates,
+                               size_t maxCandidates);
+  virtual size_t largest_free_block(uint8_t region);
+  virtual void free_block_histogram(uint8_t region, unsigned int *counts);
+  double fragmentation();
+  BuddyStats stats();
+  void reset_stats();
+  void print_stats();
 
   virtual void print_free_list();
   void print_bitmaps();
@@ -54,16 +87,31 @@ protected:
                   uint8_t level_end);
   void set_level(uintptr_t ptr, uint8_t region, uint8_t level);
   uint8_t find_smallest_block_level(size_t size);
+  uint8_t level_alignment(uintptr_t ptr, uint8_t region, uint8_t start_level);
   void push_free_list(uintptr_t ptr, uint8_t region, uint8_t level);
   bool free_list_empty(uint8_t region, uint8_t level);
   uintptr_t pop_free_list(uint8_t region, uint8_t level);
+  void remove_free_list(uintptr_t ptr, uint8_t region, uint8_t level);
+  virtual uint8_t fit_level(uint8_t region, uint8_t level);
+  int best_fit_region(uint8_t level);
+  virtual bool block_is_free(uintptr_t ptr, uint8_t region, uint8_t level);
+  virtual bool block_is_used(uintptr_t ptr, uint8_t region, uint8_t level);
+  double_link *free_list_head(uint8_t region, uint8_t level);
+  bool free_list_contains(uint8_t region, uint8_t level, uintptr_t block);
+  void count_free_blocks(uintptr_t block, uint8_t region, uint8_t level,
+                         unsigned int *counts);
+  void lock_region(uint8_t region);
 
   void set_split_block(uint8_t region, unsigned int blockIndex, bool split);
+  void clear_split_blocks(uint8_t region, unsigned int blockIndex,
+                          unsigned int count);
   void set_allocated_block(uint8_t region, unsigned int blockIndex,
                            bool allocated);
   void flip_allocated_block(uint8_t region, unsigned int blockIndex);
   bool block_is_split(uint8_t region, unsigned int blockIndex);
   bool block_is_allocated(uint8_t region, unsigned int blockIndex);
+  bool any_block_allocated(uint8_t region, unsigned int blockIndex,
+                           unsigned int count);
 
   virtual void init_bitmaps(bool startFull) = 0;
   virtual void *allocate_internal(size_t size) = 0;
@@ -85,6 +133,13 @@ protected:
 
   std::mutex _regionMutexes[Config::numRegions];
 
+  Placement _placement = Placement::FirstFit;
+
+  // Mask of the non-empty free lists, readable without the region lock
+  std::atomic<uint32_t> _freeLevels[Config::numRegions];
+
+  StatsCounters<Config::collectStats, Config::numLevels> _stats;
+
 private:
   // Bitmap of either split blocks or allocated block sizes
   unsigned char _sizeMap[Config::numRegions][Config::sizeBitmapSize];
@@ -97,6 +152,7 @@ private:
 
   // Array of free lists for each block size
   double_link _freeList[Config::numRegions][Config::numLevels];
+  unsigned int _freeCounts[Config::numRegions][Config::numLevels];
   // Private member variables
 
   int _lazyThresholds[Config::numLevels] = {0};
@@ -105,8 +161,12 @@ private:
   std::mutex _lazyMutexes[Config::numLevels];
 
   // Private member functions
-  uint8_t level_alignment(uintptr_t ptr, uint8_t region, uint8_t start_level);
   void init_lazy_lists(int lazyThreshold);
+  void count_free_block(uint8_t region, uint8_t level, bool added);
+  void find_candidates(uintptr_t block, uint8_t region, uint8_t level,
+                       uintptr_t start, uintptr_t end,
+                       EvacuationCandidate *candidates, size_t maxCandidates,
+                       size_t &found);
 };
 
 #endif // BUDDY_ALLOCATOR_HPP
@@ -4,7 +4,8 @@
 #include <cstddef>
 
 template <unsigned int MIN_BLOCK_SIZE_LOG2, unsigned int MAX_BLOCK_SIZE_LOG2,
-          int NUM_REGIONS, bool USE_SIZEMAP, size_t SIZE_BITS>
+          int NUM_REGIONS, bool USE_SIZEMAP, size_t SIZE_BITS,
+          bool COLLECT_STATS = false>
 struct BuddyConfig {
   static const size_t minBlockSizeLog2 = MIN_BLOCK_SIZE_LOG2;
   static const size_t maxBlockSizeLog2 = MAX_BLOCK_SIZE_LOG2;
@@ -20,6 +21,8 @@ struct BuddyConfig {
       !USE_SIZEMAP       ? 0
       : (SIZE_BITS == 0) ? (1U << (numLevels - 1U)) / 8
                          : SIZE_BITS * maxBlockSize / minBlockSize / 8;
+  // Count operations, see buddy_stats.hpp
+  static const bool collectStats = COLLECT_STATS;
 };
 
 using ZConfig = BuddyConfig<4, 18, 8, false, 4>;
@@ -27,7 +30,28 @@ using ZConfig = BuddyConfig<4, 18, 8, false, 4>;
 using SmallSingleConfig = BuddyConfig<4, 8, 1, true, 0>;
 using SmallDoubleConfig = BuddyConfig<4, 8, 2, true, 4>;
 using LargeQuadConfig = BuddyConfig<4, 21, 4, true, 0>;
+using StatsConfig = BuddyConfig<4, 8, 1, true, 0, true>;
+// ZConfig with counters, for the contention benchmarks
+using ZStatsConfig = BuddyConfig<4, 18, 8, false, 4, true>;
+// Largest block of a 2 MiB heap split evenly over the regions
+constexpr unsigned int tune_max_block_size_log2(int numRegions) {
+  return numRegions <= 1 ? 21 : tune_max_block_size_log2(numRegions / 2) - 1;
+}
+// Configs searched by the autotuner and the scalability benchmark, a ZGC
+// sized 2 MiB heap over 1, 2, 4, 8 or 16 regions. They are instantiated
+// without a size map as TuneConfig<R, false, 0> and with 0, 4 and 8 size
+// bits, except 4 size bits for 1 and 2 regions, which have more levels than 4
+// bits hold.
+template <int NUM_REGIONS, bool USE_SIZEMAP, size_t SIZE_BITS>
+using TuneConfig =
+    BuddyConfig<4, tune_max_block_size_log2(NUM_REGIONS), NUM_REGIONS,
+                USE_SIZEMAP, SIZE_BITS>;
+// Build with -DBUDDY_STATS to count operations in the malloc shims
+#ifdef BUDDY_STATS
+using MallocConfig = BuddyConfig<4, 26, 16, true, 0, true>;
+#else
 using MallocConfig = BuddyConfig<4, 26, 16, true, 0>;
+#endif
 // using MallocConfig = BuddyConfig<4, 22, 16, true, 0>;
 
 #endif // BUDDY_CONFIG_HPP_
\ No newline at end of file
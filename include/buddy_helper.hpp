@@ -1,6 +1,7 @@
 #ifndef BUDDY_HELPER_HPP
 #define BUDDY_HELPER_HPP
 #include <cstddef>
+#include <cstring>
 
 struct double_link {
   double_link *prev;
@@ -52,6 +53,46 @@ public:
     bitmap[index / 8] &= ~(1U << (static_cast<unsigned int>(index) % 8));
   }
 
+  static void clear_bits(unsigned char *bitmap, unsigned int index,
+                         unsigned int count) {
+    const unsigned int end = index + count;
+    while (index < end && index % 8 != 0) {
+      clear_bit(bitmap, index++);
+    }
+
+    if (end - index >= 8) {
+      memset(&bitmap[index / 8], 0, (end - index) / 8);
+      index += (end - index) & ~7U;
+    }
+
+    while (index < end) {
+      clear_bit(bitmap, index++);
+    }
+  }
+
+  static bool any_bit_set(const unsigned char *bitmap, unsigned int index,
+                          unsigned int count) {
+    const unsigned int end = index + count;
+    while (index < end && index % 8 != 0) {
+      if (bit_is_set(bitmap, index++)) {
+        return true;
+      }
+    }
+
+    for (; end - index >= 8; index += 8) {
+      if (bitmap[index / 8] != 0) {
+        return true;
+      }
+    }
+
+    while (index < end) {
+      if (bit_is_set(bitmap, index++)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   static void flip_bit(unsigned char *bitmap, int index) {
     bitmap[index / 8] ^= (1U << (static_cast<unsigned int>(index) % 8));
   }
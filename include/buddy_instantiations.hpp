@@ -9,5 +9,25 @@ template class BuddyAllocator<SmallSingleConfig>;
 template class BuddyAllocator<SmallDoubleConfig>;
 template class BuddyAllocator<LargeQuadConfig>;
 template class BuddyAllocator<MallocConfig>;
+template class BuddyAllocator<StatsConfig>;
+template class BuddyAllocator<ZStatsConfig>;
+template class BuddyAllocator<TuneConfig<1, false, 0>>;
+template class BuddyAllocator<TuneConfig<1, true, 0>>;
+template class BuddyAllocator<TuneConfig<1, true, 8>>;
+template class BuddyAllocator<TuneConfig<2, false, 0>>;
+template class BuddyAllocator<TuneConfig<2, true, 0>>;
+template class BuddyAllocator<TuneConfig<2, true, 8>>;
+template class BuddyAllocator<TuneConfig<4, false, 0>>;
+template class BuddyAllocator<TuneConfig<4, true, 0>>;
+template class BuddyAllocator<TuneConfig<4, true, 4>>;
+template class BuddyAllocator<TuneConfig<4, true, 8>>;
+template class BuddyAllocator<TuneConfig<8, false, 0>>;
+template class BuddyAllocator<TuneConfig<8, true, 0>>;
+template class BuddyAllocator<TuneConfig<8, true, 4>>;
+template class BuddyAllocator<TuneConfig<8, true, 8>>;
+template class BuddyAllocator<TuneConfig<16, false, 0>>;
+template class BuddyAllocator<TuneConfig<16, true, 0>>;
+template class BuddyAllocator<TuneConfig<16, true, 4>>;
+template class BuddyAllocator<TuneConfig<16, true, 8>>;
 
 #endif // BUDDY_INSTANTIATIONS_HPP_
@@ -0,0 +1,142 @@
+#ifndef BUDDY_STATS_HPP
+#define BUDDY_STATS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Totals of the operation counters of an allocator
+struct BuddyStats {
+  // Allocations and frees of each level, including the lazy lists
+  uint64_t allocs[32] = {0};
+  uint64_t frees[32] = {0};
+  // Allocations served from a lazy list, and those of a lazy level that were
+  // not
+  uint64_t lazyHits = 0;
+  uint64_t lazyMisses = 0;
+  // Frees kept in a lazy list
+  uint64_t lazyFrees = 0;
+  // Free blocks split in halves, and buddies merged back together
+  uint64_t splits = 0;
+  uint64_t merges = 0;
+  // Regions skipped in the first scan because another thread held them
+  uint64_t scanRetries = 0;
+  // Frees that waited for another thread holding the region, and lazy list
+  // operations that found another thread holding the list
+  uint64_t regionWaits = 0;
+  uint64_t lazyWaits = 0;
+  // Allocations that did not find a free block
+  uint64_t failures = 0;
+
+  void print(std::ostream &out, unsigned int numLevels,
+             size_t maxBlockSize) const {
+    for (unsigned int i = 0; i < numLevels; i++) {
+      out << "Level " << i << "(" << (maxBlockSize >> i) << "): " << allocs[i]
+          << " allocs, " << frees[i] << " frees" << std::endl;
+    }
+    out << "Lazy hits: " << lazyHits << ", misses: " << lazyMisses
+        << ", frees: " << lazyFrees << std::endl;
+    out << "Splits: " << splits << ", merges: " << merges << std::endl;
+    out << "Scan retries: " << scanRetries << ", failures: " << failures
+        << std::endl;
+    out << "Region waits: " << regionWaits << ", lazy waits: " << lazyWaits
+        << std::endl;
+  }
+};
+
+enum class Stat {
+  LazyHit,
+  LazyMiss,
+  LazyFree,
+  Split,
+  Merge,
+  ScanRetry,
+  RegionWait,
+  LazyWait,
+  Failure,
+  Count
+};
+
+// Operation counters of an allocator. When disabled every call is empty and
+// compiles away.
+template <bool Enabled, unsigned int NumLevels> class StatsCounters {
+public:
+  void count(Stat /*stat*/, uint64_t /*n*/ = 1) {}
+  void count_alloc(uint8_t /*level*/) {}
+  void count_free(uint8_t /*level*/) {}
+  void collect(BuddyStats & /*stats*/) {}
+  void reset() {}
+};
+
+// Each thread counts into its own cache lines, which are only summed when the
+// totals are read. Threads beyond the number of slots share them.
+template <unsigned int NumLevels> class StatsCounters<true, NumLevels> {
+public:
+  void count(Stat stat, uint64_t n = 1) {
+    slot().events[static_cast<int>(stat)].fetch_add(n,
+                                                    std::memory_order_relaxed);
+  }
+
+  void count_alloc(uint8_t level) {
+    slot().allocs[level].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void count_free(uint8_t level) {
+    slot().frees[level].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void collect(BuddyStats &stats) {
+    for (const auto &s : _slots) {
+      for (unsigned int i = 0; i < NumLevels; i++) {
+        stats.allocs[i] += s.allocs[i].load(std::memory_order_relaxed);
+        stats.frees[i] += s.frees[i].load(std::memory_order_relaxed);
+      }
+      stats.lazyHits += load(s, Stat::LazyHit);
+      stats.lazyMisses += load(s, Stat::LazyMiss);
+      stats.lazyFrees += load(s, Stat::LazyFree);
+      stats.splits += load(s, Stat::Split);
+      stats.merges += load(s, Stat::Merge);
+      stats.scanRetries += load(s, Stat::ScanRetry);
+      stats.regionWaits += load(s, Stat::RegionWait);
+      stats.lazyWaits += load(s, Stat::LazyWait);
+      stats.failures += load(s, Stat::Failure);
+    }
+  }
+
+  void reset() {
+    for (auto &s : _slots) {
+      for (unsigned int i = 0; i < NumLevels; i++) {
+        s.allocs[i].store(0, std::memory_order_relaxed);
+        s.frees[i].store(0, std::memory_order_relaxed);
+      }
+      for (auto &event : s.events) {
+        event.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  static const unsigned int numSlots = 64;
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> allocs[NumLevels];
+    std::atomic<uint64_t> frees[NumLevels];
+    std::atomic<uint64_t> events[static_cast<int>(Stat::Count)];
+  };
+
+  Slot &slot() {
+    static std::atomic<unsigned int> nextSlot{0};
+    static thread_local unsigned int index =
+        nextSlot.fetch_add(1, std::memory_order_relaxed) % numSlots;
+    return _slots[index];
+  }
+
+  static uint64_t load(const Slot &s, Stat stat) {
+    return s.events[static_cast<int>(stat)].load(std::memory_order_relaxed);
+  }
+
+  Slot _slots[numSlots] = {};
+};
+
+#endif // BUDDY_STATS_HPP
@@ -19,15 +19,27 @@ public:
                                  bool startFull);
 
   void deallocate_range(void *ptr, size_t size) override;
+  void free_block_histogram(uint8_t region, unsigned int *counts) override;
 
 protected:
   void *allocate_internal(size_t size) override;
   void deallocate_internal(void *ptr, size_t size) override;
   void init_bitmaps(bool startFull) override;
+  uint8_t fit_level(uint8_t region, uint8_t level) override;
+  bool block_is_free(uintptr_t ptr, uint8_t region, uint8_t level) override;
+  bool block_is_used(uintptr_t ptr, uint8_t region, uint8_t level) override;
 
 private:
   void init_free_lists();
-  void deallocate_single(uintptr_t ptr);
+  void deallocate_block(uintptr_t ptr, uint8_t level);
+  void collapse_block(uintptr_t ptr, uint8_t region, uint8_t level);
+  uint8_t covered_level(uintptr_t ptr, uint8_t region, uint8_t level);
+
+  void set_covered_block(uint8_t region, unsigned int blockIndex, bool covered);
+  bool block_is_covered(uint8_t region, unsigned int blockIndex);
+
+  // Bitmap of free blocks whose interior is not present in the free lists
+  unsigned char _coveredBlocks[Config::numRegions][Config::allocedBitmapSize];
 };
 
 #endif // IBUDDY_HPP
\ No newline at end of file
@@ -9,5 +9,25 @@ template class IBuddyAllocator<SmallSingleConfig>;
 template class IBuddyAllocator<SmallDoubleConfig>;
 template class IBuddyAllocator<LargeQuadConfig>;
 template class IBuddyAllocator<MallocConfig>;
+template class IBuddyAllocator<StatsConfig>;
+template class IBuddyAllocator<ZStatsConfig>;
+template class IBuddyAllocator<TuneConfig<1, false, 0>>;
+template class IBuddyAllocator<TuneConfig<1, true, 0>>;
+template class IBuddyAllocator<TuneConfig<1, true, 8>>;
+template class IBuddyAllocator<TuneConfig<2, false, 0>>;
+template class IBuddyAllocator<TuneConfig<2, true, 0>>;
+template class IBuddyAllocator<TuneConfig<2, true, 8>>;
+template class IBuddyAllocator<TuneConfig<4, false, 0>>;
+template class IBuddyAllocator<TuneConfig<4, true, 0>>;
+template class IBuddyAllocator<TuneConfig<4, true, 4>>;
+template class IBuddyAllocator<TuneConfig<4, true, 8>>;
+template class IBuddyAllocator<TuneConfig<8, false, 0>>;
+template class IBuddyAllocator<TuneConfig<8, true, 0>>;
+template class IBuddyAllocator<TuneConfig<8, true, 4>>;
+template class IBuddyAllocator<TuneConfig<8, true, 8>>;
+template class IBuddyAllocator<TuneConfig<16, false, 0>>;
+template class IBuddyAllocator<TuneConfig<16, true, 0>>;
+template class IBuddyAllocator<TuneConfig<16, true, 4>>;
+template class IBuddyAllocator<TuneConfig<16, true, 8>>;
 
 #endif // IBUDDY_INSTANTIATIONS_HPP_
\ No newline at end of file
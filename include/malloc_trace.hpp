@@ -0,0 +1,40 @@
+#ifndef MALLOC_TRACE_HPP
+#define MALLOC_TRACE_HPP
+
+#include <cstdint>
+
+// Capture of the malloc calls of a program, written by the tracing malloc
+// library tracelib.so to <prefix>.<pid>.raw. A MallocTraceHeader is followed
+// by records in batches, one thread per batch, so the records are in time
+// order within a thread but not across threads. trace_convert orders them by
+// time and matches the frees to the allocations by address.
+
+static const char MALLOC_TRACE_MAGIC[4] = {'B', 'T', 'R', 'W'};
+static const uint32_t MALLOC_TRACE_VERSION = 1;
+
+struct MallocTraceHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t pid;
+};
+
+struct MallocTraceRecord {
+  // CLOCK_MONOTONIC nanoseconds, read after an allocation returned and before
+  // a free
+  uint64_t time;
+  // Block returned, null if the call failed, or the block freed
+  uint64_t addr;
+  // Block given to realloc
+  uint64_t oldAddr;
+  // Requested size, the product of the arguments for calloc
+  uint64_t size;
+  // Alignment of the aligned allocations
+  uint32_t alignment;
+  // Thread, numbered from 0 in order of its first call
+  uint16_t thread;
+  // 'm' malloc, 'c' calloc, 'r' realloc, 'a' aligned allocation, 'f' free
+  char call;
+  uint8_t reserved;
+};
+
+#endif // MALLOC_TRACE_HPP
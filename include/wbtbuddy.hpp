@@ -0,0 +1,59 @@
+#ifndef WBTBUDDY_HPP_
+#define WBTBUDDY_HPP_
+
+#include "buddy_allocator.hpp"
+#include "buddy_helper.hpp"
+#include "buddy_instantiations.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Buddy allocator backed by a wide binary tree. Only every log2(Fanout)-th
+// level of the binary tree is stored, so each stored node has Fanout children
+// laid out next to each other and the descent picks a child with a single
+// vector compare. Blocks are still split and merged in halves.
+template <typename Config, unsigned int Fanout = 4>
+class WBTBuddyAllocator : public BuddyAllocator<Config> {
+  static_assert(Fanout == 4 || Fanout == 8, "Fanout must be 4 or 8");
+
+public:
+  WBTBuddyAllocator(void *start, int lazyThreshold, bool startFull);
+  ~WBTBuddyAllocator() = default;
+  WBTBuddyAllocator(const WBTBuddyAllocator &) = delete;
+  WBTBuddyAllocator &operator=(const WBTBuddyAllocator &) = delete;
+
+  static WBTBuddyAllocator *create(void *addr, void *start, int lazyThreshold,
+                                   bool startFull);
+
+  size_t largest_free_block(uint8_t region) override;
+  void free_block_histogram(uint8_t region, unsigned int *counts) override;
+  void print_free_list() override;
+
+protected:
+  void *allocate_internal(size_t size) override;
+  void deallocate_internal(void *ptr, size_t size) override;
+  void init_bitmaps(bool startFull) override;
+  bool block_is_free(uintptr_t ptr, uint8_t region, uint8_t level) override;
+  bool block_is_used(uintptr_t ptr, uint8_t region, uint8_t level) override;
+
+private:
+  static const uint8_t fanoutLog2 = Fanout == 8 ? 3 : 2;
+  static const uint8_t numWideLevels = (Config::numLevels - 2) / fanoutLog2 + 2;
+
+  uint8_t wide_level(uint8_t level);
+  uint8_t child_shift(uint8_t wideLevel);
+  unsigned char *node(uint8_t region, uint8_t wideLevel, unsigned int index);
+  unsigned char *children(uint8_t region, uint8_t wideLevel,
+                          unsigned int index);
+  unsigned char merge_children(uint8_t wideLevel, const unsigned char *values);
+  void refresh_children(uint8_t region, uint8_t wideLevel, unsigned int index);
+  void update_parents(uint8_t region, uint8_t wideLevel, unsigned int index);
+
+  // Largest free block height below each stored node, one array per stored
+  // level so that siblings are contiguous
+  unsigned char _wbtTree[Config::numRegions][(1U << Config::numLevels) + Fanout];
+  // Binary tree level and array offset of each stored level
+  uint8_t _wideDepths[numWideLevels] = {0};
+  unsigned int _wideOffsets[numWideLevels] = {0};
+};
+
+#endif // WBTBUDDY_HPP_
@@ -0,0 +1,59 @@
+#ifndef WBTBUDDY_INSTANTIATIONS_HPP_
+#define WBTBUDDY_INSTANTIATIONS_HPP_
+
+#include "buddy_config.hpp"
+#include "wbtbuddy.hpp"
+
+template class WBTBuddyAllocator<ZConfig, 4>;
+template class WBTBuddyAllocator<SmallSingleConfig, 4>;
+template class WBTBuddyAllocator<SmallDoubleConfig, 4>;
+template class WBTBuddyAllocator<LargeQuadConfig, 4>;
+template class WBTBuddyAllocator<MallocConfig, 4>;
+template class WBTBuddyAllocator<StatsConfig, 4>;
+template class WBTBuddyAllocator<ZStatsConfig, 4>;
+template class WBTBuddyAllocator<TuneConfig<1, false, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<1, true, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<1, true, 8>, 4>;
+template class WBTBuddyAllocator<TuneConfig<2, false, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<2, true, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<2, true, 8>, 4>;
+template class WBTBuddyAllocator<TuneConfig<4, false, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<4, true, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<4, true, 4>, 4>;
+template class WBTBuddyAllocator<TuneConfig<4, true, 8>, 4>;
+template class WBTBuddyAllocator<TuneConfig<8, false, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<8, true, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<8, true, 4>, 4>;
+template class WBTBuddyAllocator<TuneConfig<8, true, 8>, 4>;
+template class WBTBuddyAllocator<TuneConfig<16, false, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<16, true, 0>, 4>;
+template class WBTBuddyAllocator<TuneConfig<16, true, 4>, 4>;
+template class WBTBuddyAllocator<TuneConfig<16, true, 8>, 4>;
+
+template class WBTBuddyAllocator<ZConfig, 8>;
+template class WBTBuddyAllocator<SmallSingleConfig, 8>;
+template class WBTBuddyAllocator<SmallDoubleConfig, 8>;
+template class WBTBuddyAllocator<LargeQuadConfig, 8>;
+template class WBTBuddyAllocator<MallocConfig, 8>;
+template class WBTBuddyAllocator<StatsConfig, 8>;
+template class WBTBuddyAllocator<ZStatsConfig, 8>;
+template class WBTBuddyAllocator<TuneConfig<1, false, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<1, true, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<1, true, 8>, 8>;
+template class WBTBuddyAllocator<TuneConfig<2, false, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<2, true, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<2, true, 8>, 8>;
+template class WBTBuddyAllocator<TuneConfig<4, false, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<4, true, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<4, true, 4>, 8>;
+template class WBTBuddyAllocator<TuneConfig<4, true, 8>, 8>;
+template class WBTBuddyAllocator<TuneConfig<8, false, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<8, true, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<8, true, 4>, 8>;
+template class WBTBuddyAllocator<TuneConfig<8, true, 8>, 8>;
+template class WBTBuddyAllocator<TuneConfig<16, false, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<16, true, 0>, 8>;
+template class WBTBuddyAllocator<TuneConfig<16, true, 4>, 8>;
+template class WBTBuddyAllocator<TuneConfig<16, true, 8>, 8>;
+
+#endif // WBTBUDDY_INSTANTIATIONS_HPP_
@@ -65,11 +65,20 @@ void *BinaryBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
 
   // const std::thread::id this_id = std::this_thread::get_id();
   // const std::hash<std::thread::id> hasher;
-  const size_t threadOffset = 0;
+  size_t threadOffset = 0;
   // const size_t threadOffset =
   // hasher(this_id) % BuddyAllocator<Config>::_numRegions;
   bool all_checked = true;
 
+  // Start with the region holding the tightest fitting block
+  if (BuddyAllocator<Config>::_placement == Placement::BestFit) {
+    const int best_region =
+        BuddyAllocator<Config>::best_fit_region(start_block_level);
+    if (best_region >= 0) {
+      threadOffset = best_region;
+    }
+  }
+
   for (int attempt = 0; attempt < 2; attempt++) {
     if (attempt == 1 && all_checked) {
       break;
@@ -83,6 +92,7 @@ void *BinaryBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
       if (attempt == 0 &&
           !BuddyAllocator<Config>::_regionMutexes[r].try_lock()) {
         all_checked = false;
+        BuddyAllocator<Config>::_stats.count(Stat::ScanRetry);
         continue;
       }
       if (attempt == 1) {
@@ -123,6 +133,7 @@ void *BinaryBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
             // Insert the two blocks into the free list
             BuddyAllocator<Config>::push_free_list(block, r, block_level + 1);
             BuddyAllocator<Config>::push_free_list(buddy, r, block_level + 1);
+            BuddyAllocator<Config>::_stats.count(Stat::Split);
 
             block_level = start_block_level;
           }
@@ -154,7 +165,7 @@ block_found:
   }
 
   BuddyAllocator<Config>::_freeSizes[r] -=
-      BuddyHelper::round_up_pow2(totalSize);
+      BuddyAllocator<Config>::size_of_level(block_level);
   BuddyAllocator<Config>::_regionMutexes[r].unlock();
   return reinterpret_cast<void *>(block);
 }
@@ -166,6 +177,8 @@ void BinaryBuddyAllocator<Config>::deallocate_internal(void *ptr, size_t size) {
   const uint8_t region = BuddyAllocator<Config>::get_region(block);
   uint8_t level = BuddyAllocator<Config>::get_level(block, size);
 
+  BuddyAllocator<Config>::lock_region(region);
+
   // Mark block as free
   BuddyAllocator<Config>::flip_allocated_block(
       region,
@@ -189,7 +202,8 @@ void BinaryBuddyAllocator<Config>::deallocate_internal(void *ptr, size_t size) {
     }
 
     // Remove buddy from free list
-    BuddyHelper::list_remove(reinterpret_cast<double_link *>(buddy));
+    BuddyAllocator<Config>::remove_free_list(buddy, region, level);
+    BuddyAllocator<Config>::_stats.count(Stat::Merge);
 
     // Align to the left block
     if (buddy < block) {
@@ -218,6 +232,67 @@ void BinaryBuddyAllocator<Config>::deallocate_internal(void *ptr, size_t size) {
 
   BuddyAllocator<Config>::_freeSizes[region] += size;
   BuddyAllocator<Config>::push_free_list(block, region, level);
+  BuddyAllocator<Config>::_regionMutexes[region].unlock();
+}
+
+// The allocated bit of a pair is set if exactly one of the buddies is free,
+// and the bits below a free or allocated block are clear. So only the lowest
+// ancestor with a set pair bit can be a listed free block. When neither it
+// nor its buddy is split, its free list is searched to tell them apart.
+template <typename Config>
+bool BinaryBuddyAllocator<Config>::block_is_free(uintptr_t ptr,
+                                                 uint8_t region,
+                                                 uint8_t level) {
+  uint8_t i = level;
+  while (i > 0 &&
+         !BuddyAllocator<Config>::block_is_allocated(
+             region,
+             map_index(BuddyAllocator<Config>::block_index(ptr, region, i)))) {
+    i--;
+  }
+
+  // The region is listed at level 0 only when it is entirely free
+  if (i == 0) {
+    return !BuddyAllocator<Config>::free_list_empty(region, 0);
+  }
+
+  const uintptr_t block = BuddyAllocator<Config>::align_left(ptr, i);
+  if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
+      BuddyAllocator<Config>::_sizeMapEnabled &&
+      i < BuddyAllocator<Config>::_numLevels - 1) {
+    if (BuddyAllocator<Config>::block_is_split(
+            region, BuddyAllocator<Config>::block_index(block, region, i))) {
+      return false;
+    }
+    if (BuddyAllocator<Config>::block_is_split(
+            region, BuddyAllocator<Config>::buddy_index(block, region, i))) {
+      return true;
+    }
+  }
+  return BuddyAllocator<Config>::free_list_contains(region, i, block);
+}
+
+// A block is used if it is not free and no pair below it has a free buddy.
+// The pair bits of each level below the block are consecutive. The split
+// bitmap is checked instead when kept, so that only single allocations count.
+template <typename Config>
+bool BinaryBuddyAllocator<Config>::block_is_used(uintptr_t ptr,
+                                                 uint8_t region,
+                                                 uint8_t level) {
+  if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
+      BuddyAllocator<Config>::_sizeMapEnabled) {
+    return BuddyAllocator<Config>::block_is_used(ptr, region, level);
+  }
+
+  for (uint8_t i = level + 1; i < BuddyAllocator<Config>::_numLevels; i++) {
+    if (BuddyAllocator<Config>::any_block_allocated(
+            region,
+            map_index(BuddyAllocator<Config>::block_index(ptr, region, i)),
+            1U << static_cast<unsigned int>(i - level - 1))) {
+      return false;
+    }
+  }
+  return !block_is_free(ptr, region, level);
 }
 
 template <typename Config>
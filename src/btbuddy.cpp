@@ -9,8 +9,8 @@
 #include <sys/mman.h>
 #include <thread>
 
-template <typename Config>
-void BTBuddyAllocator<Config>::init_bitmaps(bool startFull) {
+template <typename Config, bool BlockedLayout>
+void BTBuddyAllocator<Config, BlockedLayout>::init_bitmaps(bool startFull) {
   const unsigned char freeBlocksPattern = 0x0; // 0x55 = 01010101
   const unsigned char sizeMapPattern =
       startFull ? 0xFF : 0x0; // 0xFF = 11111111
@@ -35,9 +35,10 @@ void BTBuddyAllocator<Config>::init_bitmaps(bool startFull) {
   }
 }
 
-template <typename Config>
-BTBuddyAllocator<Config>::BTBuddyAllocator(void *start, int lazyThreshold,
-                                           bool startFull)
+template <typename Config, bool BlockedLayout>
+BTBuddyAllocator<Config, BlockedLayout>::BTBuddyAllocator(void *start,
+                                                      int lazyThreshold,
+                                                      bool startFull)
     : BuddyAllocator<Config>(start, lazyThreshold, startFull) {
 
   // Insert all blocks into the free lists if starting empty
@@ -66,15 +67,49 @@ BTBuddyAllocator<Config>::BTBuddyAllocator(void *start, int lazyThreshold,
   }
 
 
+  // In the blocked layout the byte-sized levels are cut into rows of subtrees
+  // of blockHeight levels, each stored breadth-first in its own cache line, so
+  // a root-to-leaf walk touches one line per blockHeight levels. The top row
+  // takes the remainder as it stays cached anyway, and is padded to a whole
+  // line so the rows below start on line boundaries.
+  if (BlockedLayout) {
+    const uint8_t byte_levels = Config::numLevels - 3;
+    uint8_t row_start = 0;
+    uint8_t row_height = byte_levels % blockHeight;
+    row_height = row_height == 0 ? blockHeight : row_height;
+    unsigned int row_offset = 0;
+
+    while (row_start < byte_levels) {
+      for (uint8_t d = 0; d < row_height; d++) {
+        _blockDepths[row_start + d] = d;
+        _blockShifts[row_start + d] = row_height;
+        _blockOffsets[row_start + d] = row_offset + (1U << d) - 1;
+      }
+      row_offset += 1U << (row_start + row_height);
+      row_start += row_height;
+      row_height = blockHeight;
+      if (row_start < byte_levels) {
+        row_offset = (row_offset + (1U << blockHeight) - 1) &
+                     ~((1U << blockHeight) - 1);
+      }
+    }
+
+    // The packed levels follow the padded rows
+    const unsigned int shift = row_offset - _levelOffsets[byte_levels];
+    for (uint8_t l = byte_levels; l < Config::numLevels; l++) {
+      _levelOffsets[l] += shift;
+    }
+  }
+
   // Initialize bitmaps
   init_bitmaps(startFull);
 }
 
 // Creates a buddy allocator at the given address
-template <typename Config>
-BTBuddyAllocator<Config> *
-BTBuddyAllocator<Config>::create(void *addr, void *start, int lazyThreshold,
-                                 bool startFull) {
+template <typename Config, bool BlockedLayout>
+BTBuddyAllocator<Config, BlockedLayout> *
+BTBuddyAllocator<Config, BlockedLayout>::create(void *addr, void *start,
+                                            int lazyThreshold, bool startFull) {
   if (addr == nullptr) {
     addr = mmap(nullptr, sizeof(BTBuddyAllocator), PROT_READ | PROT_WRITE,
                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
@@ -87,6 +122,22 @@ BTBuddyAllocator<Config>::create(void *addr, void *start, int lazyThreshold,
   return new (addr) BTBuddyAllocator(start, lazyThreshold, startFull);
 }
 
+// Returns the byte offset of a node on one of the byte-sized levels
+template <typename Config, bool BlockedLayout>
+inline unsigned int
+BTBuddyAllocator<Config, BlockedLayout>::tree_offset(unsigned int index,
+                                                     uint8_t level) {
+  if (!BlockedLayout) {
+    return index;
+  }
+
+  const unsigned int level_index =
+      index - BuddyAllocator<Config>::index_of_level(level);
+  const uint8_t depth = _blockDepths[level];
+  return _blockOffsets[level] + ((level_index >> depth) << _blockShifts[level]) +
+         (level_index & ((1U << depth) - 1));
+}
+
 // [num_bits][bit_offset]
 static unsigned char bitmask_table[4][8] = {
     {0b11111110, 0b11111101, 0b11111011, 0b11110111, 0b11101111, 0b11011111,
@@ -95,16 +146,16 @@ static unsigned char bitmask_table[4][8] = {
     {0b0, 0b0, 0b0, 0b0, 0b0, 0b0, 0b0, 0b0},
     {0b11110000, 0b0, 0b0, 0b0, 0b00001111, 0b0, 0b0, 0b0}};
 
-template <typename Config>
-inline void BTBuddyAllocator<Config>::set_tree(uint8_t region,
-                                               unsigned int index,
-                                               unsigned char value) {
+template <typename Config, bool BlockedLayout>
+inline void BTBuddyAllocator<Config, BlockedLayout>::set_tree(uint8_t region,
+                                                          unsigned int index,
+                                                          unsigned char value) {
 
   // _btTree[region][index] = value;
   // return;
   const uint8_t level = BuddyAllocator<Config>::level_of_index(index);
   if (level < BuddyAllocator<Config>::_numLevels - 3) {
-    _btTree[region][index] = value;
+    _btTree[region][tree_offset(index, level)] = value;
     return;
   }
   const unsigned int level_start =
@@ -133,14 +184,15 @@ inline void BTBuddyAllocator<Config>::set_tree(uint8_t region,
   // std::cout << std::endl;
 }
 
-template <typename Config>
-inline unsigned char BTBuddyAllocator<Config>::get_tree(uint8_t region,
-                                                        unsigned int index) {
+template <typename Config, bool BlockedLayout>
+inline unsigned char
+BTBuddyAllocator<Config, BlockedLayout>::get_tree(uint8_t region,
+                                              unsigned int index) {
 
   // return _btTree[region][index];
   const uint8_t level = BuddyAllocator<Config>::level_of_index(index);
   if (level < BuddyAllocator<Config>::_numLevels - 3) {
-    return _btTree[region][index];
+    return _btTree[region][tree_offset(index, level)];
   }
 
   const unsigned int level_start =
@@ -157,9 +209,51 @@ inline unsigned char BTBuddyAllocator<Config>::get_tree(uint8_t region,
   return (byte >> bit_offset) & (0xFF >> (8 - num_bits));
 }
 
+// A block is free if its whole height is free below it
+template <typename Config, bool BlockedLayout>
+bool BTBuddyAllocator<Config, BlockedLayout>::block_is_free(uintptr_t ptr,
+                                                           uint8_t region,
+                                                           uint8_t level) {
+  return get_tree(region, BuddyAllocator<Config>::block_index(ptr, region,
+                                                              level)) ==
+         BuddyAllocator<Config>::_numLevels - level;
+}
+
+// A block is used if no free block is left below it
+template <typename Config, bool BlockedLayout>
+bool BTBuddyAllocator<Config, BlockedLayout>::block_is_used(uintptr_t ptr,
+                                                           uint8_t region,
+                                                           uint8_t level) {
+  return get_tree(region, BuddyAllocator<Config>::block_index(ptr, region,
+                                                              level)) == 0;
+}
+
+// The root holds the height of the largest free block of the region
+template <typename Config, bool BlockedLayout>
+size_t
+BTBuddyAllocator<Config, BlockedLayout>::largest_free_block(uint8_t region) {
+  const unsigned char height = get_tree(region, 0);
+  return height == 0 ? 0
+                     : BuddyAllocator<Config>::size_of_level(
+                           BuddyAllocator<Config>::_numLevels - height);
+}
+
+template <typename Config, bool BlockedLayout>
+void BTBuddyAllocator<Config, BlockedLayout>::free_block_histogram(
+    uint8_t region, unsigned int *counts) {
+  for (uint8_t i = 0; i < BuddyAllocator<Config>::_numLevels; i++) {
+    counts[i] = 0;
+  }
+  BuddyAllocator<Config>::_regionMutexes[region].lock();
+  BuddyAllocator<Config>::count_free_blocks(
+      BuddyAllocator<Config>::region_start(region), region, 0, counts);
+  BuddyAllocator<Config>::_regionMutexes[region].unlock();
+}
+
 // Allocates a block of memory of the given size
-template <typename Config>
-void *BTBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
+template <typename Config, bool BlockedLayout>
+void *
+BTBuddyAllocator<Config, BlockedLayout>::allocate_internal(size_t totalSize) {
 
   const uint8_t block_height = tree_height(totalSize);
 
@@ -185,6 +279,7 @@ void *BTBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
       if (attempt == 0 &&
           !BuddyAllocator<Config>::_regionMutexes[r].try_lock()) {
         all_checked = false;
+        BuddyAllocator<Config>::_stats.count(Stat::ScanRetry);
         continue;
       }
       if (attempt == 1) {
@@ -245,11 +340,17 @@ void *BTBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
         // Set the parent value to the maximum of the children
         const unsigned char left_value = get_tree(r, left_child);
         const unsigned char right_value = get_tree(r, right_child);
+        const unsigned char value =
+            left_value > right_value ? left_value : right_value;
 
-        if (left_value > right_value) {
-          set_tree(r, tree_index, left_value);
-        } else {
-          set_tree(r, tree_index, right_value);
+        // An unchanged parent was already split, as are its ancestors
+        const unsigned char old_value = get_tree(r, tree_index);
+        if (old_value == value) {
+          break;
+        }
+        set_tree(r, tree_index, value);
+        if (old_value == l + 1) {
+          BuddyAllocator<Config>::_stats.count(Stat::Split);
         }
 
         if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
@@ -260,7 +361,8 @@ void *BTBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
       }
 
       BuddyAllocator<Config>::_freeSizes[r] -=
-          BuddyHelper::round_up_pow2(totalSize);
+          BuddyAllocator<Config>::size_of_level(
+              BuddyAllocator<Config>::_numLevels - block_height);
 
       BuddyAllocator<Config>::_regionMutexes[r].unlock();
       return reinterpret_cast<void *>(block);
@@ -271,8 +373,21 @@ void *BTBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
 }
 
 // Deallocates a block of memory of the given size
-template <typename Config>
-void BTBuddyAllocator<Config>::deallocate_internal(void *ptr, size_t size) {
+template <typename Config, bool BlockedLayout>
+void BTBuddyAllocator<Config, BlockedLayout>::deallocate_internal(void *ptr,
+                                                              size_t size) {
+  const uint8_t region =
+      BuddyAllocator<Config>::get_region(reinterpret_cast<uintptr_t>(ptr));
+  BuddyAllocator<Config>::lock_region(region);
+  deallocate_locked(ptr, size);
+  BuddyAllocator<Config>::_regionMutexes[region].unlock();
+}
+
+// Deallocates a block of memory of the given size, with the region lock
+// already held
+template <typename Config, bool BlockedLayout>
+void BTBuddyAllocator<Config, BlockedLayout>::deallocate_locked(void *ptr,
+                                                            size_t size) {
   auto block = reinterpret_cast<uintptr_t>(ptr);
   const uint8_t region = BuddyAllocator<Config>::get_region(block);
   uint8_t level = BuddyAllocator<Config>::get_level(block, size);
@@ -290,13 +405,23 @@ void BTBuddyAllocator<Config>::deallocate_internal(void *ptr, size_t size) {
     const unsigned char left_value = get_tree(region, 2 * block_index + 1);
     const unsigned char right_value = get_tree(region, 2 * block_index + 2);
 
-    // Set the parent value to the maximum of the children
-    if (left_value == right_value && left_value == l) {
-      set_tree(region, block_index, l + 1);
+    // Set the parent value to the maximum of the children, or merge them
+    const bool merged = left_value == right_value && left_value == l;
+    const unsigned char value =
+        merged ? l + 1 : (left_value > right_value ? left_value : right_value);
+
+    // The ancestors are unchanged once a parent keeps its value
+    if (get_tree(region, block_index) == value) {
+      break;
+    }
+    set_tree(region, block_index, value);
+
+    if (merged) {
+      BuddyAllocator<Config>::_stats.count(Stat::Merge);
+    }
+    if (merged && BuddyAllocator<Config>::_sizeMapIsBitmap &&
+        BuddyAllocator<Config>::_sizeMapEnabled) {
       BuddyAllocator<Config>::set_split_block(region, block_index, false);
-    } else {
-      set_tree(region, block_index,
-               left_value > right_value ? left_value : right_value);
     }
     block_index = (block_index - 1) / 2;
   }
@@ -304,13 +429,82 @@ void BTBuddyAllocator<Config>::deallocate_internal(void *ptr, size_t size) {
   BuddyAllocator<Config>::_freeSizes[region] += size;
 }
 
-template <typename Config>
-uint8_t BTBuddyAllocator<Config>::tree_height(size_t size) {
+// Deallocates a range of memory, split into the largest aligned blocks. The
+// nodes below a freed block still hold the values of the allocations inside
+// it, so they are reset to free before the block is freed. The region stays
+// locked in between, as the reset nodes read as free below ancestors that
+// still read as allocated.
+template <typename Config, bool BlockedLayout>
+void BTBuddyAllocator<Config, BlockedLayout>::deallocate_range(void *ptr,
+                                                           size_t size) {
+  const auto start = reinterpret_cast<uintptr_t>(ptr);
+  uintptr_t block = BuddyAllocator<Config>::align_left(
+      start + BuddyAllocator<Config>::_minSize - 1,
+      BuddyAllocator<Config>::_numLevels - 1);
+  const uintptr_t end = BuddyAllocator<Config>::align_left(
+      start + size, BuddyAllocator<Config>::_numLevels - 1);
+
+  while (block < end) {
+    const uint8_t region = BuddyAllocator<Config>::get_region(block);
+
+    // Find the largest aligned block that fits in the rest of the range
+    uint8_t level = BuddyAllocator<Config>::level_alignment(block, region, 0);
+    while (BuddyAllocator<Config>::size_of_level(level) > end - block) {
+      level++;
+    }
+    const unsigned int index =
+        BuddyAllocator<Config>::block_index(block, region, level);
+
+    BuddyAllocator<Config>::lock_region(region);
+    reset_subtree(region, index, level);
+    if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
+        BuddyAllocator<Config>::_sizeMapEnabled) {
+      for (uint8_t i = level; i < BuddyAllocator<Config>::_numLevels - 1;
+           i++) {
+        BuddyAllocator<Config>::clear_split_blocks(
+            region, BuddyAllocator<Config>::block_index(block, region, i),
+            1U << static_cast<unsigned int>(i - level));
+      }
+    } else if (BuddyAllocator<Config>::_sizeMapEnabled) {
+      BuddyAllocator<Config>::set_level(block, region, level);
+    }
+    deallocate_locked(reinterpret_cast<void *>(block),
+                      BuddyAllocator<Config>::size_of_level(level));
+    BuddyAllocator<Config>::_regionMutexes[region].unlock();
+    block += BuddyAllocator<Config>::size_of_level(level);
+  }
+}
+
+// Marks every node below a block as free. A node that already holds the
+// height of its block has a free subtree, since allocations only change the
+// allocated node and its ancestors, so only the paths down to the blocks
+// allocated inside are rewritten.
+template <typename Config, bool BlockedLayout>
+void BTBuddyAllocator<Config, BlockedLayout>::reset_subtree(
+    uint8_t region, unsigned int index, uint8_t level) {
+  const uint8_t child_level = level + 1;
+  if (child_level >= BuddyAllocator<Config>::_numLevels) {
+    return;
+  }
+
+  const unsigned char height =
+      BuddyAllocator<Config>::_numLevels - child_level;
+  for (unsigned int child = 2 * index + 1; child <= 2 * index + 2; child++) {
+    if (get_tree(region, child) != height) {
+      set_tree(region, child, height);
+      reset_subtree(region, child, child_level);
+    }
+  }
+}
+
+template <typename Config, bool BlockedLayout>
+uint8_t BTBuddyAllocator<Config, BlockedLayout>::tree_height(size_t size) {
   return BuddyAllocator<Config>::_numLevels -
          BuddyAllocator<Config>::find_smallest_block_level(size);
 }
 
-template <typename Config> void BTBuddyAllocator<Config>::print_free_list() {
+template <typename Config, bool BlockedLayout>
+void BTBuddyAllocator<Config, BlockedLayout>::print_free_list() {
   for (int r = 0; r < BuddyAllocator<Config>::_numRegions; r++) {
     std::cout << "Region " << r << " tree: " << std::endl;
     unsigned int bits_per_line = 1;
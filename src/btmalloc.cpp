@@ -10,10 +10,16 @@
 // uint8_t allocatorpool[sizeof(BinaryBuddyAllocator<MallocConfig>)];
 static BTBuddyAllocator<MallocConfig> *allocator = nullptr;
 
+// Prints the operation counters at exit in builds with -DBUDDY_STATS
+static void print_buddy_stats() { allocator->print_stats(); }
+
 extern "C" {
 void init_buddy() {
   allocator =
       BTBuddyAllocator<MallocConfig>::create(nullptr, nullptr, 31, false);
+  if (MallocConfig::collectStats) {
+    atexit(print_buddy_stats);
+  }
 }
 
 void *malloc(size_t size) {
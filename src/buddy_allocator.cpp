@@ -191,7 +191,9 @@ template <typename Config> void BuddyAllocator<Config>::init_free_lists() {
   for (int r = 0; r < Config::numRegions; r++) {
     for (int l = 0; l < Config::numLevels; l++) {
       _freeList[r][l] = {&_freeList[r][l], &_freeList[r][l]};
+      _freeCounts[r][l] = 0;
     }
+    _freeLevels[r].store(0, std::memory_order_relaxed);
   }
 }
 
@@ -265,9 +267,9 @@ BuddyAllocator<Config>::BuddyAllocator(void *start, int lazyThreshold,
                     Config::sizeBits == 8,
                 "Size bits must be 0, 4, or 8");
   static_assert(!(Config::sizeBits == 4 &&
-                  Config::maxBlockSizeLog2 - Config::minBlockSizeLog2 > 16),
+                  Config::maxBlockSizeLog2 - Config::minBlockSizeLog2 > 15),
                 "Combination of sizeBits = 4 and maxBlockSizeLog2 - "
-                "minBlockSizeLog2 > 16 is not allowed");
+                "minBlockSizeLog2 > 15 is not allowed");
 
   if (start == nullptr) {
     start = mmap(nullptr, (Config::numRegions * Config::maxBlockSize),
@@ -313,14 +315,28 @@ void *BuddyAllocator<Config>::allocate(size_t totalSize) {
     if (locked && _lazyListSize[level] > 0) {
       void *block = BuddyHelper::pop_first(&_lazyList[level]);
       _lazyListSize[level]--;
-      _freeSizes[_numRegions] -= BuddyHelper::round_up_pow2(totalSize);
+      _freeSizes[_numRegions] -= size_of_level(level);
       _lazyMutexes[level].unlock();
+      _stats.count(Stat::LazyHit);
+      _stats.count_alloc(level);
       return block;
     }
-    _lazyMutexes[level].unlock();
+    if (locked) {
+      _lazyMutexes[level].unlock();
+    } else {
+      _stats.count(Stat::LazyWait);
+    }
+  }
+  if (_lazyThresholds[level] > 0) {
+    _stats.count(Stat::LazyMiss);
   }
 
   void *p = allocate_internal(totalSize);
+  if (p == nullptr) {
+    _stats.count(Stat::Failure);
+  } else {
+    _stats.count_alloc(level);
+  }
   // if (p == nullptr) {
   // empty_lazy_list();
   // p = allocate_internal(totalSize);
@@ -342,13 +358,18 @@ void BuddyAllocator<Config>::deallocate(void *ptr, size_t size) {
   }
 
   uint8_t level = find_smallest_block_level(size);
+  _stats.count_free(level);
 
   if (_lazyListSize[level] < _lazyThresholds[level]) {
-    _lazyMutexes[level].lock();
+    if (!_lazyMutexes[level].try_lock()) {
+      _stats.count(Stat::LazyWait);
+      _lazyMutexes[level].lock();
+    }
     BuddyHelper::push_back(&_lazyList[level], static_cast<double_link *>(ptr));
     _lazyListSize[level]++;
-    _freeSizes[_numRegions] += BuddyHelper::round_up_pow2(size);
+    _freeSizes[_numRegions] += size_of_level(level);
     _lazyMutexes[level].unlock();
+    _stats.count(Stat::LazyFree);
     return;
   }
 
@@ -406,18 +427,13 @@ void BuddyAllocator<Config>::deallocate_range(void *ptr, size_t size) {
       }
 
       // Clear all smaller levels
-      for (int i = level + 1; i < BuddyAllocator<Config>::_numLevels; i++) {
-        const unsigned int start_block_idx =
-            BuddyAllocator<Config>::block_index(region_start, r, i);
-        for (unsigned int j = start_block_idx;
-             j < start_block_idx +
-                     BuddyAllocator<Config>::num_blocks(block_size, i);
-             j++) {
-          if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
-              BuddyAllocator<Config>::_sizeMapEnabled &&
-              i < BuddyAllocator<Config>::_numLevels - 1) {
-            BuddyAllocator<Config>::set_split_block(r, j, false);
-          }
+      if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
+          BuddyAllocator<Config>::_sizeMapEnabled) {
+        for (int i = level + 1; i < BuddyAllocator<Config>::_numLevels - 1;
+             i++) {
+          BuddyAllocator<Config>::clear_split_blocks(
+              r, BuddyAllocator<Config>::block_index(region_start, r, i),
+              BuddyAllocator<Config>::num_blocks(block_size, i));
         }
       }
 
@@ -462,6 +478,7 @@ void BuddyAllocator<Config>::push_free_list(uintptr_t ptr, uint8_t region,
   auto *block = reinterpret_cast<double_link *>(ptr);
   double_link *head = &_freeList[region][level];
   BuddyHelper::push_back(head, block);
+  count_free_block(region, level, true);
 }
 
 template <typename Config>
@@ -472,9 +489,318 @@ bool BuddyAllocator<Config>::free_list_empty(uint8_t region, uint8_t level) {
 template <typename Config>
 uintptr_t BuddyAllocator<Config>::pop_free_list(uint8_t region, uint8_t level) {
   double_link *block = BuddyHelper::pop_first(&_freeList[region][level]);
+  if (block != nullptr) {
+    count_free_block(region, level, false);
+  }
   return reinterpret_cast<uintptr_t>(block);
 }
 
+template <typename Config>
+void BuddyAllocator<Config>::remove_free_list(uintptr_t ptr, uint8_t region,
+                                              uint8_t level) {
+  BuddyHelper::list_remove(reinterpret_cast<double_link *>(ptr));
+  count_free_block(region, level, false);
+}
+
+// Tracks the number of blocks in a free list, updating the mask of non-empty
+// lists when it becomes empty or non-empty. Called with the region locked.
+template <typename Config>
+inline void BuddyAllocator<Config>::count_free_block(uint8_t region,
+                                                     uint8_t level,
+                                                     bool added) {
+  unsigned int &count = _freeCounts[region][level];
+  const bool changed = added ? count++ == 0 : --count == 0;
+  if (changed) {
+    _freeLevels[region].store(
+        _freeLevels[region].load(std::memory_order_relaxed) ^ (1U << level),
+        std::memory_order_relaxed);
+  }
+}
+
+// Returns the level of the free block that an allocation of the given level
+// would be taken from, or _numLevels if there is none. Defaults to the
+// smallest free block that is large enough.
+template <typename Config>
+uint8_t BuddyAllocator<Config>::fit_level(uint8_t region, uint8_t level) {
+  const uint32_t levels =
+      _freeLevels[region].load(std::memory_order_relaxed) &
+      (0xFFFFFFFFU >> (31 - level));
+  return levels == 0 ? _numLevels : 31 - __builtin_clz(levels);
+}
+
+// Returns the region with the tightest fitting free block for the given level,
+// or -1 if no region has one. The regions are not locked, so the result is
+// only a hint.
+template <typename Config>
+int BuddyAllocator<Config>::best_fit_region(uint8_t level) {
+  int best_region = -1;
+  uint8_t best_level = 0;
+  for (uint8_t r = 0; r < _numRegions; r++) {
+    const uint8_t fit = fit_level(r, level);
+    if (fit < _numLevels && (best_region < 0 || fit > best_level)) {
+      best_region = r;
+      best_level = fit;
+      if (fit == level) {
+        break;
+      }
+    }
+  }
+  return best_region;
+}
+
+template <typename Config>
+void BuddyAllocator<Config>::set_placement(Placement placement) {
+  _placement = placement;
+}
+
+// Returns true if the free list of the level holds the block
+template <typename Config>
+bool BuddyAllocator<Config>::free_list_contains(uint8_t region, uint8_t level,
+                                                uintptr_t block) {
+  double_link *head = free_list_head(region, level);
+  for (double_link *link = head->next; link != head; link = link->next) {
+    if (reinterpret_cast<uintptr_t>(link) == block) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if the whole block is free, that is if it or one of its
+// ancestors is in a free list. This searches the free lists, allocators that
+// keep free bits override it.
+template <typename Config>
+bool BuddyAllocator<Config>::block_is_free(uintptr_t ptr, uint8_t region,
+                                           uint8_t level) {
+  for (uint8_t l = 0; l <= level; l++) {
+    if (free_list_contains(region, l, align_left(ptr, l))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if the block holds no free memory. With the split bitmap a
+// block that is neither split nor free is a single allocated block. Without
+// it the free lists of the lower levels are searched for a block inside it.
+template <typename Config>
+bool BuddyAllocator<Config>::block_is_used(uintptr_t ptr, uint8_t region,
+                                           uint8_t level) {
+  if (_sizeMapIsBitmap && _sizeMapEnabled) {
+    return (level == _numLevels - 1 ||
+            !block_is_split(region, block_index(ptr, region, level))) &&
+           !block_is_free(ptr, region, level);
+  }
+
+  if (block_is_free(ptr, region, level)) {
+    return false;
+  }
+  const uintptr_t end = ptr + size_of_level(level);
+  for (uint8_t l = level + 1; l < _numLevels; l++) {
+    double_link *head = free_list_head(region, l);
+    for (double_link *link = head->next; link != head; link = link->next) {
+      const auto block = reinterpret_cast<uintptr_t>(link);
+      if (block >= ptr && block < end) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Fills candidates with the allocated blocks inside the given range whose
+// relocation unlocks the largest free block per relocated byte, best first.
+// Only blocks with a free buddy are reported, and merging stops at the end of
+// the range. Blocks in the lazy lists count as allocated. The allocators
+// answer this from their bits, except that Binary searches one free list to
+// tell a free block from an allocated buddy when neither is split. Returns
+// the number of candidates stored.
+template <typename Config>
+size_t BuddyAllocator<Config>::evacuation_candidates(
+    void *ptr, size_t size, EvacuationCandidate *candidates,
+    size_t maxCandidates) {
+  const auto start = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t end = start + size;
+  size_t found = 0;
+
+  for (uint8_t r = 0; r < _numRegions; r++) {
+    const uintptr_t root = region_start(r);
+    if (region_start(r + 1) <= start || root >= end) {
+      continue;
+    }
+
+    _regionMutexes[r].lock();
+    if (!block_is_free(root, r, 0) && !block_is_used(root, r, 0)) {
+      find_candidates(root, r, 0, start, end, candidates, maxCandidates,
+                      found);
+    }
+    _regionMutexes[r].unlock();
+  }
+
+  return found;
+}
+
+// Looks for candidates among the children of a partly allocated block,
+// descending into the children that are partly allocated as well
+template <typename Config>
+void BuddyAllocator<Config>::find_candidates(
+    uintptr_t block, uint8_t region, uint8_t level, uintptr_t start,
+    uintptr_t end, EvacuationCandidate *candidates, size_t maxCandidates,
+    size_t &found) {
+  if (level == _numLevels - 1) {
+    return;
+  }
+
+  const uint8_t child_level = level + 1;
+  const size_t child_size = size_of_level(child_level);
+  const uintptr_t children[2] = {block, block + child_size};
+  bool free[2];
+  bool used[2];
+  for (int i = 0; i < 2; i++) {
+    free[i] = block_is_free(children[i], region, child_level);
+    used[i] = !free[i] && block_is_used(children[i], region, child_level);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    if (children[i] + child_size <= start || children[i] >= end) {
+      continue;
+    }
+
+    if (!free[i] && !used[i]) {
+      find_candidates(children[i], region, child_level, start, end,
+                      candidates, maxCandidates, found);
+      continue;
+    }
+
+    if (!used[i] || !free[1 - i] || block < start ||
+        block + size_of_level(level) > end) {
+      continue;
+    }
+
+    // Relocating the child frees the parent, which merges upwards while its
+    // buddy is free
+    uintptr_t merged = block;
+    uint8_t l = level;
+    while (l > 0) {
+      const uintptr_t parent = align_left(merged, l - 1);
+      if (parent < start || parent + size_of_level(l - 1) > end ||
+          !block_is_free(get_buddy(merged, l), region, l)) {
+        break;
+      }
+      merged = parent;
+      l--;
+    }
+
+    const EvacuationCandidate candidate = {
+        reinterpret_cast<void *>(children[i]), child_size, size_of_level(l)};
+    const auto better = [](const EvacuationCandidate &a,
+                           const EvacuationCandidate &b) {
+      return a.freeSize * b.size > b.freeSize * a.size;
+    };
+
+    // Insert the candidate in order, dropping the worst one when full
+    size_t pos = found;
+    if (found < maxCandidates) {
+      found++;
+    } else if (maxCandidates > 0 &&
+               better(candidate, candidates[maxCandidates - 1])) {
+      pos = maxCandidates - 1;
+    } else {
+      continue;
+    }
+    while (pos > 0 && better(candidate, candidates[pos - 1])) {
+      candidates[pos] = candidates[pos - 1];
+      pos--;
+    }
+    candidates[pos] = candidate;
+  }
+}
+
+// Returns the size of the largest free block of a region, taken from the
+// lowest non-empty free list. The region is not locked, so the result is only
+// a snapshot.
+template <typename Config>
+size_t BuddyAllocator<Config>::largest_free_block(uint8_t region) {
+  const uint32_t levels = _freeLevels[region].load(std::memory_order_relaxed);
+  return levels == 0 ? 0 : size_of_level(__builtin_ctz(levels));
+}
+
+// Locks a region, counting the wait if another thread holds it
+template <typename Config>
+void BuddyAllocator<Config>::lock_region(uint8_t region) {
+  if (!_regionMutexes[region].try_lock()) {
+    _stats.count(Stat::RegionWait);
+    _regionMutexes[region].lock();
+  }
+}
+
+// Fills counts with the number of free blocks of each level in a region
+template <typename Config>
+void BuddyAllocator<Config>::free_block_histogram(uint8_t region,
+                                                  unsigned int *counts) {
+  _regionMutexes[region].lock();
+  for (uint8_t i = 0; i < _numLevels; i++) {
+    counts[i] = _freeCounts[region][i];
+  }
+  _regionMutexes[region].unlock();
+}
+
+// Returns the external fragmentation index, the share of the free memory that
+// lies outside the largest free block of its region. A block can not span
+// regions, so an empty heap reads 0 however many regions it has. Blocks in the
+// lazy lists count as fragmented.
+template <typename Config> double BuddyAllocator<Config>::fragmentation() {
+  const size_t total = free_size();
+  if (total == 0) {
+    return 0.0;
+  }
+
+  size_t largest = 0;
+  for (uint8_t r = 0; r < _numRegions; r++) {
+    largest += largest_free_block(r);
+  }
+  return 1.0 - static_cast<double>(largest) / static_cast<double>(total);
+}
+
+// Returns the operation counters summed over all threads. They are all zero
+// unless the Config collects stats.
+template <typename Config> BuddyStats BuddyAllocator<Config>::stats() {
+  BuddyStats totals;
+  _stats.collect(totals);
+  return totals;
+}
+
+template <typename Config> void BuddyAllocator<Config>::reset_stats() {
+  _stats.reset();
+}
+
+template <typename Config> void BuddyAllocator<Config>::print_stats() {
+  stats().print(std::cout, _numLevels, _maxSize);
+}
+
+template <typename Config>
+double_link *BuddyAllocator<Config>::free_list_head(uint8_t region,
+                                                    uint8_t level) {
+  return &_freeList[region][level];
+}
+
+// Counts the whole free blocks below a block, skipping allocated subtrees
+template <typename Config>
+void BuddyAllocator<Config>::count_free_blocks(uintptr_t block, uint8_t region,
+                                               uint8_t level,
+                                               unsigned int *counts) {
+  if (block_is_free(block, region, level)) {
+    counts[level]++;
+    return;
+  }
+  if (level == _numLevels - 1 || block_is_used(block, region, level)) {
+    return;
+  }
+  count_free_blocks(block, region, level + 1, counts);
+  count_free_blocks(block + size_of_level(level + 1), region, level + 1,
+                    counts);
+}
+
 template <typename Config>
 void BuddyAllocator<Config>::set_split_block(uint8_t region,
                                              unsigned int blockIndex,
@@ -486,6 +812,13 @@ void BuddyAllocator<Config>::set_split_block(uint8_t region,
   }
 }
 
+template <typename Config>
+void BuddyAllocator<Config>::clear_split_blocks(uint8_t region,
+                                                unsigned int blockIndex,
+                                                unsigned int count) {
+  BuddyHelper::clear_bits(_sizeMap[region], blockIndex, count);
+}
+
 template <typename Config>
 void BuddyAllocator<Config>::set_allocated_block(uint8_t region,
                                                  unsigned int blockIndex,
@@ -515,6 +848,14 @@ bool BuddyAllocator<Config>::block_is_allocated(uint8_t region,
   return BuddyHelper::bit_is_set(_freeBlocks[region], blockIndex);
 }
 
+// Returns true if any of count consecutive allocated bits is set
+template <typename Config>
+bool BuddyAllocator<Config>::any_block_allocated(uint8_t region,
+                                                 unsigned int blockIndex,
+                                                 unsigned int count) {
+  return BuddyHelper::any_bit_set(_freeBlocks[region], blockIndex, count);
+}
+
 // Fills the memory, marking all blocks as allocated
 // This overwrites previous allocations
 template <typename Config> void BuddyAllocator<Config>::fill() {
@@ -12,10 +12,22 @@
 template <typename Config>
 void IBuddyAllocator<Config>::init_bitmaps(bool startFull) {
 
-  unsigned char freeBlocksPattern = startFull ? 0x0 : 0x55; // 0x55 = 01010101
-  unsigned char sizeMapPattern = startFull ? 0xFF : 0x0;    // 0xFF = 11111111
+  const unsigned char freeBlocksPattern = 0x0;
+  unsigned char sizeMapPattern = startFull ? 0xFF : 0x0; // 0xFF = 11111111
 
   BuddyAllocator<Config>::set_bitmaps(freeBlocksPattern, sizeMapPattern);
+
+  for (int r = 0; r < Config::numRegions; r++) {
+    for (int i = 0; i < Config::allocedBitmapSize; i++) {
+      _coveredBlocks[r][i] = 0x0;
+    }
+
+    // An empty region is a single covered block
+    if (!startFull) {
+      BuddyAllocator<Config>::set_allocated_block(r, 0, true);
+      set_covered_block(r, 0, true);
+    }
+  }
 }
 
 template <typename Config>
@@ -25,26 +37,12 @@ IBuddyAllocator<Config>::IBuddyAllocator(void *start, int lazyThreshold,
   // Initialize bitmaps
   init_bitmaps(startFull);
 
-  // Insert all blocks into the free lists if starting empty
+  // Insert the regions into the free lists if starting empty, the smaller
+  // levels are filled in as the blocks are split
   if (!startFull) {
     for (int r = 0; r < Config::numRegions; r++) {
       uintptr_t curr_start = BuddyAllocator<Config>::region_start(r);
-
-      // Insert blocks into the free lists
-      for (uint8_t lvl = BuddyAllocator<Config>::_numLevels - 1; lvl > 0;
-           lvl--) {
-        for (uintptr_t i =
-                 curr_start +
-                 (1U << static_cast<unsigned int>(
-                      BuddyAllocator<Config>::_maxBlockSizeLog2 - lvl));
-             i < curr_start + BuddyAllocator<Config>::_maxSize;
-             i += (2U << static_cast<unsigned int>(
-                       BuddyAllocator<Config>::_maxBlockSizeLog2 - lvl))) {
-          BuddyAllocator<Config>::push_free_list(i, r, lvl);
-        }
-      }
       BuddyAllocator<Config>::push_free_list(curr_start, r, 0);
-
     }
   }
 }
@@ -66,13 +64,6 @@ IBuddyAllocator<Config>::create(void *addr, void *start, int lazyThreshold,
   return new (addr) IBuddyAllocator(start, lazyThreshold, startFull);
 }
 
-// Function to read the CPU cycle counter
-inline unsigned long long rdtsc() {
-  unsigned int low, high;
-  asm volatile("rdtsc" : "=a"(low), "=d"(high));
-  return ((unsigned long long)high << 32) | low;
-}
-
 // Allocates a block of memory of the given size
 template <typename Config>
 void *IBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
@@ -84,6 +75,15 @@ void *IBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
   size_t threadOffset = 0;
   bool all_checked = true;
 
+  // Start with the region whose largest free block is the tightest fit
+  if (BuddyAllocator<Config>::_placement == Placement::BestFit) {
+    const int best_region = BuddyAllocator<Config>::best_fit_region(
+        BuddyAllocator<Config>::find_smallest_block_level(totalSize));
+    if (best_region >= 0) {
+      threadOffset = best_region;
+    }
+  }
+
   uint8_t region = 0;
   for (int attempt = 0; attempt < 2; attempt++) {
     if (attempt == 1 && all_checked) {
@@ -97,6 +97,7 @@ void *IBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
       if (attempt == 0 &&
           !BuddyAllocator<Config>::_regionMutexes[region].try_lock()) {
         all_checked = false;
+        BuddyAllocator<Config>::_stats.count(Stat::ScanRetry);
         continue;
       }
       if (attempt == 1) {
@@ -104,14 +105,16 @@ void *IBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
       }
 
       // Move down if the current level inside the region has been exhausted
-      while (BuddyAllocator<Config>::free_list_empty(
-                 region, BuddyAllocator<Config>::_topLevel[region]) &&
-             BuddyAllocator<Config>::_topLevel[region] <
-                 BuddyAllocator<Config>::_numLevels) {
+      while (BuddyAllocator<Config>::_topLevel[region] <
+                 BuddyAllocator<Config>::_numLevels &&
+             BuddyAllocator<Config>::free_list_empty(
+                 region, BuddyAllocator<Config>::_topLevel[region])) {
         BuddyAllocator<Config>::_topLevel[region]++;
       }
 
-      if (BuddyAllocator<Config>::size_of_level(
+      if (BuddyAllocator<Config>::_topLevel[region] <
+              BuddyAllocator<Config>::_numLevels &&
+          BuddyAllocator<Config>::size_of_level(
               BuddyAllocator<Config>::_topLevel[region]) >= totalSize) {
         goto block_found;
       }
@@ -124,10 +127,10 @@ void *IBuddyAllocator<Config>::allocate_internal(size_t totalSize) {
 
 block_found:
 
-  uint8_t level = BuddyAllocator<Config>::_topLevel[region];
+  const uint8_t level = BuddyAllocator<Config>::_topLevel[region];
 
   // Get the first free block
-  uintptr_t block = BuddyAllocator<Config>::pop_free_list(region, level);
+  const uintptr_t block = BuddyAllocator<Config>::pop_free_list(region, level);
 
   const uint8_t block_level =
       BuddyAllocator<Config>::find_smallest_block_level(totalSize);
@@ -148,104 +151,275 @@ block_found:
   BuddyAllocator<Config>::set_allocated_block(
       region, BuddyAllocator<Config>::block_index(block, region, level), false);
 
-  // Can fit in one block
-  if (totalSize <= static_cast<size_t>(BuddyAllocator<Config>::_minSize)) {
-    BuddyAllocator<Config>::_freeSizes[region] -=
-        BuddyAllocator<Config>::_minSize;
-    BuddyAllocator<Config>::_regionMutexes[region].unlock();
-    return reinterpret_cast<void *>(block);
+  // The free block is split into buddies down to the covered level, with the
+  // rest of it only being present in the free lists through this block
+  const uint8_t core_level = covered_level(block, region, level);
+  set_covered_block(
+      region, BuddyAllocator<Config>::block_index(block, region, core_level),
+      false);
+
+  if (block_level >= core_level) {
+    BuddyAllocator<Config>::_stats.count(Stat::Split, block_level - core_level);
+
+    // Split the covered block, inserting the right buddies into the free lists
+    for (uint8_t i = core_level + 1; i <= block_level; i++) {
+      const uintptr_t buddy = block + BuddyAllocator<Config>::size_of_level(i);
+      const unsigned int buddy_idx =
+          BuddyAllocator<Config>::block_index(buddy, region, i);
+      BuddyAllocator<Config>::push_free_list(buddy, region, i);
+      BuddyAllocator<Config>::set_allocated_block(region, buddy_idx, true);
+      set_covered_block(region, buddy_idx, true);
+    }
+  } else {
+    BuddyAllocator<Config>::_stats.count(Stat::Merge, core_level - block_level);
+
+    // Remove the buddies already split off inside the allocated block
+    for (uint8_t i = block_level + 1; i <= core_level; i++) {
+      const uintptr_t buddy = BuddyAllocator<Config>::get_buddy(block, i);
+      const unsigned int buddy_idx =
+          BuddyAllocator<Config>::block_index(buddy, region, i);
+      BuddyAllocator<Config>::remove_free_list(buddy, region, i);
+      BuddyAllocator<Config>::set_allocated_block(region, buddy_idx, false);
+      set_covered_block(region, buddy_idx, false);
+    }
   }
 
-  level = block_level;
+  BuddyAllocator<Config>::_freeSizes[region] -=
+      BuddyAllocator<Config>::size_of_level(block_level);
 
-  // Clear all smaller levels
-  const uint8_t start_level =
-      BuddyAllocator<Config>::find_smallest_block_level(totalSize);
-  const size_t new_size = BuddyHelper::round_up_pow2(totalSize);
+  BuddyAllocator<Config>::_regionMutexes[region].unlock();
+  return reinterpret_cast<void *>(block_left);
+}
 
+// Allocations are taken from the largest free block of a region
+template <typename Config>
+uint8_t IBuddyAllocator<Config>::fit_level(uint8_t region, uint8_t level) {
+  const uint32_t levels = BuddyAllocator<Config>::_freeLevels[region].load(
+      std::memory_order_relaxed);
+  if (levels == 0 || static_cast<uint8_t>(__builtin_ctz(levels)) > level) {
+    return BuddyAllocator<Config>::_numLevels;
+  }
+  return __builtin_ctz(levels);
+}
 
-  for (int i = start_level + 1; i < BuddyAllocator<Config>::_numLevels; i++) {
-    const unsigned int start_block_idx =
-        BuddyAllocator<Config>::block_index(block_left, region, i);
-    for (unsigned int j = start_block_idx;
-         j < start_block_idx + BuddyAllocator<Config>::num_blocks(new_size, i);
-         j++) {
-      BuddyAllocator<Config>::set_allocated_block(region, j, false);
+// A block is free if it lies inside a listed free block. The free bits are
+// not kept for whole regions, which are found through their free list.
+template <typename Config>
+bool IBuddyAllocator<Config>::block_is_free(uintptr_t ptr, uint8_t region,
+                                            uint8_t level) {
+  if (!BuddyAllocator<Config>::free_list_empty(region, 0)) {
+    return true;
+  }
+  for (uint8_t i = level; i > 0; i--) {
+    if (BuddyAllocator<Config>::block_is_allocated(
+            region, BuddyAllocator<Config>::block_index(ptr, region, i))) {
+      return true;
     }
   }
+  return false;
+}
 
-  // Clear free list
-  for (uintptr_t i = block_left; i < block_left + new_size;
-       i += BuddyAllocator<Config>::size_of_level(
-           BuddyAllocator<Config>::_numLevels - 1)) {
-    if (i != block) {
-      BuddyHelper::list_remove(reinterpret_cast<double_link *>(i));
-    }
+// A block is used if it is not free and no free bit is set below it. The
+// bits of each level below the block are consecutive. The split bitmap is
+// checked instead when kept, so that only single allocations count.
+template <typename Config>
+bool IBuddyAllocator<Config>::block_is_used(uintptr_t ptr, uint8_t region,
+                                            uint8_t level) {
+  if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
+      BuddyAllocator<Config>::_sizeMapEnabled) {
+    return BuddyAllocator<Config>::block_is_used(ptr, region, level);
   }
 
-  BuddyAllocator<Config>::_freeSizes[region] -= new_size;
+  for (uint8_t i = level + 1; i < BuddyAllocator<Config>::_numLevels; i++) {
+    if (BuddyAllocator<Config>::any_block_allocated(
+            region, BuddyAllocator<Config>::block_index(ptr, region, i),
+            1U << static_cast<unsigned int>(i - level))) {
+      return false;
+    }
+  }
+  return !block_is_free(ptr, region, level);
+}
 
+// The free lists also hold the split off parts of larger free blocks, so
+// only the listed blocks without a free ancestor are counted
+template <typename Config>
+void IBuddyAllocator<Config>::free_block_histogram(uint8_t region,
+                                                   unsigned int *counts) {
+  BuddyAllocator<Config>::_regionMutexes[region].lock();
+  for (uint8_t i = 0; i < BuddyAllocator<Config>::_numLevels; i++) {
+    counts[i] = 0;
+    double_link *head = BuddyAllocator<Config>::free_list_head(region, i);
+    for (double_link *link = head->next; link != head; link = link->next) {
+      if (i == 0 || !block_is_free(reinterpret_cast<uintptr_t>(link), region,
+                                   i - 1)) {
+        counts[i]++;
+      }
+    }
+  }
   BuddyAllocator<Config>::_regionMutexes[region].unlock();
-  return reinterpret_cast<void *>(block_left);
 }
 
-// Deallocates a single (smallest) block of memory
+// Deallocates a block of memory at the given level
 template <typename Config>
-void IBuddyAllocator<Config>::deallocate_single(uintptr_t ptr) {
+void IBuddyAllocator<Config>::deallocate_block(uintptr_t ptr, uint8_t level) {
 
   const uint8_t region = BuddyAllocator<Config>::get_region(ptr);
-  uint8_t level = BuddyAllocator<Config>::_numLevels - 1;
-  int block_idx = BuddyAllocator<Config>::block_index(ptr, region, level);
-  int buddy_idx = BuddyAllocator<Config>::buddy_index(ptr, region, level);
+  uint8_t free_level = level;
+
+  BuddyAllocator<Config>::lock_region(region);
 
   // While the buddy is free, go up a level
-  while (level > 0 &&
-         BuddyAllocator<Config>::block_is_allocated(region, buddy_idx)) {
-    level--;
-    block_idx = BuddyAllocator<Config>::block_index(ptr, region, level);
-    buddy_idx = BuddyAllocator<Config>::buddy_index(ptr, region, level);
+  while (free_level > 0) {
+    const unsigned int buddy_idx =
+        BuddyAllocator<Config>::buddy_index(ptr, region, free_level);
+    if (!BuddyAllocator<Config>::block_is_allocated(region, buddy_idx)) {
+      break;
+    }
+
+    // The buddy is kept in its free list, but may not have split buddies
+    if (!block_is_covered(region, buddy_idx)) {
+      collapse_block(BuddyAllocator<Config>::get_buddy(ptr, free_level),
+                     region, free_level);
+    }
+
+    free_level--;
+    BuddyAllocator<Config>::_stats.count(Stat::Merge);
 
     if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
         BuddyAllocator<Config>::_sizeMapEnabled) {
-      BuddyAllocator<Config>::set_split_block(region, block_idx, false);
+      BuddyAllocator<Config>::set_split_block(
+          region, BuddyAllocator<Config>::block_index(ptr, region, free_level),
+          false);
     }
   }
 
   // Mark the block as free and insert it into the free list
-  BuddyAllocator<Config>::push_free_list(ptr, region, level);
-  if (level > 0) {
-
-    BuddyAllocator<Config>::set_allocated_block(region, block_idx, true);
+  BuddyAllocator<Config>::push_free_list(ptr, region, free_level);
+  set_covered_block(region,
+                    BuddyAllocator<Config>::block_index(ptr, region, level),
+                    true);
+  if (free_level > 0) {
+    BuddyAllocator<Config>::set_allocated_block(
+        region, BuddyAllocator<Config>::block_index(ptr, region, free_level),
+        true);
   }
 
   // Set the level of the topmost free block
-  if (level < BuddyAllocator<Config>::_topLevel[region]) {
-    BuddyAllocator<Config>::_topLevel[region] = level;
+  if (free_level < BuddyAllocator<Config>::_topLevel[region]) {
+    BuddyAllocator<Config>::_topLevel[region] = free_level;
   }
 
   BuddyAllocator<Config>::_freeSizes[region] +=
-      BuddyAllocator<Config>::_minSize;
+      BuddyAllocator<Config>::size_of_level(level);
+  BuddyAllocator<Config>::_regionMutexes[region].unlock();
+}
+
+// Turns a free block with split buddies into a single covered block
+template <typename Config>
+void IBuddyAllocator<Config>::collapse_block(uintptr_t ptr, uint8_t region,
+                                             uint8_t level) {
+  uintptr_t block = ptr;
+  uint8_t i = level;
+  unsigned int block_idx = BuddyAllocator<Config>::block_index(block, region, i);
+
+  // Follow the split blocks down to the covered one, removing the buddies
+  while (!block_is_covered(region, block_idx)) {
+    i++;
+    uintptr_t buddy = block + BuddyAllocator<Config>::size_of_level(i);
+    unsigned int buddy_idx =
+        BuddyAllocator<Config>::block_index(buddy, region, i);
+    if (!BuddyAllocator<Config>::block_is_allocated(region, buddy_idx)) {
+      buddy = block;
+      block += BuddyAllocator<Config>::size_of_level(i);
+      buddy_idx = BuddyAllocator<Config>::block_index(buddy, region, i);
+    }
+
+    BuddyAllocator<Config>::remove_free_list(buddy, region, i);
+    BuddyAllocator<Config>::set_allocated_block(region, buddy_idx, false);
+    set_covered_block(region, buddy_idx, false);
+    block_idx = BuddyAllocator<Config>::block_index(block, region, i);
+  }
+
+  // The covered block is listed at the level of the whole free block
+  BuddyAllocator<Config>::remove_free_list(block, region, level);
+  set_covered_block(region, block_idx, false);
+
+  BuddyAllocator<Config>::push_free_list(ptr, region, level);
+  set_covered_block(region,
+                    BuddyAllocator<Config>::block_index(ptr, region, level),
+                    true);
+}
+
+// Returns the level of the covered block holding the first block of a free
+// block at the given level
+template <typename Config>
+uint8_t IBuddyAllocator<Config>::covered_level(uintptr_t ptr, uint8_t region,
+                                               uint8_t level) {
+  uint8_t i = BuddyAllocator<Config>::_numLevels - 1;
+  while (i > level &&
+         !block_is_covered(
+             region, BuddyAllocator<Config>::block_index(ptr, region, i))) {
+    i--;
+  }
+
+  return i;
 }
 
-// Deallocates a range of blocks of memory as if they were the smallest block
+// Deallocates a range of memory, split into the largest aligned blocks
 template <typename Config>
 void IBuddyAllocator<Config>::deallocate_range(void *ptr, size_t size) {
   const auto start = reinterpret_cast<uintptr_t>(ptr);
-  const uintptr_t aligned_start = BuddyAllocator<Config>::align_left(
+  uintptr_t block = BuddyAllocator<Config>::align_left(
       start + BuddyAllocator<Config>::_minSize - 1,
       BuddyAllocator<Config>::_numLevels - 1);
   const uintptr_t end = BuddyAllocator<Config>::align_left(
       start + size, BuddyAllocator<Config>::_numLevels - 1);
-  for (uintptr_t i = aligned_start; i < end;
-       i += BuddyAllocator<Config>::size_of_level(
-           BuddyAllocator<Config>::_numLevels - 1)) {
 
-    deallocate_single(i);
+  while (block < end) {
+    const uint8_t region = BuddyAllocator<Config>::get_region(block);
+
+    // Find the largest aligned block that fits in the rest of the range
+    uint8_t level = BuddyAllocator<Config>::level_alignment(block, region, 0);
+    while (BuddyAllocator<Config>::size_of_level(level) > end - block) {
+      level++;
+    }
+
+    // Clear the split blocks inside the block, one level at a time
+    if (BuddyAllocator<Config>::_sizeMapIsBitmap &&
+        BuddyAllocator<Config>::_sizeMapEnabled) {
+      for (uint8_t i = level; i < BuddyAllocator<Config>::_numLevels - 1;
+           i++) {
+        BuddyAllocator<Config>::clear_split_blocks(
+            region, BuddyAllocator<Config>::block_index(block, region, i),
+            1U << static_cast<unsigned int>(i - level));
+      }
+    }
+
+    deallocate_block(block, level);
+    block += BuddyAllocator<Config>::size_of_level(level);
   }
 }
 
 // Deallocates a block of memory of the given size
 template <typename Config>
 void IBuddyAllocator<Config>::deallocate_internal(void *ptr, size_t size) {
-  return deallocate_range(ptr, BuddyHelper::round_up_pow2(size));
+  deallocate_block(reinterpret_cast<uintptr_t>(ptr),
+                   BuddyAllocator<Config>::find_smallest_block_level(size));
+}
+
+template <typename Config>
+void IBuddyAllocator<Config>::set_covered_block(uint8_t region,
+                                                unsigned int blockIndex,
+                                                bool covered) {
+  if (covered) {
+    BuddyHelper::set_bit(_coveredBlocks[region], blockIndex);
+  } else {
+    BuddyHelper::clear_bit(_coveredBlocks[region], blockIndex);
+  }
+}
+
+template <typename Config>
+bool IBuddyAllocator<Config>::block_is_covered(uint8_t region,
+                                               unsigned int blockIndex) {
+  return BuddyHelper::bit_is_set(_coveredBlocks[region], blockIndex);
 }
@@ -0,0 +1,446 @@
+#include "../include/malloc_trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Records the malloc calls of a program while passing them on to the C
+// library allocator, for LD_PRELOAD=tracelib.so. The records go to
+// <prefix>.<pid>.raw, with the prefix taken from BUDDY_TRACE and malloc_trace
+// by default. Each thread appends to its own buffer without locking or
+// waiting and writes the full buffer to the file in one write, at thread exit
+// and at process exit. Process exit waits for the appends in progress and
+// drops any later ones. trace_convert turns the capture into a binary trace.
+
+namespace {
+
+using MallocFunction = void *(*)(size_t);
+using CallocFunction = void *(*)(size_t, size_t);
+using ReallocFunction = void *(*)(void *, size_t);
+using FreeFunction = void (*)(void *);
+using MemalignFunction = void *(*)(size_t, size_t);
+using PosixMemalignFunction = int (*)(void **, size_t, size_t);
+
+// The next definitions of the functions, those of the C library
+struct RealFunctions {
+  MallocFunction malloc;
+  CallocFunction calloc;
+  ReallocFunction realloc;
+  FreeFunction free;
+  MemalignFunction memalign;
+  MemalignFunction aligned_alloc;
+  PosixMemalignFunction posix_memalign;
+  MallocFunction valloc;
+  MallocFunction pvalloc;
+};
+
+RealFunctions real = {};
+
+const size_t bufferRecords = 1 << 16;
+const unsigned int maxThreads = 4096;
+
+struct ThreadBuffer {
+  // Set by the owning thread while it appends or writes the buffer out, so
+  // that finish only writes the buffer once the owner has stopped
+  std::atomic<bool> active;
+  size_t count;
+  uint16_t thread;
+  MallocTraceRecord records[bufferRecords];
+};
+
+enum State { Uninitialized, Initializing, Ready };
+std::atomic<int> state(Uninitialized);
+std::atomic<bool> enabled(false);
+int traceFd = -1;
+
+ThreadBuffer *buffers[maxThreads];
+std::atomic<unsigned int> numBuffers(0);
+pthread_key_t bufferKey;
+
+// Set while the library itself runs, so that the allocations of dlsym, mmap
+// and pthread go straight to the C library without being recorded
+thread_local bool inHook __attribute__((tls_model("initial-exec"))) = false;
+thread_local ThreadBuffer *threadBuffer
+    __attribute__((tls_model("initial-exec"))) = nullptr;
+thread_local bool noBuffer __attribute__((tls_model("initial-exec"))) = false;
+
+// Memory of the allocations made by dlsym before malloc is looked up. Never
+// freed.
+alignas(16) char bootstrapArena[64 * 1024];
+std::atomic<size_t> bootstrapUsed(0);
+
+void *bootstrap_allocate(size_t size) {
+  const size_t rounded = (size + 15) & ~static_cast<size_t>(15);
+  const size_t offset = bootstrapUsed.fetch_add(rounded);
+  if (rounded < size || offset + rounded > sizeof(bootstrapArena)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  return bootstrapArena + offset;
+}
+
+bool is_bootstrap(const void *ptr) {
+  const char *p = static_cast<const char *>(ptr);
+  return p >= bootstrapArena && p < bootstrapArena + sizeof(bootstrapArena);
+}
+
+class HookGuard {
+public:
+  HookGuard() { inHook = true; }
+  ~HookGuard() { inHook = false; }
+};
+
+template <typename Function> void resolve(Function &function, const char *name) {
+  void *symbol = dlsym(RTLD_NEXT, name);
+  std::memcpy(&function, &symbol, sizeof(function));
+}
+
+void write_all(const void *data, size_t size) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    const ssize_t written = write(traceFd, p, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return;
+    }
+    p += written;
+    size -= written;
+  }
+}
+
+void write_error(const char *message) {
+  const ssize_t ignored = write(STDERR_FILENO, message, std::strlen(message));
+  (void)ignored;
+}
+
+// Creates <prefix>.<pid>.raw and writes the header, without allocating
+void open_trace() {
+  const char *prefix = getenv("BUDDY_TRACE");
+  if (prefix == nullptr || prefix[0] == '\0') {
+    prefix = "malloc_trace";
+  }
+  const pid_t pid = getpid();
+  char digits[24];
+  size_t numDigits = 0;
+  for (uint64_t n = pid; n > 0 || numDigits == 0; n /= 10) {
+    digits[numDigits++] = static_cast<char>('0' + n % 10);
+  }
+
+  char path[4096];
+  const size_t prefixLength = std::strlen(prefix);
+  if (prefixLength + numDigits + 6 > sizeof(path)) {
+    write_error("tracelib: BUDDY_TRACE is too long\n");
+    return;
+  }
+  char *p = path;
+  std::memcpy(p, prefix, prefixLength);
+  p += prefixLength;
+  *p++ = '.';
+  while (numDigits > 0) {
+    *p++ = digits[--numDigits];
+  }
+  std::memcpy(p, ".raw", 5);
+
+  traceFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                 0644);
+  if (traceFd < 0) {
+    write_error("tracelib: failed to create the trace file\n");
+    return;
+  }
+  MallocTraceHeader header = {};
+  std::memcpy(header.magic, MALLOC_TRACE_MAGIC, sizeof(MALLOC_TRACE_MAGIC));
+  header.version = MALLOC_TRACE_VERSION;
+  header.pid = pid;
+  write_all(&header, sizeof(header));
+  enabled = true;
+}
+
+// Marks the buffer as in use by its owner, unless recording has stopped, in
+// which case finish owns the buffer. The owner never waits: either finish
+// sees the flag and waits for it to clear, or the owner sees enabled cleared.
+bool enter(ThreadBuffer *buffer) {
+  buffer->active.store(true);
+  if (!enabled.load()) {
+    buffer->active.store(false, std::memory_order_release);
+    return false;
+  }
+  return true;
+}
+
+void leave(ThreadBuffer *buffer) {
+  buffer->active.store(false, std::memory_order_release);
+}
+
+void flush(ThreadBuffer *buffer) {
+  if (buffer->count > 0 && traceFd >= 0) {
+    write_all(buffer->records, buffer->count * sizeof(MallocTraceRecord));
+  }
+  buffer->count = 0;
+}
+
+void flush_at_thread_exit(void *buffer) {
+  ThreadBuffer *owned = static_cast<ThreadBuffer *>(buffer);
+  if (enter(owned)) {
+    flush(owned);
+    leave(owned);
+  }
+}
+
+// A forked child writes its own file, without the records of its parent
+void reopen_in_child() {
+  const unsigned int count = std::min(numBuffers.load(), maxThreads);
+  for (unsigned int i = 0; i < count; i++) {
+    buffers[i]->count = 0;
+    buffers[i]->active.store(false);
+  }
+  if (traceFd >= 0) {
+    close(traceFd);
+    traceFd = -1;
+  }
+  enabled = false;
+  open_trace();
+}
+
+void initialize() {
+  int expected = Uninitialized;
+  if (!state.compare_exchange_strong(expected, Initializing)) {
+    return;
+  }
+  HookGuard guard;
+  resolve(real.malloc, "malloc");
+  resolve(real.calloc, "calloc");
+  resolve(real.realloc, "realloc");
+  resolve(real.free, "free");
+  resolve(real.memalign, "memalign");
+  resolve(real.aligned_alloc, "aligned_alloc");
+  resolve(real.posix_memalign, "posix_memalign");
+  resolve(real.valloc, "valloc");
+  resolve(real.pvalloc, "pvalloc");
+  if (real.malloc == nullptr || real.free == nullptr) {
+    write_error("tracelib: failed to find the C library malloc\n");
+    abort();
+  }
+
+  pthread_key_create(&bufferKey, flush_at_thread_exit);
+  pthread_atfork(nullptr, nullptr, reopen_in_child);
+  open_trace();
+  state.store(Ready, std::memory_order_release);
+}
+
+// Whether the call is recorded, initializing on the first call
+bool tracing() {
+  if (state.load(std::memory_order_acquire) != Ready) {
+    initialize();
+  }
+  return !inHook && enabled.load(std::memory_order_relaxed);
+}
+
+ThreadBuffer *thread_buffer() {
+  if (threadBuffer != nullptr || noBuffer) {
+    return threadBuffer;
+  }
+  const unsigned int index = numBuffers.fetch_add(1);
+  void *memory = index < maxThreads
+                     ? mmap(nullptr, sizeof(ThreadBuffer),
+                            PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                     : MAP_FAILED;
+  if (memory == MAP_FAILED) {
+    write_error("tracelib: a thread is not recorded\n");
+    noBuffer = true;
+    return nullptr;
+  }
+  ThreadBuffer *buffer = static_cast<ThreadBuffer *>(memory);
+  buffer->active.store(false);
+  buffer->count = 0;
+  buffer->thread = static_cast<uint16_t>(index);
+  buffers[index] = buffer;
+  threadBuffer = buffer;
+  pthread_setspecific(bufferKey, buffer);
+  return buffer;
+}
+
+void record(char call, const void *addr, const void *oldAddr, size_t size,
+            size_t alignment) {
+  ThreadBuffer *buffer = thread_buffer();
+  if (buffer == nullptr) {
+    return;
+  }
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (!enter(buffer)) {
+    return;
+  }
+  MallocTraceRecord &r = buffer->records[buffer->count++];
+  r.time = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  r.addr = reinterpret_cast<uintptr_t>(addr);
+  r.oldAddr = reinterpret_cast<uintptr_t>(oldAddr);
+  r.size = size;
+  r.alignment = static_cast<uint32_t>(alignment);
+  r.thread = buffer->thread;
+  r.call = call;
+  r.reserved = 0;
+  if (buffer->count == bufferRecords) {
+    flush(buffer);
+  }
+  leave(buffer);
+}
+
+// Stops recording and writes out the buffers of every thread, including
+// those still running, once their owners have finished the appends in
+// progress
+__attribute__((destructor)) void finish() {
+  if (state.load() != Ready) {
+    return;
+  }
+  HookGuard guard;
+  enabled.store(false);
+  const unsigned int count = std::min(numBuffers.load(), maxThreads);
+  for (unsigned int i = 0; i < count; i++) {
+    if (buffers[i] != nullptr) {
+      while (buffers[i]->active.load(std::memory_order_acquire)) {
+      }
+      flush(buffers[i]);
+    }
+  }
+}
+
+void *aligned_call(MemalignFunction function, size_t alignment,
+                   size_t size) {
+  if (!tracing()) {
+    return function != nullptr ? function(alignment, size) : nullptr;
+  }
+  HookGuard guard;
+  void *p = function != nullptr ? function(alignment, size) : nullptr;
+  record('a', p, nullptr, size, alignment);
+  return p;
+}
+
+} // namespace
+
+extern "C" {
+void *malloc(size_t size) {
+  if (!tracing()) {
+    return real.malloc != nullptr ? real.malloc(size)
+                                  : bootstrap_allocate(size);
+  }
+  HookGuard guard;
+  void *p = real.malloc(size);
+  record('m', p, nullptr, size, 0);
+  return p;
+}
+
+void *calloc(size_t num, size_t size) {
+  size_t total;
+  if (__builtin_mul_overflow(num, size, &total)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  if (!tracing()) {
+    // The arena is static memory, which is zeroed
+    return real.calloc != nullptr ? real.calloc(num, size)
+                                  : bootstrap_allocate(total);
+  }
+  HookGuard guard;
+  void *p = real.calloc(num, size);
+  record('c', p, nullptr, total, 0);
+  return p;
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (is_bootstrap(ptr)) {
+    void *p = malloc(size);
+    if (p != nullptr) {
+      const size_t available =
+          bootstrapArena + sizeof(bootstrapArena) - static_cast<char *>(ptr);
+      std::memcpy(p, ptr, std::min(size, available));
+    }
+    return p;
+  }
+  if (!tracing()) {
+    return real.realloc != nullptr ? real.realloc(ptr, size) : nullptr;
+  }
+  HookGuard guard;
+  void *p = real.realloc(ptr, size);
+  record('r', p, ptr, size, 0);
+  return p;
+}
+
+void *reallocarray(void *ptr, size_t num, size_t size) {
+  size_t total;
+  if (__builtin_mul_overflow(num, size, &total)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  return realloc(ptr, total);
+}
+
+void free(void *ptr) {
+  if (is_bootstrap(ptr)) {
+    return;
+  }
+  if (!tracing()) {
+    if (real.free != nullptr) {
+      real.free(ptr);
+    }
+    return;
+  }
+  HookGuard guard;
+  record('f', ptr, nullptr, 0, 0);
+  real.free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  return aligned_call(real.memalign, alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  return aligned_call(real.aligned_alloc, alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+  if (!tracing()) {
+    return real.posix_memalign != nullptr
+               ? real.posix_memalign(ptr, alignment, size)
+               : ENOMEM;
+  }
+  HookGuard guard;
+  const int result = real.posix_memalign != nullptr
+                         ? real.posix_memalign(ptr, alignment, size)
+                         : ENOMEM;
+  record('a', result == 0 ? *ptr : nullptr, nullptr, size, alignment);
+  return result;
+}
+
+void *valloc(size_t size) {
+  if (!tracing()) {
+    return real.valloc != nullptr ? real.valloc(size) : nullptr;
+  }
+  HookGuard guard;
+  void *p = real.valloc != nullptr ? real.valloc(size) : nullptr;
+  record('a', p, nullptr, size, sysconf(_SC_PAGESIZE));
+  return p;
+}
+
+void *pvalloc(size_t size) {
+  if (!tracing()) {
+    return real.pvalloc != nullptr ? real.pvalloc(size) : nullptr;
+  }
+  HookGuard guard;
+  void *p = real.pvalloc != nullptr ? real.pvalloc(size) : nullptr;
+  record('a', p, nullptr, size, sysconf(_SC_PAGESIZE));
+  return p;
+}
+}
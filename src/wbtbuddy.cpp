@@ -0,0 +1,469 @@
+#include "../include/wbtbuddy.hpp"
+#include "../include/buddy_allocator.hpp"
+#include "../include/buddy_helper.hpp"
+#include "../include/buddy_instantiations.hpp"
+#include "../include/wbtbuddy_instantiations.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSE2__
+// Loads the Fanout values of a node's children into the low lanes
+template <unsigned int Fanout>
+static inline __m128i load_lanes(const unsigned char *values) {
+  if (Fanout == 8) {
+    return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(values));
+  }
+  int32_t word;
+  std::memcpy(&word, values, sizeof(word));
+  return _mm_cvtsi32_si128(word);
+}
+
+static inline __m128i valid_lanes(unsigned int lanes) {
+  return _mm_cmplt_epi8(
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+      _mm_set1_epi8(static_cast<char>(lanes)));
+}
+#endif
+
+// Returns the lane holding the smallest value that is at least height, or
+// lanes if there is none
+template <unsigned int Fanout>
+static inline unsigned int best_fit_lane(const unsigned char *values,
+                                         unsigned int lanes,
+                                         unsigned char height) {
+#ifdef __SSE2__
+  const __m128i v = load_lanes<Fanout>(values);
+  const __m128i fits = _mm_and_si128(
+      valid_lanes(lanes),
+      _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(static_cast<char>(height))),
+                     v));
+  if (_mm_movemask_epi8(fits) == 0) {
+    return lanes;
+  }
+
+  // Lanes that do not fit are raised to 0xFF so they never win the minimum
+  const __m128i candidates =
+      _mm_or_si128(v, _mm_andnot_si128(fits, _mm_set1_epi8(-1)));
+  __m128i min = _mm_min_epu8(candidates, _mm_srli_epi64(candidates, 32));
+  min = _mm_min_epu8(min, _mm_srli_epi64(min, 16));
+  min = _mm_min_epu8(min, _mm_srli_epi64(min, 8));
+  const __m128i best = _mm_cmpeq_epi8(
+      candidates,
+      _mm_set1_epi8(static_cast<char>(_mm_cvtsi128_si32(min) & 0xFF)));
+  return __builtin_ctz(_mm_movemask_epi8(_mm_and_si128(best, fits)));
+#else
+  unsigned int best = lanes;
+  for (unsigned int i = 0; i < lanes; i++) {
+    if (values[i] >= height && (best == lanes || values[i] < values[best])) {
+      best = i;
+    }
+  }
+  return best;
+#endif
+}
+
+// Returns the first lane of an aligned run of group lanes that are all equal to
+// height, or lanes if there is none
+template <unsigned int Fanout>
+static inline unsigned int free_group_lane(const unsigned char *values,
+                                           unsigned int lanes,
+                                           unsigned char height,
+                                           unsigned int group) {
+#ifdef __SSE2__
+  const __m128i v = load_lanes<Fanout>(values);
+  unsigned int mask = _mm_movemask_epi8(
+      _mm_and_si128(valid_lanes(lanes),
+                    _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(height)))));
+#else
+  unsigned int mask = 0;
+  for (unsigned int i = 0; i < lanes; i++) {
+    if (values[i] == height) {
+      mask |= 1U << i;
+    }
+  }
+#endif
+
+  for (unsigned int shift = 1; shift < group; shift <<= 1) {
+    mask &= mask >> shift;
+  }
+  // Only keep runs starting at a multiple of group
+  mask &= 0xFFU / ((1U << group) - 1);
+
+  return mask != 0 ? __builtin_ctz(mask) : lanes;
+}
+
+template <typename Config, unsigned int Fanout>
+void WBTBuddyAllocator<Config, Fanout>::init_bitmaps(bool startFull) {
+  const unsigned char freeBlocksPattern = 0x0;
+  const unsigned char sizeMapPattern =
+      startFull ? 0xFF : 0x0; // 0xFF = 11111111
+
+  BuddyAllocator<Config>::set_bitmaps(freeBlocksPattern, sizeMapPattern);
+
+  for (int r = 0; r < Config::numRegions; r++) {
+    for (uint8_t k = 0; k < numWideLevels; k++) {
+      const unsigned char tree_height =
+          startFull ? 0 : BuddyAllocator<Config>::_numLevels - _wideDepths[k];
+      std::memset(node(r, k, 0), tree_height, 1U << _wideDepths[k]);
+    }
+  }
+}
+
+template <typename Config, unsigned int Fanout>
+WBTBuddyAllocator<Config, Fanout>::WBTBuddyAllocator(void *start,
+                                                     int lazyThreshold,
+                                                     bool startFull)
+    : BuddyAllocator<Config>(start, lazyThreshold, startFull) {
+
+  // The root may have fewer children so that the leaves are always stored
+  _wideDepths[1] = (Config::numLevels - 1) - fanoutLog2 * (numWideLevels - 2);
+  for (uint8_t k = 2; k < numWideLevels; k++) {
+    _wideDepths[k] = _wideDepths[k - 1] + fanoutLog2;
+  }
+
+  for (uint8_t k = 1; k < numWideLevels; k++) {
+    _wideOffsets[k] = _wideOffsets[k - 1] + (1U << _wideDepths[k - 1]);
+  }
+
+  // Initialize bitmaps
+  init_bitmaps(startFull);
+}
+
+// Creates a buddy allocator at the given address
+template <typename Config, unsigned int Fanout>
+WBTBuddyAllocator<Config, Fanout> *
+WBTBuddyAllocator<Config, Fanout>::create(void *addr, void *start,
+                                          int lazyThreshold, bool startFull) {
+  if (addr == nullptr) {
+    addr = mmap(nullptr, sizeof(WBTBuddyAllocator), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (addr == MAP_FAILED) {
+      return nullptr;
+    }
+  }
+
+  return new (addr) WBTBuddyAllocator(start, lazyThreshold, startFull);
+}
+
+// Returns the first stored level at or below the given binary tree level
+template <typename Config, unsigned int Fanout>
+inline uint8_t WBTBuddyAllocator<Config, Fanout>::wide_level(uint8_t level) {
+  if (level <= _wideDepths[1]) {
+    return 1;
+  }
+  return 1 + (level - _wideDepths[1] + fanoutLog2 - 1) / fanoutLog2;
+}
+
+// Returns log2 of the number of children of a node on the given stored level
+template <typename Config, unsigned int Fanout>
+inline uint8_t WBTBuddyAllocator<Config, Fanout>::child_shift(uint8_t wideLevel) {
+  return _wideDepths[wideLevel + 1] - _wideDepths[wideLevel];
+}
+
+template <typename Config, unsigned int Fanout>
+inline unsigned char *
+WBTBuddyAllocator<Config, Fanout>::node(uint8_t region, uint8_t wideLevel,
+                                        unsigned int index) {
+  return &_wbtTree[region][_wideOffsets[wideLevel] + index];
+}
+
+template <typename Config, unsigned int Fanout>
+inline unsigned char *
+WBTBuddyAllocator<Config, Fanout>::children(uint8_t region, uint8_t wideLevel,
+                                            unsigned int index) {
+  return node(region, wideLevel + 1, index << child_shift(wideLevel));
+}
+
+// Computes the value of a node from its children by merging them pairwise
+// through the binary levels that are not stored
+template <typename Config, unsigned int Fanout>
+unsigned char
+WBTBuddyAllocator<Config, Fanout>::merge_children(uint8_t wideLevel,
+                                                  const unsigned char *values) {
+  unsigned char merged[Fanout];
+  const unsigned int lanes = 1U << child_shift(wideLevel);
+  std::memcpy(merged, values, lanes);
+
+  unsigned char height =
+      BuddyAllocator<Config>::_numLevels - _wideDepths[wideLevel + 1];
+  for (unsigned int count = lanes; count > 1; count >>= 1, height++) {
+    for (unsigned int i = 0; i < count / 2; i++) {
+      const unsigned char left_value = merged[2 * i];
+      const unsigned char right_value = merged[2 * i + 1];
+      if (left_value == height && right_value == height) {
+        merged[i] = height + 1;
+      } else {
+        merged[i] = left_value > right_value ? left_value : right_value;
+      }
+    }
+  }
+  return merged[0];
+}
+
+// Freed blocks only update the topmost stored nodes they cover, so the
+// children of a completely free node are reset before descending into it
+template <typename Config, unsigned int Fanout>
+inline void WBTBuddyAllocator<Config, Fanout>::refresh_children(
+    uint8_t region, uint8_t wideLevel, unsigned int index) {
+  if (*node(region, wideLevel, index) ==
+      BuddyAllocator<Config>::_numLevels - _wideDepths[wideLevel]) {
+    std::memset(children(region, wideLevel, index),
+                BuddyAllocator<Config>::_numLevels -
+                    _wideDepths[wideLevel + 1],
+                1U << child_shift(wideLevel));
+  }
+}
+
+// Recomputes the ancestors of a changed node, stopping once a value is
+// unchanged
+template <typename Config, unsigned int Fanout>
+void WBTBuddyAllocator<Config, Fanout>::update_parents(uint8_t region,
+                                                       uint8_t wideLevel,
+                                                       unsigned int index) {
+  while (wideLevel > 0) {
+    wideLevel--;
+    index >>= child_shift(wideLevel);
+
+    const unsigned char value =
+        merge_children(wideLevel, children(region, wideLevel, index));
+    unsigned char *parent = node(region, wideLevel, index);
+    if (*parent == value) {
+      return;
+    }
+    *parent = value;
+  }
+}
+
+// Returns true if the block at the given level is entirely free
+template <typename Config, unsigned int Fanout>
+bool WBTBuddyAllocator<Config, Fanout>::block_is_free(uintptr_t ptr,
+                                                      uint8_t region,
+                                                      uint8_t level) {
+  const uint8_t k = wide_level(level);
+  const unsigned char tree_height =
+      BuddyAllocator<Config>::_numLevels - _wideDepths[k];
+  const unsigned char *values = node(
+      region, k,
+      BuddyAllocator<Config>::index_in_level(ptr, region, _wideDepths[k]));
+
+  for (unsigned int i = 0; i < (1U << (_wideDepths[k] - level)); i++) {
+    if (values[i] != tree_height) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if no free block is left below the block at the given level
+template <typename Config, unsigned int Fanout>
+bool WBTBuddyAllocator<Config, Fanout>::block_is_used(uintptr_t ptr,
+                                                      uint8_t region,
+                                                      uint8_t level) {
+  const uint8_t k = wide_level(level);
+  const unsigned char *values = node(
+      region, k,
+      BuddyAllocator<Config>::index_in_level(ptr, region, _wideDepths[k]));
+
+  for (unsigned int i = 0; i < (1U << (_wideDepths[k] - level)); i++) {
+    if (values[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The root holds the height of the largest free block of the region
+template <typename Config, unsigned int Fanout>
+size_t WBTBuddyAllocator<Config, Fanout>::largest_free_block(uint8_t region) {
+  const unsigned char height = *node(region, 0, 0);
+  return height == 0 ? 0
+                     : BuddyAllocator<Config>::size_of_level(
+                           BuddyAllocator<Config>::_numLevels - height);
+}
+
+template <typename Config, unsigned int Fanout>
+void WBTBuddyAllocator<Config, Fanout>::free_block_histogram(
+    uint8_t region, unsigned int *counts) {
+  for (uint8_t i = 0; i < BuddyAllocator<Config>::_numLevels; i++) {
+    counts[i] = 0;
+  }
+  BuddyAllocator<Config>::_regionMutexes[region].lock();
+  BuddyAllocator<Config>::count_free_blocks(
+      BuddyAllocator<Config>::region_start(region), region, 0, counts);
+  BuddyAllocator<Config>::_regionMutexes[region].unlock();
+}
+
+// Allocates a block of memory of the given size
+template <typename Config, unsigned int Fanout>
+void *WBTBuddyAllocator<Config, Fanout>::allocate_internal(size_t totalSize) {
+
+  const uint8_t block_level =
+      BuddyAllocator<Config>::find_smallest_block_level(totalSize);
+  const uint8_t block_height = BuddyAllocator<Config>::_numLevels - block_level;
+  // Stored level holding the nodes that make up the block
+  const uint8_t group_level = wide_level(block_level);
+  const unsigned int group = 1U << (_wideDepths[group_level] - block_level);
+
+  bool all_checked = true;
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (attempt == 1 && all_checked) {
+      break;
+    }
+
+    for (uint8_t r = 0; r < BuddyAllocator<Config>::_numRegions; r++) {
+      if (attempt == 0 &&
+          !BuddyAllocator<Config>::_regionMutexes[r].try_lock()) {
+        all_checked = false;
+        BuddyAllocator<Config>::_stats.count(Stat::ScanRetry);
+        continue;
+      }
+      if (attempt == 1) {
+        BuddyAllocator<Config>::_regionMutexes[r].lock();
+      }
+
+      if (*node(r, 0, 0) < block_height) {
+        BuddyAllocator<Config>::_regionMutexes[r].unlock();
+        continue;
+      }
+
+      // Descend into the child with the lowest value that is at least
+      // block_height, trying the next region if the descent fails
+      unsigned int index = 0;
+      bool descended = true;
+      for (uint8_t k = 0; k + 1 < group_level; k++) {
+        refresh_children(r, k, index);
+        const unsigned int lanes = 1U << child_shift(k);
+        const unsigned int lane =
+            best_fit_lane<Fanout>(children(r, k, index), lanes, block_height);
+        if (lane == lanes) {
+          descended = false;
+          break;
+        }
+        index = (index << child_shift(k)) + lane;
+      }
+      if (!descended) {
+        BuddyAllocator<Config>::_regionMutexes[r].unlock();
+        continue;
+      }
+
+      // Find enough free children to make up the block
+      const uint8_t parent_level = group_level - 1;
+      refresh_children(r, parent_level, index);
+      const unsigned int lanes = 1U << child_shift(parent_level);
+      unsigned char *values = children(r, parent_level, index);
+      const unsigned int lane = free_group_lane<Fanout>(
+          values, lanes,
+          BuddyAllocator<Config>::_numLevels - _wideDepths[group_level],
+          group);
+      if (lane == lanes) {
+        BuddyAllocator<Config>::_regionMutexes[r].unlock();
+        continue;
+      }
+
+      index = (index << child_shift(parent_level)) + lane;
+      const uintptr_t block =
+          BuddyAllocator<Config>::region_start(r) +
+          static_cast<uintptr_t>(index) *
+              BuddyAllocator<Config>::size_of_level(_wideDepths[group_level]);
+
+      // Every free ancestor of the block is split by the allocation
+      if (Config::collectStats) {
+        uint8_t l = block_level;
+        while (l > 0 &&
+               block_is_free(BuddyAllocator<Config>::align_left(block, l - 1),
+                             r, l - 1)) {
+          l--;
+        }
+        BuddyAllocator<Config>::_stats.count(Stat::Split, block_level - l);
+      }
+
+      std::memset(values + lane, 0, group);
+      update_parents(r, group_level, index);
+
+      if (BuddyAllocator<Config>::_sizeMapEnabled) {
+        if (BuddyAllocator<Config>::_sizeMapIsBitmap) {
+          for (uint8_t l = 0; l < block_level; l++) {
+            BuddyAllocator<Config>::set_split_block(
+                r, BuddyAllocator<Config>::block_index(block, r, l), true);
+          }
+        } else {
+          // Store the size if not a bitmap
+          BuddyAllocator<Config>::set_level(block, r, block_level);
+        }
+      }
+
+      BuddyAllocator<Config>::_freeSizes[r] -=
+          BuddyAllocator<Config>::size_of_level(block_level);
+
+      BuddyAllocator<Config>::_regionMutexes[r].unlock();
+      return reinterpret_cast<void *>(block);
+    }
+  }
+
+  return nullptr;
+}
+
+// Deallocates a block of memory of the given size
+template <typename Config, unsigned int Fanout>
+void WBTBuddyAllocator<Config, Fanout>::deallocate_internal(void *ptr,
+                                                            size_t size) {
+  auto block = reinterpret_cast<uintptr_t>(ptr);
+  const uint8_t region = BuddyAllocator<Config>::get_region(block);
+  const uint8_t level = BuddyAllocator<Config>::get_level(block, size);
+
+  const uint8_t group_level = wide_level(level);
+  const unsigned int index = BuddyAllocator<Config>::index_in_level(
+      block, region, _wideDepths[group_level]);
+
+  BuddyAllocator<Config>::lock_region(region);
+  std::memset(node(region, group_level, index),
+              BuddyAllocator<Config>::_numLevels - _wideDepths[group_level],
+              1U << (_wideDepths[group_level] - level));
+  update_parents(region, group_level, index);
+
+  // Clear the split bit of every ancestor that became free
+  const bool clear_split = BuddyAllocator<Config>::_sizeMapIsBitmap &&
+                           BuddyAllocator<Config>::_sizeMapEnabled;
+  if (clear_split || Config::collectStats) {
+    uint8_t l = level;
+    for (; l > 0; l--) {
+      const uintptr_t parent = BuddyAllocator<Config>::align_left(block, l - 1);
+      if (!block_is_free(parent, region, l - 1)) {
+        break;
+      }
+      if (clear_split) {
+        BuddyAllocator<Config>::set_split_block(
+            region, BuddyAllocator<Config>::block_index(parent, region, l - 1),
+            false);
+      }
+    }
+    BuddyAllocator<Config>::_stats.count(Stat::Merge, level - l);
+  }
+
+  BuddyAllocator<Config>::_freeSizes[region] +=
+      BuddyAllocator<Config>::size_of_level(level);
+  BuddyAllocator<Config>::_regionMutexes[region].unlock();
+}
+
+template <typename Config, unsigned int Fanout>
+void WBTBuddyAllocator<Config, Fanout>::print_free_list() {
+  for (int r = 0; r < BuddyAllocator<Config>::_numRegions; r++) {
+    std::cout << "Region " << r << " tree: " << std::endl;
+    for (uint8_t k = 0; k < numWideLevels; k++) {
+      for (unsigned int i = 0; i < (1U << _wideDepths[k]); i++) {
+        std::cout << static_cast<int>(*node(r, k, i)) << " ";
+      }
+      std::cout << std::endl;
+    }
+    std::cout << std::endl;
+  }
+}
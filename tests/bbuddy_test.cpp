@@ -9,8 +9,10 @@
 #include <cppunit/TextTestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <thread>
 #include <vector>
 
 class SmallSingleAllocatorTests : public CppUnit::TestFixture {
@@ -27,6 +29,10 @@ class SmallSingleAllocatorTests : public CppUnit::TestFixture {
   CPPUNIT_TEST(testAllocateFillLargeBlocks);
   CPPUNIT_TEST(testAllocateAllSizes);
   CPPUNIT_TEST(testAllocateFillAllSizes);
+  CPPUNIT_TEST(testEvacuationCandidates);
+  CPPUNIT_TEST(testEvacuationCandidatesNoSizeMap);
+  CPPUNIT_TEST(testFragmentationMetrics);
+  CPPUNIT_TEST(testStats);
   CPPUNIT_TEST(testAllCombined);
   CPPUNIT_TEST_SUITE_END();
 
@@ -255,6 +261,151 @@ public:
     allocator->deallocate(p2);
   }
 
+  void testEvacuationCandidates() {
+    BinaryBuddyAllocator<SmallSingleConfig> *allocator = get_small_single_allocator();
+
+    void *blocks[8];
+    for (auto &block : blocks) {
+      block = allocator->allocate(32);
+      CPPUNIT_ASSERT(block != nullptr);
+    }
+    std::sort(std::begin(blocks), std::end(blocks));
+    char *start = static_cast<char *>(blocks[0]);
+
+    // Moving block 1 frees the left half, moving block 4 a quarter
+    allocator->deallocate(blocks[0]);
+    allocator->deallocate(blocks[2]);
+    allocator->deallocate(blocks[3]);
+    allocator->deallocate(blocks[5]);
+
+    EvacuationCandidate candidates[4];
+    size_t found =
+        allocator->evacuation_candidates(start, _maxSize, candidates, 4);
+    CPPUNIT_ASSERT(found == 2);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[1]);
+    CPPUNIT_ASSERT(candidates[0].size == 32);
+    CPPUNIT_ASSERT(candidates[0].freeSize == 128);
+    CPPUNIT_ASSERT(candidates[1].block == blocks[4]);
+    CPPUNIT_ASSERT(candidates[1].freeSize == 64);
+
+    found = allocator->evacuation_candidates(start, _maxSize, candidates, 1);
+    CPPUNIT_ASSERT(found == 1);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[1]);
+
+    // Merging stops at the end of the range
+    found = allocator->evacuation_candidates(start, 64, candidates, 4);
+    CPPUNIT_ASSERT(found == 1);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[1]);
+    CPPUNIT_ASSERT(candidates[0].freeSize == 64);
+
+    found = allocator->evacuation_candidates(start + 128, 128, candidates, 4);
+    CPPUNIT_ASSERT(found == 1);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[4]);
+  }
+
+  // ZConfig has no size map, so the free lists are searched instead
+  void testEvacuationCandidatesNoSizeMap() {
+    BinaryBuddyAllocator<ZConfig> *allocator =
+        BinaryBuddyAllocator<ZConfig>::create(nullptr, nullptr, 0, false);
+
+    std::vector<void *> blocks;
+    void *p;
+    while ((p = allocator->allocate(32)) != nullptr) {
+      blocks.push_back(p);
+    }
+    std::sort(blocks.begin(), blocks.end());
+    char *start = static_cast<char *>(blocks[0]);
+
+    allocator->deallocate(blocks[0], 32);
+    allocator->deallocate(blocks[2], 32);
+    allocator->deallocate(blocks[3], 32);
+    allocator->deallocate(blocks[5], 32);
+
+    EvacuationCandidate candidates[4];
+    const size_t found =
+        allocator->evacuation_candidates(start, 256, candidates, 4);
+    CPPUNIT_ASSERT(found == 2);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[1]);
+    CPPUNIT_ASSERT(candidates[0].freeSize == 128);
+    CPPUNIT_ASSERT(candidates[1].block == blocks[4]);
+    CPPUNIT_ASSERT(candidates[1].freeSize == 64);
+  }
+
+  void testFragmentationMetrics() {
+    BinaryBuddyAllocator<SmallSingleConfig> *allocator = get_small_single_allocator();
+    unsigned int counts[5];
+
+    void *blocks[8];
+    for (auto &block : blocks) {
+      block = allocator->allocate(32);
+      CPPUNIT_ASSERT(block != nullptr);
+    }
+    std::sort(std::begin(blocks), std::end(blocks));
+    CPPUNIT_ASSERT(allocator->largest_free_block(0) == 0);
+    CPPUNIT_ASSERT(allocator->fragmentation() == 0.0);
+
+    // Leaves free blocks of 32, 64 and 32 bytes
+    allocator->deallocate(blocks[0]);
+    allocator->deallocate(blocks[2]);
+    allocator->deallocate(blocks[3]);
+    allocator->deallocate(blocks[5]);
+
+    allocator->free_block_histogram(0, counts);
+    CPPUNIT_ASSERT(counts[0] == 0 && counts[1] == 0 && counts[4] == 0);
+    CPPUNIT_ASSERT(counts[2] == 1);
+    CPPUNIT_ASSERT(counts[3] == 2);
+    CPPUNIT_ASSERT(allocator->largest_free_block(0) == 64);
+    CPPUNIT_ASSERT(allocator->fragmentation() == 0.5);
+
+    allocator->deallocate(blocks[1]);
+    allocator->deallocate(blocks[4]);
+    allocator->deallocate(blocks[6]);
+    allocator->deallocate(blocks[7]);
+
+    allocator->free_block_histogram(0, counts);
+    CPPUNIT_ASSERT(counts[0] == 1);
+    CPPUNIT_ASSERT(counts[1] == 0 && counts[2] == 0 && counts[3] == 0);
+    CPPUNIT_ASSERT(allocator->largest_free_block(0) == _maxSize);
+    CPPUNIT_ASSERT(allocator->fragmentation() == 0.0);
+
+    // An empty heap of several regions is not fragmented
+    BinaryBuddyAllocator<ZConfig> *regions =
+        BinaryBuddyAllocator<ZConfig>::create(nullptr, nullptr, 0, false);
+    const size_t heap = ZConfig::numRegions * ZConfig::maxBlockSize;
+    CPPUNIT_ASSERT(regions->fragmentation() == 0.0);
+
+    // A request below the smallest block takes a whole smallest block
+    void *p = regions->allocate(1);
+    CPPUNIT_ASSERT(p != nullptr);
+    CPPUNIT_ASSERT(regions->free_size() == heap - ZConfig::minBlockSize);
+    CPPUNIT_ASSERT(regions->fragmentation() > 0.0);
+    regions->deallocate(p, 1);
+    CPPUNIT_ASSERT(regions->free_size() == heap);
+    CPPUNIT_ASSERT(regions->fragmentation() == 0.0);
+  }
+
+  void testStats() {
+    BinaryBuddyAllocator<StatsConfig> *allocator =
+        BinaryBuddyAllocator<StatsConfig>::create(nullptr, nullptr, 0, false);
+
+    // The smallest block is split off and merged back through every level
+    void *p = allocator->allocate(_minSize);
+    CPPUNIT_ASSERT(p != nullptr);
+    CPPUNIT_ASSERT(allocator->allocate(_maxSize) == nullptr);
+    allocator->deallocate(p);
+
+    const BuddyStats stats = allocator->stats();
+    CPPUNIT_ASSERT(stats.allocs[4] == 1);
+    CPPUNIT_ASSERT(stats.allocs[0] == 0);
+    CPPUNIT_ASSERT(stats.frees[4] == 1);
+    CPPUNIT_ASSERT(stats.splits == 4);
+    CPPUNIT_ASSERT(stats.merges == 4);
+    CPPUNIT_ASSERT(stats.failures == 1);
+
+    allocator->reset_stats();
+    CPPUNIT_ASSERT(allocator->stats().splits == 0);
+  }
+
   void testAllCombined() {
     smallSingleAllocator = get_small_single_allocator();
 
@@ -294,6 +445,7 @@ class SmallDoubleAllocatorTests : public CppUnit::TestFixture {
   CPPUNIT_TEST(testAllocateFillLargeBlocksDouble);
   CPPUNIT_TEST(testAllocateAllSizesDouble);
   CPPUNIT_TEST(testAllocateFillAllSizesDouble);
+  CPPUNIT_TEST(testBestFitDouble);
   CPPUNIT_TEST(testAllCombined);
   CPPUNIT_TEST_SUITE_END();
 
@@ -432,6 +584,28 @@ class SmallDoubleAllocatorTests : public CppUnit::TestFixture {
     allocator->deallocate(p3);
   }
 
+  void testBestFitDouble() {
+    BinaryBuddyAllocator<SmallDoubleConfig> *allocator = get_small_double_allocator();
+    allocator->set_placement(Placement::BestFit);
+
+    void *p = allocator->allocate(_maxSize);
+    void *p2 = allocator->allocate(_minSize);
+    allocator->deallocate(p);
+
+    // The free half next to p2 is used instead of splitting the empty region
+    void *p3 = allocator->allocate(_maxSize / 2);
+    CPPUNIT_ASSERT(p3 == static_cast<uint8_t *>(p2) + _maxSize / 2);
+
+    void *p4 = allocator->allocate(_maxSize);
+    CPPUNIT_ASSERT(p4 == p);
+    CPPUNIT_ASSERT(allocator->free_size() == _maxSize / 2 - _minSize);
+
+    allocator->deallocate(p2);
+    allocator->deallocate(p3);
+    allocator->deallocate(p4);
+    CPPUNIT_ASSERT(allocator->free_size() == _maxSize * 2);
+  }
+
   void testAllCombined() {
     smallDoubleAllocator = get_small_double_allocator();
 
@@ -1132,11 +1306,51 @@ private:
   }
 };
 
+class ConcurrentAllocatorTests : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(ConcurrentAllocatorTests);
+  CPPUNIT_TEST(testConcurrentAllocateDeallocate);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  // Threads allocating and freeing blocks of a single region, which corrupts
+  // it unless frees hold the region lock like allocations do
+  void testConcurrentAllocateDeallocate() {
+    BinaryBuddyAllocator<SmallSingleConfig> *allocator =
+        BinaryBuddyAllocator<SmallSingleConfig>::create(nullptr, nullptr, 0, false);
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < _numThreads; t++) {
+      threads.emplace_back([allocator, t]() {
+        const size_t size = _minSize << (t % 3);
+        for (unsigned int i = 0; i < _iterations; i++) {
+          void *p = allocator->allocate(size);
+          if (p != nullptr) {
+            allocator->deallocate(p, size);
+          }
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    CPPUNIT_ASSERT(allocator->free_size() == _maxSize);
+    CPPUNIT_ASSERT(allocator->allocate(_maxSize) != nullptr);
+  }
+
+private:
+  static const size_t _minSize = 16;
+  static const size_t _maxSize = 256;
+  static const unsigned int _numThreads = 4;
+  static const unsigned int _iterations = 200000;
+};
+
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallSingleAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallDoubleAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallSingleFilledAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallSingleLazyAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(LargeQuadAllocatorTests);
+CPPUNIT_TEST_SUITE_REGISTRATION(ConcurrentAllocatorTests);
 int main() {
   // Run the tests
   CppUnit::TextTestRunner runner;
@@ -9,10 +9,19 @@
 #include <cppunit/TextTestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <thread>
 #include <vector>
 
+template <typename Allocator> struct TreeLayoutAccess {
+  static unsigned int tree_offset(Allocator *allocator, unsigned int index,
+                                  uint8_t level) {
+    return allocator->tree_offset(index, level);
+  }
+};
+
 class SmallSingleAllocatorTests : public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(SmallSingleAllocatorTests);
   CPPUNIT_TEST(testAllocateSingle);
@@ -27,6 +36,9 @@ class SmallSingleAllocatorTests : public CppUnit::TestFixture {
   CPPUNIT_TEST(testAllocateFillLargeBlocks);
   CPPUNIT_TEST(testAllocateAllSizes);
   CPPUNIT_TEST(testAllocateFillAllSizes);
+  CPPUNIT_TEST(testEvacuationCandidates);
+  CPPUNIT_TEST(testFragmentationMetrics);
+  CPPUNIT_TEST(testStats);
   CPPUNIT_TEST(testAllCombined);
   CPPUNIT_TEST_SUITE_END();
 
@@ -255,6 +267,123 @@ public:
     allocator->deallocate(p2);
   }
 
+  void testEvacuationCandidates() {
+    BTBuddyAllocator<SmallSingleConfig> *allocator = get_small_single_allocator();
+
+    void *blocks[8];
+    for (auto &block : blocks) {
+      block = allocator->allocate(32);
+      CPPUNIT_ASSERT(block != nullptr);
+    }
+    std::sort(std::begin(blocks), std::end(blocks));
+    char *start = static_cast<char *>(blocks[0]);
+
+    // Moving block 1 frees the left half, moving block 4 a quarter
+    allocator->deallocate(blocks[0]);
+    allocator->deallocate(blocks[2]);
+    allocator->deallocate(blocks[3]);
+    allocator->deallocate(blocks[5]);
+
+    EvacuationCandidate candidates[4];
+    size_t found =
+        allocator->evacuation_candidates(start, _maxSize, candidates, 4);
+    CPPUNIT_ASSERT(found == 2);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[1]);
+    CPPUNIT_ASSERT(candidates[0].size == 32);
+    CPPUNIT_ASSERT(candidates[0].freeSize == 128);
+    CPPUNIT_ASSERT(candidates[1].block == blocks[4]);
+    CPPUNIT_ASSERT(candidates[1].freeSize == 64);
+
+    found = allocator->evacuation_candidates(start, _maxSize, candidates, 1);
+    CPPUNIT_ASSERT(found == 1);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[1]);
+
+    // Merging stops at the end of the range
+    found = allocator->evacuation_candidates(start, 64, candidates, 4);
+    CPPUNIT_ASSERT(found == 1);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[1]);
+    CPPUNIT_ASSERT(candidates[0].freeSize == 64);
+
+    found = allocator->evacuation_candidates(start + 128, 128, candidates, 4);
+    CPPUNIT_ASSERT(found == 1);
+    CPPUNIT_ASSERT(candidates[0].block == blocks[4]);
+  }
+
+  void testFragmentationMetrics() {
+    BTBuddyAllocator<SmallSingleConfig> *allocator = get_small_single_allocator();
+    unsigned int counts[5];
+
+    void *blocks[8];
+    for (auto &block : blocks) {
+      block = allocator->allocate(32);
+      CPPUNIT_ASSERT(block != nullptr);
+    }
+    std::sort(std::begin(blocks), std::end(blocks));
+    CPPUNIT_ASSERT(allocator->largest_free_block(0) == 0);
+    CPPUNIT_ASSERT(allocator->fragmentation() == 0.0);
+
+    // Leaves free blocks of 32, 64 and 32 bytes
+    allocator->deallocate(blocks[0]);
+    allocator->deallocate(blocks[2]);
+    allocator->deallocate(blocks[3]);
+    allocator->deallocate(blocks[5]);
+
+    allocator->free_block_histogram(0, counts);
+    CPPUNIT_ASSERT(counts[0] == 0 && counts[1] == 0 && counts[4] == 0);
+    CPPUNIT_ASSERT(counts[2] == 1);
+    CPPUNIT_ASSERT(counts[3] == 2);
+    CPPUNIT_ASSERT(allocator->largest_free_block(0) == 64);
+    CPPUNIT_ASSERT(allocator->fragmentation() == 0.5);
+
+    allocator->deallocate(blocks[1]);
+    allocator->deallocate(blocks[4]);
+    allocator->deallocate(blocks[6]);
+    allocator->deallocate(blocks[7]);
+
+    allocator->free_block_histogram(0, counts);
+    CPPUNIT_ASSERT(counts[0] == 1);
+    CPPUNIT_ASSERT(counts[1] == 0 && counts[2] == 0 && counts[3] == 0);
+    CPPUNIT_ASSERT(allocator->largest_free_block(0) == _maxSize);
+    CPPUNIT_ASSERT(allocator->fragmentation() == 0.0);
+
+    // An empty heap of several regions is not fragmented
+    BTBuddyAllocator<ZConfig> *regions =
+        BTBuddyAllocator<ZConfig>::create(nullptr, nullptr, 0, false);
+    const size_t heap = ZConfig::numRegions * ZConfig::maxBlockSize;
+    CPPUNIT_ASSERT(regions->fragmentation() == 0.0);
+
+    // A request below the smallest block takes a whole smallest block
+    void *p = regions->allocate(1);
+    CPPUNIT_ASSERT(p != nullptr);
+    CPPUNIT_ASSERT(regions->free_size() == heap - ZConfig::minBlockSize);
+    CPPUNIT_ASSERT(regions->fragmentation() > 0.0);
+    regions->deallocate(p, 1);
+    CPPUNIT_ASSERT(regions->free_size() == heap);
+    CPPUNIT_ASSERT(regions->fragmentation() == 0.0);
+  }
+
+  void testStats() {
+    BTBuddyAllocator<StatsConfig> *allocator =
+        BTBuddyAllocator<StatsConfig>::create(nullptr, nullptr, 0, false);
+
+    // The smallest block is split off and merged back through every level
+    void *p = allocator->allocate(_minSize);
+    CPPUNIT_ASSERT(p != nullptr);
+    CPPUNIT_ASSERT(allocator->allocate(_maxSize) == nullptr);
+    allocator->deallocate(p);
+
+    const BuddyStats stats = allocator->stats();
+    CPPUNIT_ASSERT(stats.allocs[4] == 1);
+    CPPUNIT_ASSERT(stats.allocs[0] == 0);
+    CPPUNIT_ASSERT(stats.frees[4] == 1);
+    CPPUNIT_ASSERT(stats.splits == 4);
+    CPPUNIT_ASSERT(stats.merges == 4);
+    CPPUNIT_ASSERT(stats.failures == 1);
+
+    allocator->reset_stats();
+    CPPUNIT_ASSERT(allocator->stats().splits == 0);
+  }
+
   void testAllCombined() {
     smallSingleAllocator = get_small_single_allocator();
 
@@ -483,6 +612,7 @@ class SmallSingleFilledAllocatorTests : public CppUnit::TestFixture {
   CPPUNIT_TEST(testClearFillAlternate);
   CPPUNIT_TEST(testClearFullAlternate);
   CPPUNIT_TEST(testClearFullAlternateFill);
+  CPPUNIT_TEST(testClearFullAllocateSmall);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -737,6 +867,20 @@ public:
     CPPUNIT_ASSERT(allocator->allocate(_maxSize) != nullptr);
   }
 
+  void testClearFullAllocateSmall() {
+    uint8_t mempool[_maxSize];
+    BTBuddyAllocator<SmallSingleConfig> *allocator =
+        get_small_filled_allocator(mempool);
+
+    allocator->deallocate_range(mempool, _maxSize);
+
+    for (size_t i = 0; i < _maxSize; i += _minSize) {
+      CPPUNIT_ASSERT(allocator->allocate(_minSize) != nullptr);
+    }
+    CPPUNIT_ASSERT(allocator->free_size() == 0);
+    CPPUNIT_ASSERT(allocator->allocate(_minSize) == nullptr);
+  }
+
   void testClearFullAlternateFill() {
     uint8_t mempool[_maxSize];
     BTBuddyAllocator<SmallSingleConfig> *allocator =
@@ -921,6 +1065,8 @@ class LargeQuadAllocatorTests : public CppUnit::TestFixture {
   CPPUNIT_TEST(testAllocateFillLargeBlocksQuad);
   CPPUNIT_TEST(testAllocateAllSizesQuad);
   CPPUNIT_TEST(testAllocateFillAllSizesQuad);
+  CPPUNIT_TEST(testAllocateFillAllSizesBlocked);
+  CPPUNIT_TEST(testBlockedRowsAligned);
   CPPUNIT_TEST(testAllCombined);
   CPPUNIT_TEST_SUITE_END();
 
@@ -1093,6 +1239,59 @@ public:
     allocator->deallocate(p5);
   }
 
+  void testAllocateFillAllSizesBlocked() {
+    BTBuddyAllocator<LargeQuadConfig, true> *allocator =
+        BTBuddyAllocator<LargeQuadConfig, true>::create(nullptr, nullptr, 0,
+                                                        false);
+    std::vector<void *> blocks;
+
+    for (size_t i = _maxSize; i >= _minSize; i /= 2) {
+      CPPUNIT_ASSERT(allocator->free_size() == _maxSize * 4);
+
+      for (unsigned int j = 0; j < _maxSize * 4 / i; j++) {
+        void *p = allocator->allocate(i);
+        CPPUNIT_ASSERT(p != nullptr);
+        blocks.push_back(p);
+      }
+
+      CPPUNIT_ASSERT(allocator->free_size() == 0);
+      CPPUNIT_ASSERT(allocator->allocate(i) == nullptr);
+
+      for (unsigned int j = 0; j < _maxSize * 4 / i; j++) {
+        allocator->deallocate(blocks.back());
+        blocks.pop_back();
+      }
+
+      CPPUNIT_ASSERT(allocator->free_size() == _maxSize * 4);
+    }
+  }
+
+  // Every subtree below the top row of the blocked layout starts a cache line,
+  // also when the top row is shorter than a full subtree
+  template <typename Config> static void check_rows_aligned() {
+    using Allocator = BTBuddyAllocator<Config, true>;
+    using Layout = TreeLayoutAccess<Allocator>;
+    Allocator *allocator = Allocator::create(nullptr, nullptr, 0, false);
+    const unsigned int byte_levels = Config::numLevels - 3;
+    const unsigned int top_height =
+        byte_levels % 6 == 0 ? 6 : byte_levels % 6;
+
+    for (unsigned int l = top_height; l < byte_levels; l += 6) {
+      for (unsigned int i = (1U << l) - 1; i < (1U << (l + 1)) - 1; i++) {
+        CPPUNIT_ASSERT(Layout::tree_offset(allocator, i, l) % 64 == 0);
+      }
+    }
+    CPPUNIT_ASSERT(Layout::tree_offset(allocator, (1U << byte_levels) - 2,
+                                       byte_levels - 1) <
+                   (1U << Config::numLevels));
+  }
+
+  void testBlockedRowsAligned() {
+    check_rows_aligned<LargeQuadConfig>();
+    check_rows_aligned<MallocConfig>();
+    check_rows_aligned<ZConfig>();
+  }
+
   void testAllCombined() {
     largeQuadAllocator = get_large_quad_allocator();
 
@@ -1132,11 +1331,51 @@ private:
   }
 };
 
+class ConcurrentAllocatorTests : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(ConcurrentAllocatorTests);
+  CPPUNIT_TEST(testConcurrentAllocateDeallocate);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  // Threads allocating and freeing blocks of a single region, which corrupts
+  // it unless frees hold the region lock like allocations do
+  void testConcurrentAllocateDeallocate() {
+    BTBuddyAllocator<SmallSingleConfig> *allocator =
+        BTBuddyAllocator<SmallSingleConfig>::create(nullptr, nullptr, 0, false);
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < _numThreads; t++) {
+      threads.emplace_back([allocator, t]() {
+        const size_t size = _minSize << (t % 3);
+        for (unsigned int i = 0; i < _iterations; i++) {
+          void *p = allocator->allocate(size);
+          if (p != nullptr) {
+            allocator->deallocate(p, size);
+          }
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    CPPUNIT_ASSERT(allocator->free_size() == _maxSize);
+    CPPUNIT_ASSERT(allocator->allocate(_maxSize) != nullptr);
+  }
+
+private:
+  static const size_t _minSize = 16;
+  static const size_t _maxSize = 256;
+  static const unsigned int _numThreads = 4;
+  static const unsigned int _iterations = 200000;
+};
+
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallSingleAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallDoubleAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallSingleFilledAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(SmallSingleLazyAllocatorTests);
 CPPUNIT_TEST_SUITE_REGISTRATION(LargeQuadAllocatorTests);
+CPPUNIT_TEST_SUITE_REGISTRATION(ConcurrentAllocatorTests);
 int main() {
   // Run the tests
   CppUnit::TextTestRunner runner;